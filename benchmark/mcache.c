@@ -0,0 +1,107 @@
+
+#include "common.h"
+#include <time.h>
+#include <stdint.h>
+
+#define ALLOC_SIZE      64
+#define NUM_SCALES      4
+
+/**
+ * Helper method that returns the current time of a monotonic clock, measured
+ * in seconds.
+ */
+double getTime()
+{
+    struct timespec ts = { 0 };
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+/**
+ * Microbenchmark that measures the cost of allocating, attaching, detaching
+ * and releasing an increasing number of allocations on a dynamic window, with
+ * the purpose of verifying that the cost per operation remains flat.
+ *
+ * Note: Some MPI implementations limit the number of attached regions (e.g.,
+ *       OpenMPI requires "--mca osc_rdma_max_attach 131072").
+ */
+int main (int argc, char *argv[])
+{
+    const size_t num_allocs[NUM_SCALES] = { 100, 1000, 10000, 100000 };
+    MPI_Win      win                    = MPI_WIN_NULL;
+    int          rank                   = 0;
+    
+    // Initialize MPI and retrieve the rank of the process
+    CHKPRINT(MPI_Init(&argc, &argv));
+    CHKPRINT(MPI_Comm_rank(MPI_COMM_WORLD, &rank));
+    
+    for (int scale = 0; scale < NUM_SCALES; scale++)
+    {
+        const size_t count     = num_allocs[scale];
+        void         **baseptr = (void **)malloc(sizeof(void *) * count);
+        double       elapsed[4];
+        double       start     = 0.0;
+        uint32_t     seed      = 921;
+        
+        CHKPRINT(MPI_Win_create_dynamic(MPI_INFO_NULL, MPI_COMM_WORLD, &win));
+        
+        start = getTime();
+        for (size_t i = 0; i < count; i++)
+        {
+            CHKPRINT(MPI_Alloc_mem(ALLOC_SIZE, MPI_INFO_NULL, &baseptr[i]));
+        }
+        elapsed[0] = getTime() - start;
+        
+        start = getTime();
+        for (size_t i = 0; i < count; i++)
+        {
+            CHKPRINT(MPI_Win_attach(win, baseptr[i], ALLOC_SIZE));
+        }
+        elapsed[1] = getTime() - start;
+        
+        start = getTime();
+        for (size_t i = 0; i < count; i++)
+        {
+            CHKPRINT(MPI_Win_detach(win, baseptr[i]));
+        }
+        elapsed[2] = getTime() - start;
+        
+        // Shuffle the allocations to release them in a random order
+        for (size_t i = count - 1; i > 0; i--)
+        {
+            size_t j    = (size_t)rand_r(&seed) % (i + 1);
+            void   *tmp = baseptr[i];
+            
+            baseptr[i] = baseptr[j];
+            baseptr[j] = tmp;
+        }
+        
+        start = getTime();
+        for (size_t i = 0; i < count; i++)
+        {
+            CHKPRINT(MPI_Free_mem(baseptr[i]));
+        }
+        elapsed[3] = getTime() - start;
+        
+        CHKPRINT(MPI_Win_free(&win));
+        
+        // Print the cost per operation (in microseconds)
+        if (rank == 0)
+        {
+            printf("%zu; %.3lf; %.3lf; %.3lf; %.3lf\n", count,
+                                                        (elapsed[0] * 1e6) / count,
+                                                        (elapsed[1] * 1e6) / count,
+                                                        (elapsed[2] * 1e6) / count,
+                                                        (elapsed[3] * 1e6) / count);
+        }
+        
+        free(baseptr);
+    }
+    
+    CHKPRINT(MPI_Finalize());
+    
+    return MPI_SUCCESS;
+}
+
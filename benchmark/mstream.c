@@ -1,13 +1,17 @@
 
 #include "common.h"
-#include <sys/time.h>
+#include <time.h>
 #include <stdint.h>
+#include <getopt.h>
 #include "mpi_swin_keys.h"
 
 #define TMP_FOLDER           "./tmp"
 #define NUM_ITERATIONS_INIT  1
 #define NUM_ITERATIONS       10
-#define NUM_ITERATIONS_TOTAL (NUM_ITERATIONS_INIT + NUM_ITERATIONS)
+#define HIST_SUB_BITS        4                          // Sub-buckets per power of two (i.e., 6% of error)
+#define HIST_NUM_BUCKETS     (64 << HIST_SUB_BITS)
+#define CONV_MB              1048576.0
+#define CONV_USEC            1e-3
 
 typedef enum
 {
@@ -23,62 +27,171 @@ typedef enum
     ALLOC_STORAGE
 } AllocType;
 
+typedef enum
+{
+    FORMAT_CSV = 0,
+    FORMAT_JSON
+} OutputFormat;
+
 /**
- * Helper method that allows to create a directory given its path.
+ * Structure that contains the settings of the benchmark, given as options.
  */
-int createDir(const char *path)
+typedef struct
+{
+    BenchmarkType benchmark;        // Access pattern of the benchmark
+    AllocType     alloc_type;       // Type of window allocation
+    size_t        alloc_size;       // Size of the window of each process
+    double        alloc_factor;     // Allocation factor of storage windows
+    size_t        segment_size;     // Size of each MPI_Put / MPI_Get
+    int           num_iterations;   // Number of measured iterations
+    int           num_warmup;       // Number of iterations discarded before measuring
+    const char    *dir;             // Folder that contains the files of the windows
+    const char    *hugepages;       // Type of huge pages for the memory part
+    const char    *engine;          // Paging engine of the storage part
+    OutputFormat  format;           // Format of the results
+    int           header;           // Flag that determines if the CSV header is printed
+} Settings;
+
+/**
+ * Structure that defines a histogram of latencies (in nanoseconds), with
+ * buckets that grow exponentially and are divided linearly (i.e., the error
+ * of each bucket is relative to its latency).
+ */
+typedef struct
+{
+    uint64_t count[HIST_NUM_BUCKETS];
+    uint64_t total;                 // Number of latencies recorded
+    uint64_t sum;                   // Sum of the latencies recorded
+} Histogram;
+
+const char *g_benchmark_names[] = { "sequential", "padding", "random", "mixed" };
+const char *g_alloc_names[]     = { "memory", "storage" };
+
+/**
+ * Helper method that returns the current time of a monotonic clock, measured
+ * in nanoseconds.
+ */
+uint64_t getTime()
+{
+    struct timespec ts = { 0 };
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Helper method that retrieves the bucket of a given latency.
+ */
+int getBucket(uint64_t latency)
 {
-    struct stat st = { 0 };
+    const int msb = 63 - __builtin_clzll(latency | 1);
+    
+    if (msb < HIST_SUB_BITS)
+    {
+        return (int)latency;
+    }
+    
+    return ((msb - HIST_SUB_BITS + 1) << HIST_SUB_BITS) +
+           (int)((latency >> (msb - HIST_SUB_BITS)) & ((1 << HIST_SUB_BITS) - 1));
+}
 
-    // Check if the directory already exists (i.e., ignoring the request)
-    if (stat(path, &st) == -1)
+/**
+ * Helper method that retrieves the highest latency of a given bucket.
+ */
+uint64_t getBucketLimit(int bucket)
+{
+    const int exponent = (bucket >> HIST_SUB_BITS) - 1;
+    
+    if (exponent < 0)
     {
-        char mkdir_command[PATH_MAX];
-        sprintf(mkdir_command, "mkdir -p %s", path);
-        
-        // For simplicity, we use the mkdir command
-        CHK(system(mkdir_command));
+        return bucket;
     }
     
-    return MPI_SUCCESS;
+    return (((uint64_t)((1 << HIST_SUB_BITS) | (bucket & ((1 << HIST_SUB_BITS) - 1))) + 1) << exponent) - 1;
+}
+
+/**
+ * Helper method that records the latency of an operation in the histogram.
+ */
+void addLatency(Histogram *histogram, uint64_t latency)
+{
+    histogram->count[getBucket(latency)]++;
+    histogram->total++;
+    histogram->sum += latency;
 }
 
 /**
- * Helper method that allows to delete a directory given its path.
+ * Helper method that retrieves the latency of a given percentile (e.g., 0.99),
+ * measured in microseconds.
  */
-int deleteDir(const char *path)
+double getPercentile(Histogram *histogram, double percentile)
 {
-    char rm_command[PATH_MAX];
+    const double target = percentile * histogram->total;
+    uint64_t     count  = 0;
     
-    sprintf(rm_command, "rm -rf %s", path);
+    for (int bucket = 0; bucket < HIST_NUM_BUCKETS && histogram->total > 0; bucket++)
+    {
+        count += histogram->count[bucket];
         
-    // For simplicity, we use the rm command
-    return system(rm_command);
+        if (count >= target && count > 0)
+        {
+            return getBucketLimit(bucket) * CONV_USEC;
+        }
+    }
+    
+    return 0.0;
+}
+
+/**
+ * Helper method that allows to create a directory given its path, including
+ * the parent directories that do not exist.
+ */
+int createDir(const char *path)
+{
+    char path_tmp[PATH_MAX];
+    
+    snprintf(path_tmp, PATH_MAX, "%s", path);
+    
+    for (char *c = path_tmp + 1; *c != '\0'; c++)
+    {
+        if (*c == '/')
+        {
+            *c = '\0';
+            CHKB(mkdir(path_tmp, S_IRWXU) == ERROR && errno != EEXIST);
+            *c = '/';
+        }
+    }
+    
+    CHKB(mkdir(path_tmp, S_IRWXU) == ERROR && errno != EEXIST);
+    
+    return MPI_SUCCESS;
 }
 
 /**
  * Helper method that allows to create an MPI_Info object to enable Storage
- * allocations.
+ * allocations. The file is removed when the window is released.
  */
-int createStorageInfo(int rank, double factor_orig, MPI_Info* info)
+int createStorageInfo(int rank, Settings *settings, MPI_Info* info)
 {
     char filename[PATH_MAX];
     char factor[PATH_MAX];
     
     // Create the temp. folder
-    CHK(createDir(TMP_FOLDER));
+    CHK(createDir(settings->dir));
     
     // Define the path according to the rank of the process
-    sprintf(filename,  "%s/mpi_swin_%d.win", TMP_FOLDER, rank);
-    sprintf(factor,    "%.9lf", factor_orig);
+    snprintf(filename, PATH_MAX, "%s/mpi_swin_%d.win", settings->dir, rank);
+    sprintf(factor,    "%.9lf", settings->alloc_factor);
 
     CHK(MPI_Info_create(info));
     CHK(MPI_Info_set(*info, MPI_SWIN_ALLOC_TYPE,    "storage"));
-    // CHK(MPI_Info_set(*info, MPI_SWIN_DEVICEID,      "921"));
     CHK(MPI_Info_set(*info, MPI_SWIN_FILENAME,      filename));
     CHK(MPI_Info_set(*info, MPI_SWIN_OFFSET,        "0"));
     CHK(MPI_Info_set(*info, MPI_SWIN_FACTOR,        factor));
-    CHK(MPI_Info_set(*info, MPI_SWIN_UNLINK,        "false"));
+    CHK(MPI_Info_set(*info, MPI_SWIN_UNLINK,        "true"));
+    CHK(MPI_Info_set(*info, MPI_SWIN_HUGEPAGES,     settings->hugepages));
+    CHK(MPI_Info_set(*info, MPI_SWIN_ENGINE,        settings->engine));
     // CHK(MPI_Info_set(*info, MPI_IO_ACCESS_STYLE,    "write_mostly"));
     // CHK(MPI_Info_set(*info, MPI_IO_FILE_PERM,       "S_IRUSR | S_IWUSR"));
     // CHK(MPI_Info_set(*info, MPI_IO_STRIPING_FACTOR, "8"));
@@ -88,13 +201,33 @@ int createStorageInfo(int rank, double factor_orig, MPI_Info* info)
 }
 
 /**
- * Helper method that returns the elapsed time between two time intervals,
- * measured in seconds.
+ * Helper method that transfers a segment to / from the window and waits for
+ * its local completion, recording the latency of the whole operation.
  */
-double getElapsed(struct timeval start, struct timeval stop)
+int transferSegment(MPI_Win win, int drank, char *buffer, size_t segment_size, off_t offset,
+                    int write, Histogram *histogram)
 {
-    return (double)((stop.tv_sec  - start.tv_sec) * 1000000LL +
-                    (stop.tv_usec - start.tv_usec)) / 1000000.0;
+    const uint64_t start = getTime();
+    
+    if (write)
+    {
+        CHK(MPI_Put(buffer, segment_size, MPI_CHAR, drank, offset,
+                    segment_size, MPI_CHAR, win));
+    }
+    else
+    {
+        CHK(MPI_Get(buffer, segment_size, MPI_CHAR, drank, offset,
+                    segment_size, MPI_CHAR, win));
+    }
+    
+    CHK(MPI_Win_flush_local(drank, win));
+    
+    if (histogram != NULL)
+    {
+        addLatency(&histogram[write], getTime() - start);
+    }
+    
+    return MPI_SUCCESS;
 }
 
 /**
@@ -103,27 +236,15 @@ double getElapsed(struct timeval start, struct timeval stop)
  */
 int launchSequentialBenchmark(MPI_Win win, int drank, size_t size,
                               size_t size_b, size_t segment_size,
-                              size_t padding)
+                              size_t padding, Histogram *histogram)
 {
     off_t offset       = 0;
     int   write_active = TRUE;
-    int   write_count  = 0;
     char  *baseptr_tmp = (char *)malloc(segment_size);
     
     for (size_t offset_b = 0; offset_b < size_b; offset_b += segment_size)
     {
-        if (write_active)
-        {
-            CHK(MPI_Put(baseptr_tmp, segment_size, MPI_CHAR, drank, offset,
-                        segment_size, MPI_CHAR, win));
-        }
-        else
-        {
-            CHK(MPI_Get(baseptr_tmp, segment_size, MPI_CHAR, drank, offset,
-                        segment_size, MPI_CHAR, win));
-        }
-        
-        CHK(MPI_Win_flush_local(drank, win));
+        CHK(transferSegment(win, drank, baseptr_tmp, segment_size, offset, write_active, histogram));
         
         offset       = (offset + padding) % size;
         write_active = !write_active;
@@ -139,11 +260,10 @@ int launchSequentialBenchmark(MPI_Win win, int drank, size_t size,
  * combining read / write operations.
  */
 int launchRandomBenchmark(MPI_Win win, int drank, size_t size, size_t size_b,
-                          size_t segment_size)
+                          size_t segment_size, Histogram *histogram)
 {
     off_t    offset       = 0;
     int      write_active = TRUE;
-    int      write_count  = 0;
     char     *baseptr_tmp = (char *)malloc(segment_size);
     uint32_t seed         = 921;
     
@@ -154,147 +274,306 @@ int launchRandomBenchmark(MPI_Win win, int drank, size_t size, size_t size_b,
     {
         offset = ((size_t)rand_r(&seed) * segment_size) % size;
         
-        if (write_active)
+        CHK(transferSegment(win, drank, baseptr_tmp, segment_size, offset, write_active, histogram));
+        
+        write_active = !write_active;
+    }
+    
+    free(baseptr_tmp);
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that launches a single iteration of the given benchmark.
+ */
+int launchBenchmark(MPI_Win win, int rank, Settings *settings, Histogram *histogram)
+{
+    const size_t size    = settings->alloc_size;
+    const size_t segment = settings->segment_size;
+    
+    switch (settings->benchmark)
+    {
+        case BENCHMARK_SEQUENTIAL:
+            return launchSequentialBenchmark(win, rank, size, size, segment, segment, histogram);
+        case BENCHMARK_PADDING:
+            return launchSequentialBenchmark(win, rank, size, size, segment, (segment << 1), histogram);
+        case BENCHMARK_PRANDOM:
+            return launchRandomBenchmark(win, rank, size, size, segment, histogram);
+        case BENCHMARK_MIXED:
+            CHK(launchRandomBenchmark(win, rank, size, (size >> 1), segment, histogram));
+            return launchSequentialBenchmark(win, rank, size, (size >> 1), segment, (segment << 1),
+                                             histogram);
+    }
+    
+    return ERROR;
+}
+
+/**
+ * Helper method that retrieves the index of a value within a list of names,
+ * also accepting the index itself (i.e., the former positional arguments).
+ */
+int parseName(const char *value, const char **names, int num_names, int *index)
+{
+    for (int i = 0; i < num_names; i++)
+    {
+        if (!strcmp(value, names[i]))
         {
-            CHK(MPI_Put(baseptr_tmp, segment_size, MPI_CHAR, drank, offset,
-                        segment_size, MPI_CHAR, win));
+            *index = i;
+            return MPI_SUCCESS;
         }
-        else
+    }
+    
+    CHKB(sscanf(value, "%d", index) != 1 || *index < 0 || *index >= num_names);
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that prints the available options of the benchmark.
+ */
+void printUsage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [options]\n"
+                    "  -b, --benchmark  <sequential|padding|random|mixed>  Access pattern (default: sequential)\n"
+                    "  -t, --alloc-type <memory|storage>                   Type of window allocation (default: memory)\n"
+                    "  -s, --size       <bytes>                            Size of the window per process (required)\n"
+                    "  -f, --factor     <factor>                           Allocation factor of storage windows (default: 1.0)\n"
+                    "  -g, --segment    <bytes>                            Size of each MPI_Put / MPI_Get (required)\n"
+                    "  -i, --iterations <count>                            Measured iterations (default: %d)\n"
+                    "  -w, --warmup     <count>                            Discarded iterations (default: %d)\n"
+                    "  -d, --dir        <path>                             Folder of the window files (default: %s)\n"
+                    "  -H, --hugepages  <none|explicit|transparent>        Huge pages for the memory part (default: none)\n"
+                    "  -e, --engine     <mmap|uffd>                        Paging engine of the storage part (default: mmap)\n"
+                    "  -o, --format     <csv|json>                         Format of the results (default: csv)\n"
+                    "      --header                                        Prints the CSV header before the results\n",
+            program, NUM_ITERATIONS, NUM_ITERATIONS_INIT, TMP_FOLDER);
+}
+
+/**
+ * Helper method that parses the options of the benchmark. An error is
+ * returned if an option is not valid or a required option is missing.
+ */
+int parseSettings(int argc, char *argv[], Settings *settings)
+{
+    const struct option options[] = { { "benchmark",  required_argument, NULL, 'b' },
+                                       { "alloc-type", required_argument, NULL, 't' },
+                                       { "size",       required_argument, NULL, 's' },
+                                       { "factor",     required_argument, NULL, 'f' },
+                                       { "segment",    required_argument, NULL, 'g' },
+                                       { "iterations", required_argument, NULL, 'i' },
+                                       { "warmup",     required_argument, NULL, 'w' },
+                                       { "dir",        required_argument, NULL, 'd' },
+                                       { "hugepages",  required_argument, NULL, 'H' },
+                                       { "engine",     required_argument, NULL, 'e' },
+                                       { "format",     required_argument, NULL, 'o' },
+                                       { "header",     no_argument,       NULL, 'C' },
+                                       { "help",       no_argument,       NULL, 'h' },
+                                       { NULL,         0,                 NULL, 0   } };
+    const char          *formats[] = { "csv", "json" };
+    int                 option     = 0;
+    
+    settings->benchmark      = BENCHMARK_SEQUENTIAL;
+    settings->alloc_type     = ALLOC_MEM;
+    settings->alloc_size     = 0;
+    settings->alloc_factor   = 1.0;
+    settings->segment_size   = 0;
+    settings->num_iterations = NUM_ITERATIONS;
+    settings->num_warmup     = NUM_ITERATIONS_INIT;
+    settings->dir            = TMP_FOLDER;
+    settings->hugepages      = "none";
+    settings->engine         = "mmap";
+    settings->format         = FORMAT_CSV;
+    settings->header         = FALSE;
+    
+    while ((option = getopt_long(argc, argv, "b:t:s:f:g:i:w:d:H:e:o:h", options, NULL)) != ERROR)
+    {
+        switch (option)
         {
-            CHK(MPI_Get(baseptr_tmp, segment_size, MPI_CHAR, drank, offset,
-                        segment_size, MPI_CHAR, win));
+            case 'b': CHK(parseName(optarg, g_benchmark_names, 4, (int *)&settings->benchmark)); break;
+            case 't': CHK(parseName(optarg, g_alloc_names, 2, (int *)&settings->alloc_type));    break;
+            case 's': CHKB(sscanf(optarg, "%zu", &settings->alloc_size) != 1);                 break;
+            case 'f': CHKB(sscanf(optarg, "%lf", &settings->alloc_factor) != 1);               break;
+            case 'g': CHKB(sscanf(optarg, "%zu", &settings->segment_size) != 1);               break;
+            case 'i': CHKB(sscanf(optarg, "%d",  &settings->num_iterations) != 1);             break;
+            case 'w': CHKB(sscanf(optarg, "%d",  &settings->num_warmup) != 1);                 break;
+            case 'd': settings->dir       = optarg;                                             break;
+            case 'H': settings->hugepages = optarg;                                             break;
+            case 'e': settings->engine    = optarg;                                             break;
+            case 'o': CHK(parseName(optarg, formats, 2, (int *)&settings->format));             break;
+            case 'C': settings->header    = TRUE;                                               break;
+            default:  return ERROR;
         }
-        
-        CHK(MPI_Win_flush_local(drank, win));
-        
-        write_active = !write_active;
     }
     
-    free(baseptr_tmp);
+    CHKB(settings->alloc_size == 0 || settings->segment_size == 0 || settings->num_iterations <= 0 ||
+         settings->num_warmup < 0 || optind < argc);
     
     return MPI_SUCCESS;
 }
 
-int main (int argc, char *argv[])
+/**
+ * Helper method that prints the results of the benchmark (i.e., aggregated
+ * for every process) in the requested format.
+ */
+void printResults(Settings *settings, int num_procs, double elapsed, double elapsed_flush,
+                  Histogram *histogram)
 {
-    BenchmarkType  benchmark    = BENCHMARK_SEQUENTIAL;
-    AllocType      alloc_type   = ALLOC_MEM;
-    size_t         alloc_size   = 0;
-    double         alloc_factor = 0.0;
-    size_t         segment_size = 0;
-    MPI_Win        win          = MPI_WIN_NULL;
-    MPI_Info       info         = MPI_INFO_NULL;
-    int            rank         = 0;
-    int            num_procs    = 0;
-    char           *baseptr     = NULL;
-    struct timeval start[2]     = { 0 };
-    struct timeval stop[2]      = { 0 };
-    
-    // Check if the number of parameters match the expected
-    if (argc != 6)
+    const double bandwidth_mb = (num_procs * settings->alloc_size * (double)settings->num_iterations) /
+                                elapsed / CONV_MB;
+    double       latency[2][4];
+    
+    for (int write = 0; write < 2; write++)
     {
-        fprintf(stderr, "Error: The number of parameters is incorrect!\n");
-        return -1;
+        latency[write][0] = (histogram[write].total > 0) ?
+                                ((double)histogram[write].sum / histogram[write].total) * CONV_USEC : 0.0;
+        latency[write][1] = getPercentile(&histogram[write], 0.5);
+        latency[write][2] = getPercentile(&histogram[write], 0.99);
+        latency[write][3] = getPercentile(&histogram[write], 0.999);
     }
     
+    if (settings->format == FORMAT_JSON)
+    {
+        printf("{\"benchmark\": \"%s\", \"alloc_type\": \"%s\", \"num_procs\": %d, \"alloc_size\": %zu, "
+               "\"alloc_factor\": %.9lf, \"segment_size\": %zu, \"hugepages\": \"%s\", \"engine\": \"%s\", "
+               "\"iterations\": %d, \"warmup\": %d, \"elapsed\": %.6lf, \"elapsed_flush\": %.6lf, "
+               "\"bandwidth_mb\": %.6lf, "
+               "\"put_latency_us\": {\"mean\": %.3lf, \"p50\": %.3lf, \"p99\": %.3lf, \"p999\": %.3lf}, "
+               "\"get_latency_us\": {\"mean\": %.3lf, \"p50\": %.3lf, \"p99\": %.3lf, \"p999\": %.3lf}}\n",
+               g_benchmark_names[settings->benchmark], g_alloc_names[settings->alloc_type], num_procs,
+               settings->alloc_size, settings->alloc_factor, settings->segment_size, settings->hugepages,
+               settings->engine, settings->num_iterations, settings->num_warmup, elapsed, elapsed_flush,
+               bandwidth_mb, latency[1][0], latency[1][1], latency[1][2], latency[1][3],
+               latency[0][0], latency[0][1], latency[0][2], latency[0][3]);
+        
+        return;
+    }
+    
+    if (settings->header)
+    {
+        printf("benchmark,alloc_type,num_procs,alloc_size,alloc_factor,segment_size,hugepages,engine,"
+               "iterations,warmup,elapsed,elapsed_flush,bandwidth_mb,"
+               "put_mean_us,put_p50_us,put_p99_us,put_p999_us,get_mean_us,get_p50_us,get_p99_us,get_p999_us\n");
+    }
+    
+    printf("%s,%s,%d,%zu,%.9lf,%zu,%s,%s,%d,%d,%.6lf,%.6lf,%.6lf,"
+           "%.3lf,%.3lf,%.3lf,%.3lf,%.3lf,%.3lf,%.3lf,%.3lf\n",
+           g_benchmark_names[settings->benchmark], g_alloc_names[settings->alloc_type], num_procs,
+           settings->alloc_size, settings->alloc_factor, settings->segment_size, settings->hugepages,
+           settings->engine, settings->num_iterations, settings->num_warmup, elapsed, elapsed_flush,
+           bandwidth_mb, latency[1][0], latency[1][1], latency[1][2], latency[1][3],
+           latency[0][0], latency[0][1], latency[0][2], latency[0][3]);
+}
+
+int main (int argc, char *argv[])
+{
+    Settings  settings     = { 0 };
+    MPI_Win   win          = MPI_WIN_NULL;
+    MPI_Info  info         = MPI_INFO_NULL;
+    int       rank         = 0;
+    int       num_procs    = 0;
+    char      *baseptr     = NULL;
+    Histogram *histogram   = NULL;
+    uint64_t  start[2]     = { 0 };
+    uint64_t  stop[2]      = { 0 };
+    double    elapsed[2]   = { 0 };
+    
     // Initialize MPI and retrieve the rank of the process
     CHKPRINT(MPI_Init(&argc, &argv));
     CHKPRINT(MPI_Comm_rank(MPI_COMM_WORLD, &rank));
     CHKPRINT(MPI_Comm_size(MPI_COMM_WORLD, &num_procs));
     
     // Retrieve the benchmark settings
-    sscanf(argv[1], "%d",  (int *)&benchmark);
-    sscanf(argv[2], "%d",  (int *)&alloc_type);
-    sscanf(argv[3], "%zu", &alloc_size);
-    sscanf(argv[4], "%lf", &alloc_factor);
-    sscanf(argv[5], "%zu", &segment_size);
+    if (parseSettings(argc, argv, &settings) != MPI_SUCCESS)
+    {
+        if (rank == 0)
+        {
+            printUsage(argv[0]);
+        }
+        
+        MPI_Finalize();
+        return -1;
+    }
+    
+    // Note: The histograms of writes and reads are kept separately
+    histogram = (Histogram *)calloc(2, sizeof(Histogram));
     
     // Define the MPI Info object based on the allocation type
-    if (alloc_type == ALLOC_STORAGE)
+    if (settings.alloc_type == ALLOC_STORAGE)
     {
-        CHKPRINT(createStorageInfo(rank, alloc_factor, &info));
+        CHKPRINT(createStorageInfo(rank, &settings, &info));
     }
     
     // Allocate the window with the specified size
-    CHKPRINT(MPI_Win_allocate(alloc_size, sizeof(char), info, MPI_COMM_WORLD,
+    CHKPRINT(MPI_Win_allocate(settings.alloc_size, sizeof(char), info, MPI_COMM_WORLD,
                               (void**)&baseptr, &win));
     
     // Lock the window in exclusive mode
     CHKPRINT(MPI_Win_lock(MPI_LOCK_EXCLUSIVE, rank, 0, win));
     
-    // Launch the benchmark
-    for (uint32_t iteration = 0; iteration < NUM_ITERATIONS_TOTAL; iteration++)
+    // Launch the benchmark, discarding the latencies of the initial iterations
+    for (int iteration = 0; iteration < (settings.num_warmup + settings.num_iterations); iteration++)
     {
         // Start the timer after the initial iterations
-        if (iteration == NUM_ITERATIONS_INIT)
+        if (iteration == settings.num_warmup)
         {
-            gettimeofday(&start[0], NULL);
+            start[0] = getTime();
         }
         
-        if (benchmark == BENCHMARK_SEQUENTIAL)
-        {
-            CHK(launchSequentialBenchmark(win, rank, alloc_size, alloc_size,
-                                          segment_size, segment_size));
-        }
-        else if (benchmark == BENCHMARK_PADDING)
-        {
-            CHK(launchSequentialBenchmark(win, rank, alloc_size, alloc_size,
-                                          segment_size, (segment_size << 1)));
-        }
-        else if (benchmark == BENCHMARK_PRANDOM)
-        {
-            CHK(launchRandomBenchmark(win, rank, alloc_size, alloc_size,
-                                      segment_size));
-        }
-        else if (benchmark == BENCHMARK_MIXED)
-        {
-            CHK(launchRandomBenchmark(win, rank, alloc_size, (alloc_size >> 1),
-                                      segment_size));
-            CHK(launchSequentialBenchmark(win, rank, alloc_size,
-                                          (alloc_size >> 1), segment_size,
-                                          (segment_size << 1)));
-        }
+        CHKPRINT(launchBenchmark(win, rank, &settings, ((iteration < settings.num_warmup) ? NULL :
+                                                                                            histogram)));
     }
     
     // Synchronize the storage window
-    gettimeofday(&start[1], NULL);
-    if (alloc_type == ALLOC_STORAGE)
+    start[1] = getTime();
+    if (settings.alloc_type == ALLOC_STORAGE)
     {
         CHKPRINT(MPI_Win_sync(win));
     }
-    gettimeofday(&stop[1], NULL);
-    gettimeofday(&stop[0], NULL);
+    stop[1] = getTime();
+    stop[0] = getTime();
     
     // Unlock the window
     CHKPRINT(MPI_Win_unlock(rank, win));
     
+    // Aggregate the results of every process (i.e., the slowest process
+    // determines the bandwidth)
+    elapsed[0] = (stop[0] - start[0]) * 1e-9;
+    elapsed[1] = (stop[1] - start[1]) * 1e-9;
+    
+    CHKPRINT(MPI_Reduce((rank == 0) ? MPI_IN_PLACE : elapsed, elapsed, 2, MPI_DOUBLE, MPI_MAX, 0,
+                        MPI_COMM_WORLD));
+    CHKPRINT(MPI_Reduce((rank == 0) ? MPI_IN_PLACE : histogram, histogram,
+                        (sizeof(Histogram) / sizeof(uint64_t)) * 2, MPI_UINT64_T, MPI_SUM, 0,
+                        MPI_COMM_WORLD));
+    
     // Print the result
+    if (rank == 0)
     {
-        double elapsed       = getElapsed(start[0], stop[0]);
-        double elapsed_flush = getElapsed(start[1], stop[1]);
-        double bandwidth     = (alloc_size * NUM_ITERATIONS) / elapsed;
-        double bandwidth_mb  = bandwidth / 1048576.0;
-        
-        printf("%d; %d; %zu; %.9lf; %zu; %.6lf; %.6lf; %.6lf\n", benchmark,
-                                                                 alloc_type,
-                                                                 alloc_size,
-                                                                 alloc_factor,
-                                                                 segment_size,
-                                                                 elapsed,
-                                                                 elapsed_flush,
-                                                                 bandwidth_mb);
+        printResults(&settings, num_procs, elapsed[0], elapsed[1], histogram);
     }
     
     // Force all processes to wait before releasing
     CHKPRINT(MPI_Barrier(MPI_COMM_WORLD));
     
-    // Release the window and finalize the MPI session
+    // Release the window and finalize the MPI session (note that the files
+    // are removed with the window)
     CHKPRINT(MPI_Win_free(&win));
-    CHKPRINT(MPI_Finalize());
     
-    // Delete the temp. folder
-    CHKPRINT(deleteDir(TMP_FOLDER));
+    // Delete the temp. folder, if empty (i.e., only created for the benchmark)
+    if (settings.alloc_type == ALLOC_STORAGE)
+    {
+        CHKPRINT(MPI_Barrier(MPI_COMM_WORLD));
+        
+        if (rank == 0)
+        {
+            rmdir(settings.dir);
+        }
+    }
+    
+    free(histogram);
+    
+    CHKPRINT(MPI_Finalize());
     
     return MPI_SUCCESS;
 }
-
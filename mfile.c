@@ -1,42 +1,584 @@
 
 #include "common.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/vfs.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/falloc.h>
 #include "mfile.h"
+#include "mfile_uffd.h"
+#include "mfile_tier.h"
+#include "mfile_trace.h"
+#include "mfile_uring.h"
 
 #define MMAP_PROT  (PROT_READ  | PROT_WRITE | PROT_EXEC)
 #define MMAP_FLAGS (MAP_SHARED | MAP_NORESERVE) // Note: MAP_NORESERVE is
                                                 // needed to avoid swapping
 
-size_t g_pagesize = 0;
+#ifndef MADV_POPULATE_READ
+#define MADV_POPULATE_READ  22
+#define MADV_POPULATE_WRITE 23
+#endif
 
-#define ALIGN_OFFSET(offset) (((offset) / g_pagesize) * g_pagesize)
+#define MEMINFO_PATH        "/proc/meminfo"
+#define MEMINFO_HUGEPAGES   "Hugepagesize: %zu kB"
+#define HUGEPAGES_FLAGS     (MFILE_HUGEPAGES_EXPLICIT | MFILE_HUGEPAGES_TRANSPARENT)
+#define PREALLOC_FLAGS      (MFILE_PREALLOC_FALLOCATE | MFILE_PREALLOC_KEEP_SIZE | \
+                             MFILE_PREALLOC_ZERO_RANGE | MFILE_PREALLOC_AUTO)
+
+// File systems where the files are extended with ftruncate by the auto mode
+#define FS_MAGIC_LUSTRE     0x0BD00BD0          // Older versions fail with fallocate
+#define FS_MAGIC_GPFS       0x47504653          // Emulated (i.e., writes zeros)
+#define FS_MAGIC_NFS        0x6969              // Not supported before NFSv4.2
+#define FS_MAGIC_TMPFS      0x01021994          // Allocates the pages in memory
+
+#define STRIPE_SIZE_DEFAULT (1 << 20)           // Size of the stripes if not given (i.e., 1 MB)
+#define STRIPE_SEPARATOR    ","                 // Separator of the files of a striped mapping
+
+// Definitions of the Lustre layout interface (i.e., lustre_user.h), which
+// avoid depending on the headers of the client to set the striping
+#define LUSTRE_DELAY_CREATE     (O_NOCTTY | FASYNC) // Opens the file without objects
+#define LUSTRE_USER_MAGIC_V1    0x0BD10BD0
+#define LUSTRE_PATTERN_RAID0    0x001
+#define LUSTRE_OFFSET_DEFAULT   0xFFFF              // Lets the MDS select the first OST
+#define LUSTRE_IOC_SETSTRIPE    _IOW('f', 154, long)
+
+/**
+ * Structure that defines the layout of a Lustre file (i.e., lov_user_md_v1).
+ */
+typedef struct
+{
+    uint32_t magic;         // Version of the structure
+    uint32_t pattern;       // Striping pattern of the file
+    uint64_t object[2];     // Identifier of the object (ignored)
+    uint32_t stripe_size;   // Size of each stripe
+    uint16_t stripe_count;  // Number of OSTs (-1 uses every OST)
+    uint16_t stripe_offset; // Index of the first OST
+} __attribute__((packed)) MFILE_Lustre_Layout;
+
+/**
+ * Structure that associates a type of file system with the handler that
+ * creates a file with the requested layout.
+ */
+typedef struct
+{
+    unsigned int fs_type;                                           // Magic number of the file system
+    int          (*create)(char const *, int, const MFILE_Layout *);  // Handler of the file system
+} MFILE_Layout_Handler;
+
+/**
+ * Structure that defines the ranges of the mapping prefaulted by a thread
+ * (i.e., one range inside the memory part and another inside the storage).
+ */
+typedef struct
+{
+    char   *addr[2];    // Start of the ranges (aligned to the page size)
+    size_t length[2];   // Length of the ranges
+    int    write[2];    // Flags that determine if the ranges are prefaulted for writing
+    int    error;       // Result of the operation
+} MFILE_Populate;
+
+size_t         g_pagesize      = 0;
+size_t         g_hugepagesize  = 0;
+pthread_once_t g_pagesize_once = PTHREAD_ONCE_INIT;
+MFILE_Stats    g_stats         = { 0 };             // Counters of every mapping of the process
+
+#define ALIGN_OFFSET(offset)        (((offset) / g_pagesize) * g_pagesize)
+#define ALIGN_DOWN(value, align)    (((value) / (align)) * (align))
+#define ALIGN_UP(value, align)      ((((value) + (align) - 1) / (align)) * (align))
+
+/**
+ * Helper method that retrieves the page size and the default huge page size,
+ * and caches them. The huge page size is set to zero if not available.
+ */
+void initPageSize()
+{
+    char line[PATH_MAX];
+    FILE *file = fopen(MEMINFO_PATH, "r");
+    
+    g_pagesize = sysconf(_SC_PAGESIZE);
+    
+    while (file != NULL && fgets(line, sizeof(line), file) != NULL)
+    {
+        if (sscanf(line, MEMINFO_HUGEPAGES, &g_hugepagesize) == 1)
+        {
+            g_hugepagesize <<= 10;
+            break;
+        }
+    }
+    
+    if (file != NULL)
+    {
+        fclose(file);
+    }
+}
+
+/**
+ * Helper method that maps the memory part of the allocation at the given
+ * address, backed by huge pages if requested. Explicit huge pages fall back
+ * to transparent huge pages if the pool is empty, which are only a hint for
+ * the kernel (i.e., the default page size is used if not supported). The
+ * mapping is always shared, as the rest of the allocation.
+ */
+void *mapMemory(void *addr, size_t length, int prot, int flags)
+{
+    void *addr_m = MAP_FAILED;
+    
+    if (flags & MFILE_HUGEPAGES_EXPLICIT)
+    {
+        // Note: MAP_NORESERVE is not used, as the huge pages would be retrieved
+        //       from the pool on page fault and the process could get SIGBUS
+        addr_m = mmap(addr, length, prot, MAP_SHARED | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0);
+        
+        if (addr_m == MAP_FAILED)
+        {
+            DBGPRINTF("Huge pages not available, using transparent huge pages (errno=%d)", errno);
+        }
+    }
+    
+    if (addr_m == MAP_FAILED)
+    {
+        addr_m = mmap(addr, length, prot, MMAP_FLAGS | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+        
+        // Note: Transparent huge pages for shared anonymous memory also depend
+        //       on /sys/kernel/mm/transparent_hugepage/shmem_enabled
+        if (addr_m != MAP_FAILED && (flags & HUGEPAGES_FLAGS) &&
+            madvise(addr_m, length, MADV_HUGEPAGE) != MPI_SUCCESS)
+        {
+            DBGPRINTF("Transparent huge pages not available (errno=%d)", errno);
+        }
+    }
+    
+    return addr_m;
+}
+
+
+/**
+ * Helper method that selects the preallocation of the file given the type of
+ * file system, or zero if the file should be extended with ftruncate.
+ */
+int selectPrealloc(int fd)
+{
+    struct statfs st;
+    
+    if (fstatfs(fd, &st) != MPI_SUCCESS)
+    {
+        return 0;
+    }
+    
+    switch ((unsigned int)st.f_type)
+    {
+        case FS_MAGIC_LUSTRE:
+        case FS_MAGIC_GPFS:
+        case FS_MAGIC_NFS:
+        case FS_MAGIC_TMPFS:
+            return 0;
+        default:
+            return MFILE_PREALLOC_FALLOCATE;
+    }
+}
+
+/**
+ * Helper method that extends the file up to the given size, preallocating the
+ * extents of the extended region (and not the rest of the file) if requested.
+ * If the file system does not support the preallocation, the method falls
+ * back to ftruncate.
+ */
+int extendFile(int fd, size_t size_old, size_t size, int flags)
+{
+    int hr = ERROR;
+    
+    if (flags & MFILE_PREALLOC_AUTO)
+    {
+        flags = selectPrealloc(fd);
+    }
+    
+    if (flags & MFILE_PREALLOC_FALLOCATE)
+    {
+        hr = fallocate(fd, 0, size_old, size - size_old);
+    }
+    else if (flags & MFILE_PREALLOC_KEEP_SIZE)
+    {
+        // Note: The file size is updated afterwards with ftruncate
+        hr = fallocate(fd, FALLOC_FL_KEEP_SIZE, size_old, size - size_old);
+        hr = (hr == MPI_SUCCESS) ? ftruncate(fd, size) : hr;
+    }
+    else if (flags & MFILE_PREALLOC_ZERO_RANGE)
+    {
+        hr = fallocate(fd, FALLOC_FL_ZERO_RANGE, size_old, size - size_old);
+    }
+    
+    if (hr != MPI_SUCCESS)
+    {
+        DBGPRINTF("Extending file with ftruncate (flags=%d errno=%d)", flags, (flags & PREALLOC_FLAGS) ? errno : 0);
+        
+        // Important: posix_fallocate is more efficient, but older versions of Lustre will
+        // produce unexpected results and cause errors.
+        
+        hr = ftruncate(fd, size);
+    }
+    
+    return hr;
+}
+
+/**
+ * Helper method that retrieves the alignment of the boundary between memory
+ * and storage (i.e., the huge page size if the memory part requires them).
+ */
+size_t getSplitAlign(int flags)
+{
+    return ((flags & HUGEPAGES_FLAGS) && g_hugepagesize > g_pagesize) ? g_hugepagesize : g_pagesize;
+}
+
+/**
+ * Helper method that retrieves the length of the storage part of a mapping,
+ * aligning the boundary with the memory part to the given alignment.
+ */
+size_t getStorageLength(size_t length, double factor, int order, size_t split_align)
+{
+    const size_t length_s = (double)length * factor;
+    
+    return (order == 0) ? (length - ALIGN_DOWN(length - length_s, split_align)) :
+                          ALIGN_DOWN(length_s, split_align);
+}
+
+/**
+ * Helper method that creates a Lustre file with the given striping, through
+ * the layout ioctl on a file opened without objects. The layout has to be set
+ * before the first write, and thus the file must not exist.
+ */
+int createLustreFile(char const *filename, int file_perm, const MFILE_Layout *layout)
+{
+    MFILE_Lustre_Layout lum = { 0 };
+    int                 fd  = open(filename, O_CREAT | O_EXCL | O_RDWR | LUSTRE_DELAY_CREATE, file_perm);
+    
+    // Note: Another process created the file in the meantime
+    if (fd == ERROR)
+    {
+        return (errno == EEXIST) ? MPI_SUCCESS : ERROR;
+    }
+    
+    lum.magic         = LUSTRE_USER_MAGIC_V1;
+    lum.pattern       = LUSTRE_PATTERN_RAID0;
+    lum.stripe_size   = layout->stripe_size;
+    lum.stripe_count  = layout->stripe_count;
+    lum.stripe_offset = LUSTRE_OFFSET_DEFAULT;
+    
+    if (ioctl(fd, LUSTRE_IOC_SETSTRIPE, &lum) == ERROR)
+    {
+        DBGPRINTF("Lustre layout not applied to \"%s\" (errno=%d)", filename, errno);
+        
+        close(fd);
+        unlink(filename);
+        
+        return ERROR;
+    }
+    
+    return close(fd);
+}
+
+// Handlers of the file systems that support setting the layout of new files
+const MFILE_Layout_Handler g_layout_handlers[] = { { FS_MAGIC_LUSTRE, createLustreFile } };
+
+/**
+ * Helper method that retrieves the file system of a file, which is determined
+ * by the parent directory if the file does not exist yet.
+ */
+int getFileSystem(char const *filename, struct statfs *st)
+{
+    char path[PATH_MAX];
+    char *separator = NULL;
+    
+    if (statfs(filename, st) == MPI_SUCCESS)
+    {
+        return MPI_SUCCESS;
+    }
+    
+    strncpy(path, filename, PATH_MAX - 1);
+    path[PATH_MAX - 1] = '\0';
+    separator          = strrchr(path, '/');
+    
+    if (separator == NULL)
+    {
+        strcpy(path, ".");
+    }
+    else
+    {
+        separator[(separator == path)] = '\0';
+    }
+    
+    return statfs(path, st);
+}
+
+/**
+ * Helper method that creates a file with the given layout, if the file does
+ * not exist and its file system supports it.
+ */
+int createLayoutFile(char const *filename, int file_perm, const MFILE_Layout *layout)
+{
+    const size_t  num_handlers = sizeof(g_layout_handlers) / sizeof(MFILE_Layout_Handler);
+    struct statfs st;
+    
+    if (access(filename, F_OK) == MPI_SUCCESS)
+    {
+        return MPI_SUCCESS;
+    }
+    
+    CHK(getFileSystem(filename, &st));
+    
+    for (size_t i = 0; i < num_handlers; i++)
+    {
+        if ((unsigned int)st.f_type == g_layout_handlers[i].fs_type)
+        {
+            return g_layout_handlers[i].create(filename, file_perm, layout);
+        }
+    }
+    
+    return MPI_SUCCESS;
+}
+
+int mflayout(char const *filename, int file_perm, MFILE_Layout layout)
+{
+    char *filenames = NULL;
+    char *saveptr   = NULL;
+    int  error      = MPI_SUCCESS;
+    
+    if (layout.stripe_count == 0 && layout.stripe_size == 0)
+    {
+        return MPI_SUCCESS;
+    }
+    
+    // Note: Each file of a striped mapping receives the same layout
+    filenames = strdup(filename);
+    
+    for (char *name = strtok_r(filenames, STRIPE_SEPARATOR, &saveptr); name != NULL && error == MPI_SUCCESS;
+         name = strtok_r(NULL, STRIPE_SEPARATOR, &saveptr))
+    {
+        error = createLayoutFile(name, file_perm, &layout);
+    }
+    
+    free(filenames);
+    
+    return error;
+}
+
+int mfshared(char const *filename)
+{
+    struct statfs st;
+    
+    if (getFileSystem(filename, &st) != MPI_SUCCESS)
+    {
+        return FALSE;
+    }
+    
+    switch ((unsigned int)st.f_type)
+    {
+        case FS_MAGIC_LUSTRE:
+        case FS_MAGIC_GPFS:
+        case FS_MAGIC_NFS:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+size_t mfextent(size_t offset, size_t length, double factor, int order, int flags)
+{
+    size_t offset_aligned = 0;
+    
+    pthread_once(&g_pagesize_once, initPageSize);
+    
+    offset_aligned = ALIGN_OFFSET(offset);
+    length        += (offset - offset_aligned);
+    
+    return offset_aligned + getStorageLength(length, factor, order, getSplitAlign(flags));
+}
+
+int mfcreate(char const *filename, size_t size, int file_flags, int file_perm, int flags)
+{
+    int         fd = open(filename, file_flags, file_perm);
+    struct stat st;
+    
+    CHKB(fd == ERROR);
+    
+    if (fstat(fd, &st) != MPI_SUCCESS || (size > (size_t)st.st_size &&
+                                          extendFile(fd, st.st_size, size, flags & PREALLOC_FLAGS) != MPI_SUCCESS))
+    {
+        close(fd);
+        
+        return ERROR;
+    }
+    
+    return close(fd);
+}
+
+/**
+ * Helper method that opens the files of a striped mapping (i.e., a list of
+ * filenames separated by commas), and retrieves if every file existed before.
+ * The stripes are NULL if a single file is given without stride.
+ */
+int openStripes(char const *filename, int file_flags, int file_perm, size_t stripe_size, size_t stripe_stride,
+                int *file_exists, MFILE_Stripes **stripes)
+{
+    char *filenames = NULL;
+    char *saveptr   = NULL;
+    int  count      = 1;
+    
+    *stripes = NULL;
+    
+    for (const char *c = filename; *c != '\0'; c++)
+    {
+        count += (*c == STRIPE_SEPARATOR[0]);
+    }
+    
+    if (count == 1 && stripe_stride == 0)
+    {
+        return MPI_SUCCESS;
+    }
+    
+    *stripes           = (MFILE_Stripes *)calloc(1, sizeof(MFILE_Stripes));
+    (*stripes)->fds    = (int *)malloc(sizeof(int) * count);
+    (*stripes)->size   = ALIGN_UP(((stripe_size > 0) ? stripe_size : STRIPE_SIZE_DEFAULT), g_pagesize);
+    (*stripes)->stride = ALIGN_UP(((stripe_stride > 0) ? stripe_stride : (*stripes)->size), (*stripes)->size);
+    filenames          = strdup(filename);
+    *file_exists       = TRUE;
+    
+    for (char *name = strtok_r(filenames, STRIPE_SEPARATOR, &saveptr); name != NULL;
+         name = strtok_r(NULL, STRIPE_SEPARATOR, &saveptr))
+    {
+        int fd = ERROR;
+        
+        *file_exists &= (access(name, F_OK) == 0);
+        
+        fd = open(name, file_flags, file_perm);
+        
+        if (fd == ERROR)
+        {
+            break;
+        }
+        
+        (*stripes)->fds[(*stripes)->count++] = fd;
+    }
+    
+    free(filenames);
+    
+    // Note: Empty filenames are not accepted (e.g., a trailing separator)
+    if ((*stripes)->count < count)
+    {
+        for (int i = 0; i < (*stripes)->count; i++)
+        {
+            close((*stripes)->fds[i]);
+        }
+        
+        free((*stripes)->fds);
+        free(*stripes);
+        
+        return ERROR;
+    }
+    
+    DBGPRINTF("Striped mapping opened with count=%d stripe_size=%zu stride=%zu", (*stripes)->count, (*stripes)->size,
+                                                                                 (*stripes)->stride);
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that maps the storage part of a striped mapping at the given
+ * address, with one fixed mapping per stripe. Each file is extended first up
+ * to the end of its last stripe.
+ */
+void *mapStripes(MFILE_Stripes *stripes, void *addr, size_t length, int prot, size_t offset, int flags)
+{
+    const size_t num_stripes = (length + stripes->size - 1) / stripes->size;
+    
+    for (size_t i = 0; i < (size_t)stripes->count && i < num_stripes; i++)
+    {
+        const size_t last     = i + ((num_stripes - 1 - i) / stripes->count) * stripes->count;
+        const size_t length_l = ((length - last * stripes->size) < stripes->size) ? (length - last * stripes->size) :
+                                                                                    stripes->size;
+        const size_t end      = offset + (last / stripes->count) * stripes->stride + length_l;
+        struct stat  st;
+        
+        if (fstat(stripes->fds[i], &st) == ERROR)
+        {
+            return MAP_FAILED;
+        }
+        
+        // Only the mapped region is preallocated if the offset is beyond the
+        // end of the file (i.e., the gap remains sparse)
+        if (end > (size_t)st.st_size &&
+            extendFile(stripes->fds[i], (offset > (size_t)st.st_size) ? offset : (size_t)st.st_size, end,
+                       flags & PREALLOC_FLAGS) != MPI_SUCCESS)
+        {
+            return MAP_FAILED;
+        }
+    }
+    
+    for (size_t k = 0; k < num_stripes; k++)
+    {
+        const size_t length_k = ((length - k * stripes->size) < stripes->size) ? (length - k * stripes->size) :
+                                                                                 stripes->size;
+        void         *addr_k  = mmap((char *)addr + k * stripes->size, length_k, prot, MMAP_FLAGS | MAP_FIXED,
+                                     stripes->fds[k % stripes->count],
+                                     offset + (k / stripes->count) * stripes->stride);
+        
+        if (addr_k == MAP_FAILED)
+        {
+            return MAP_FAILED;
+        }
+    }
+    
+    return addr;
+}
 
 int mfalloc(char const *filename, size_t offset, size_t length, double factor,
             int order, int unlink, int access_style, int file_flags,
-            int file_perm, MFILE *mfile)
+            int file_perm, int flags, size_t stripe_size, size_t stripe_stride,
+            MFILE *mfile)
 {
     int     fd             = 0;
     size_t  offset_aligned = 0;
+    size_t  split_align    = 0;
     int     filename_size  = 0;
     void*   addr           = NULL;
+    void*   addr_s         = NULL;
+    size_t  length_s       = 0;
     int     file_exists    = FALSE;
+    size_t  start          = mftime();
+    MFILE_Stripes *stripes = NULL;
     struct stat st;
     
-    // Check if the file exists before proceeding
-    file_exists = (access(filename, F_OK) == 0);
-    
-    // Open / create the file with the provided permissions
-    fd = open(filename, file_flags, file_perm);
-    CHKB(fd == ERROR);
+    // Retrieve the page size and cache it, if required
+    pthread_once(&g_pagesize_once, initPageSize);
     
-    CHK(fstat(fd, &st));
+    // Open the files of the storage part if it is striped, or check if the
+    // file exists before proceeding otherwise
+    CHK(openStripes(filename, file_flags, file_perm, stripe_size, stripe_stride, &file_exists, &stripes));
     
-    // Retrieve the page size and cache it, if required
-    if (g_pagesize == 0)
+    if (stripes == NULL)
     {
-        g_pagesize = sysconf(_SC_PAGESIZE);
+        file_exists = (access(filename, F_OK) == 0);
+        
+        // Open / create the file with the provided permissions
+        fd = open(filename, file_flags, file_perm);
+        CHKB(fd == ERROR);
     }
+    else
+    {
+        // Note: The full length of the files cannot be inferred if striped,
+        //       and the flushes cannot be issued through a single descriptor
+        CHKB(length == 0);
+        
+        fd     = stripes->fds[0];
+        flags &= ~MFILE_FLUSH_FDATASYNC;
+    }
+    
+    CHK(fstat(fd, &st));
     
     offset_aligned = ALIGN_OFFSET(offset);
+    split_align    = getSplitAlign(flags);
     
     // If file exists, check if it was requested to map the full-length of the file
     if (file_exists)
@@ -56,94 +598,178 @@ int mfalloc(char const *filename, size_t offset, size_t length, double factor,
     if (length > 0)
     {
         void   *addr_tmp = NULL;
-        size_t length_s  = (double)length * factor;
+        void   *addr_r   = NULL;
         size_t length_m  = 0;
+        size_t length_r  = 0;
         int    prot      = (file_flags & O_RDONLY) ? PROT_READ  :
                            (file_flags & O_WRONLY) ? PROT_WRITE :
                                                      MMAP_PROT;
         
-        // Update the storage length based on the aligned offset
-        if (order == 0)
+        // Update the storage length based on the aligned offset, but align the
+        // boundary to the huge page size if the memory part requires them
+        length_s = getStorageLength(length, factor, order, split_align);
+        length_m = length - length_s;
+        
+        // Explicit huge pages can only be unmapped using the huge page size
+        if ((flags & MFILE_HUGEPAGES_EXPLICIT) && length_m > 0)
         {
-            length_m = ALIGN_OFFSET(length - length_s);
-            length_s = length - length_m;
+            length_m = ALIGN_UP(length_m, split_align);
+            length   = length_s + length_m;
         }
-        else
+        
+        // Truncate the content by taking into account the offset (note that
+        // the files of a striped mapping are extended while being mapped)
+        if (stripes == NULL && (offset_aligned + length_s) > (size_t)st.st_size)
         {
-            length_s = ALIGN_OFFSET(length_s);
-            length_m = length - length_s;
+            // Only the mapped region is preallocated if the offset is beyond
+            // the end of the file (i.e., the gap remains sparse)
+            const size_t size_old = (offset_aligned > (size_t)st.st_size) ? offset_aligned : (size_t)st.st_size;
+            
+            CHK(extendFile(fd, size_old, offset_aligned + length_s, flags & PREALLOC_FLAGS));
         }
-    
-        // Truncate the content by taking into account the offset
-        if ((offset_aligned + length_s) > st.st_size)
+        
+        // Create an anonymous mapping to reserve the virtual addresses, which is
+        // extended to align the beginning of the range to the split alignment
+        length_r = length + (split_align - g_pagesize);
+        addr_r   = mmap(NULL, length_r, PROT_NONE, MAP_PRIVATE | MAP_NORESERVE | MAP_ANONYMOUS, -1, 0);
+        CHKB(addr_r == MAP_FAILED);
+        
+        addr = (void *)ALIGN_UP((uintptr_t)addr_r, split_align);
+        
+        // Release the unaligned head and tail of the reservation (note that the
+        // rest of the range is replaced by the fixed mappings that follow)
+        if ((char *)addr > (char *)addr_r)
         {
-            // Important: posix_fallocate is more efficient, but older versions of Lustre will
-            // produce unexpected results and cause errors.
-            
-            CHK(ftruncate(fd, offset_aligned + length_s));
+            CHK(munmap(addr_r, (char *)addr - (char *)addr_r));
         }
         
-        // Create an anonymous mapping to reserve the virtual addresses
-        addr = mmap(NULL, length, MMAP_PROT, MMAP_FLAGS | MAP_ANONYMOUS, -1, 0);
-        CHKB(addr == MAP_FAILED || munmap(addr, length) != MPI_SUCCESS);
+        if (((char *)addr + ALIGN_UP(length, g_pagesize)) < ((char *)addr_r + length_r))
+        {
+            char *addr_tail = (char *)addr + ALIGN_UP(length, g_pagesize);
+            
+            CHK(munmap(addr_tail, ((char *)addr_r + length_r) - addr_tail));
+        }
         
         // Divide the virtual address range between memory and storage
         if (order == 0)
         {
             if (length_m > 0)
             {
-                addr_tmp = (char *)mmap(addr, length_m, prot,
-                                        MMAP_FLAGS | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+                addr_tmp = mapMemory(addr, length_m, prot, flags);
                 CHKB(addr_tmp == MAP_FAILED);
             }
             
-            addr_tmp = mmap(((char *)addr) + length_m, length_s, prot, MMAP_FLAGS | MAP_FIXED, fd,
-                            offset_aligned);
+            addr_tmp = (stripes != NULL) ?
+                            mapStripes(stripes, ((char *)addr) + length_m, length_s, prot, offset_aligned, flags) :
+                            mmap(((char *)addr) + length_m, length_s, prot, MMAP_FLAGS | MAP_FIXED, fd,
+                                 offset_aligned);
             CHKB(addr_tmp == MAP_FAILED);
         
             CHK(madvise(addr_tmp, length_s, access_style));
+            
+            addr_s = addr_tmp;
         }
         else
         {
-            addr_tmp = mmap(addr, length_s, prot, MMAP_FLAGS | MAP_FIXED, fd,
-                            offset_aligned);
+            addr_tmp = (stripes != NULL) ? mapStripes(stripes, addr, length_s, prot, offset_aligned, flags) :
+                                           mmap(addr, length_s, prot, MMAP_FLAGS | MAP_FIXED, fd, offset_aligned);
             CHKB(addr_tmp == MAP_FAILED);
         
             CHK(madvise(addr_tmp, length_s, access_style));
             
+            addr_s = addr_tmp;
+            
             if (length_m > 0)
             {
-                addr_tmp = (char *)mmap(((char *)addr) + length_s, length_m, prot,
-                                        MMAP_FLAGS | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+                addr_tmp = mapMemory(((char *)addr) + length_s, length_m, prot, flags);
                 CHKB(addr_tmp == MAP_FAILED);
             }
         }
     }
  
-    CHK(close(fd));
-    
-    // Fill the output MFILE object with the mapping details
-    mfile->addr     = addr;
-    mfile->addr_src = (void *)((char *)addr + (offset - offset_aligned));
-    mfile->offset   = offset_aligned;
-    mfile->length   = length;
-    filename_size   = sizeof(char) * (strlen(filename) + 1);
-    mfile->filename = (char *)malloc(filename_size);
-    mfile->unlink   = unlink;
+    // Fill the output MFILE object with the mapping details (note that the file
+    // descriptor is kept open for the flushes and the write-back)
+    mfile->fd           = fd;
+    mfile->flags        = flags;
+    mfile->addr         = addr;
+    mfile->addr_src     = (void *)((char *)addr + (offset - offset_aligned));
+    mfile->offset       = offset_aligned;
+    mfile->length       = length;
+    filename_size       = sizeof(char) * (strlen(filename) + 1);
+    mfile->filename     = (char *)malloc(filename_size);
+    mfile->unlink       = unlink;
+    mfile->addr_s       = addr_s;
+    mfile->length_s     = length_s;
+    mfile->stats        = (MFILE_Stats *)calloc(1, sizeof(MFILE_Stats));
+    mfile->sync_chunk   = 0;
+    mfile->sync_threads = 1;
+    mfile->uffd         = NULL;
+    mfile->io_threshold = 0;
+    mfile->direct       = NULL;
+    mfile->tier         = NULL;
+    mfile->header       = SIZE_MAX;
+    mfile->stripes      = stripes;
     
     memcpy(mfile->filename, filename, filename_size);
     
+    __atomic_fetch_add(&g_stats.num_allocs, 1, __ATOMIC_RELAXED);
+    mfile->stats->num_allocs = 1;
+    mfstats_alloc(*mfile, mftime() - start);
+    
     return MPI_SUCCESS;
 }
 
-int mfsync(MFILE mfile)
+/**
+ * Helper method that converts a range of the mapping into the equivalent range
+ * of the file, clipped to the storage part. Returns FALSE if the range does
+ * not overlap with the storage part.
+ */
+int getFileRange(MFILE mfile, size_t offset, size_t length, off_t *offset_f, off_t *length_f)
 {
-    return msync(mfile.addr, mfile.length, MS_SYNC);
+    const size_t offset_s = (char *)mfile.addr_s - (char *)mfile.addr;
+    const size_t start    = (offset > offset_s) ? offset : offset_s;
+    const size_t end      = ((offset + length) < (offset_s + mfile.length_s)) ? (offset + length) :
+                                                                               (offset_s + mfile.length_s);
+    
+    *offset_f = mfile.offset + (start - offset_s);
+    *length_f = (end > start) ? (end - start) : 0;
+    
+    return (end > start);
 }
 
-int mfsync_at(MFILE mfile, size_t offset, size_t length, int async)
+/**
+ * Helper method that starts the write-back of the given range of the mapping
+ * (relative to the beginning of the mapping), without waiting for it. The
+ * files of a striped mapping are only written back when waited.
+ */
+int startRange(MFILE mfile, size_t offset, size_t length)
 {
     const size_t offset_aligned = ALIGN_OFFSET(offset);
+    off_t        offset_f       = 0;
+    off_t        length_f       = 0;
+    
+    if (mfile.stripes != NULL)
+    {
+        return MPI_SUCCESS;
+    }
+    
+    return (getFileRange(mfile, offset_aligned, length + (offset - offset_aligned), &offset_f, &length_f)) ?
+                sync_file_range(mfile.fd, offset_f, length_f, SYNC_FILE_RANGE_WRITE) : MPI_SUCCESS;
+}
+
+/**
+ * Helper method that flushes the given range of the mapping (relative to the
+ * beginning of the mapping) without updating the counters. Note that with
+ * MFILE_FLUSH_FDATASYNC, the method only starts the write-back of the range.
+ */
+int syncRange(MFILE mfile, size_t offset, size_t length, int async)
+{
+    const size_t offset_aligned = ALIGN_OFFSET(offset);
+    
+    if (mfile.flags & MFILE_FLUSH_FDATASYNC)
+    {
+        return startRange(mfile, offset, length);
+    }
     
     // Extend the requested length if the offset was aligned
     length += (offset - offset_aligned);
@@ -151,19 +777,573 @@ int mfsync_at(MFILE mfile, size_t offset, size_t length, int async)
     return msync((char*)mfile.addr + offset_aligned, length, ((async) ? MS_ASYNC : MS_SYNC));
 }
 
+/**
+ * Helper method that waits for the write-back of the given range of the
+ * mapping, including pages modified after it was started, and persists the
+ * metadata of the file afterwards (e.g., the allocated extents).
+ */
+int waitRange(MFILE mfile, size_t offset, size_t length)
+{
+    const int flags    = SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER;
+    off_t     offset_f = 0;
+    off_t     length_f = 0;
+    
+    if (getFileRange(mfile, ALIGN_OFFSET(offset), length + (offset - ALIGN_OFFSET(offset)), &offset_f, &length_f))
+    {
+        CHK(sync_file_range(mfile.fd, offset_f, length_f, flags));
+        CHK(fdatasync(mfile.fd));
+    }
+    
+    return MPI_SUCCESS;
+}
+
+int mfsync(MFILE mfile)
+{
+    size_t bytes = 0;
+    size_t start = mftime();
+    
+    if (mfile.uffd != NULL)
+    {
+        CHK(mfuffd_flush(mfile, 0, mfile.length_s, &bytes));
+        
+        // Note: The memory part does not require to be flushed
+        mfstats_update(mfile, bytes, mftime() - start);
+        
+        return MPI_SUCCESS;
+    }
+    
+    // The regions in memory are not mapped from the file, and thus they are
+    // written back first (i.e., the rest of the mapping is flushed afterwards)
+    if (mfile.tier != NULL)
+    {
+        CHK(mftier_flush(mfile, 0, mfile.length_s));
+    }
+    
+    if (mfile.flags & MFILE_FLUSH_FDATASYNC)
+    {
+        CHK(syncRange(mfile, 0, mfile.length, TRUE));
+        
+        bytes = mfile.length_s;
+    }
+    else
+    {
+        CHK(msync(mfile.addr, mfile.length, MS_SYNC));
+        
+        bytes = mfile.length_s;
+    }
+    
+    // The ranges were only started with MFILE_FLUSH_FDATASYNC, and thus all
+    // of them are waited at once (i.e., the write-back of the ranges overlaps)
+    if ((mfile.flags & MFILE_FLUSH_FDATASYNC) && mfsync_wait(mfile) != MPI_SUCCESS)
+    {
+        return ERROR;
+    }
+    
+    DBGPRINTF("Mapping flushed with bytes=%zu (length=%zu)", bytes, mfile.length_s);
+    
+    mfstats_update(mfile, bytes, mftime() - start);
+    
+    return MPI_SUCCESS;
+}
+
+int mfsync_wait(MFILE mfile)
+{
+    if (mfile.uffd != NULL || mfile.length_s == 0)
+    {
+        return MPI_SUCCESS;
+    }
+    
+    return (mfile.flags & MFILE_FLUSH_FDATASYNC) ? waitRange(mfile, 0, mfile.length) :
+                                                   msync(mfile.addr_s, mfile.length_s, MS_SYNC);
+}
+
+int mfsync_at(MFILE mfile, size_t offset, size_t length, int async)
+{
+    size_t start    = mftime();
+    off_t  offset_f = 0;
+    off_t  length_f = 0;
+    
+    // Translate the range to the storage part before the write-back (i.e., the
+    // statistics only consider the bytes of the file)
+    getFileRange(mfile, offset, length, &offset_f, &length_f);
+    
+    if (mfile.uffd != NULL)
+    {
+        size_t bytes = 0;
+        
+        if (length_f > 0)
+        {
+            CHK(mfuffd_flush(mfile, offset_f - mfile.offset, length_f, &bytes));
+        }
+        
+        mfstats_update(mfile, bytes, mftime() - start);
+        
+        return MPI_SUCCESS;
+    }
+    else if (mfile.tier != NULL && length_f > 0)
+    {
+        CHK(mftier_flush(mfile, offset_f - mfile.offset, length_f));
+    }
+    
+    CHK(syncRange(mfile, offset, length, async));
+    
+    if ((mfile.flags & MFILE_FLUSH_FDATASYNC) && !async)
+    {
+        CHK(waitRange(mfile, offset, length));
+    }
+    
+    mfstats_update(mfile, length_f, mftime() - start);
+    
+    return MPI_SUCCESS;
+}
+
+void mfstats_update(MFILE mfile, size_t bytes, size_t elapsed)
+{
+    // Note: A mapping might be flushed from several threads at the same time
+    __atomic_store_n(&mfile.stats->bytes_last, bytes, __ATOMIC_RELAXED);
+    __atomic_store_n(&mfile.stats->time_last, elapsed, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&mfile.stats->bytes_total, bytes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&mfile.stats->time_total, elapsed, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&mfile.stats->num_syncs, 1, __ATOMIC_RELAXED);
+    
+    mftrace(MFTRACE_FLUSH, mftime() - elapsed, bytes);
+    
+    __atomic_store_n(&g_stats.bytes_last, bytes, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_stats.time_last, elapsed, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&g_stats.bytes_total, bytes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&g_stats.time_total, elapsed, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&g_stats.num_syncs, 1, __ATOMIC_RELAXED);
+}
+
+void mfstats_alloc(MFILE mfile, size_t elapsed)
+{
+    __atomic_fetch_add(&mfile.stats->time_alloc, elapsed, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&g_stats.time_alloc, elapsed, __ATOMIC_RELAXED);
+}
+
+void mfstats_fault(MFILE_Stats *stats)
+{
+    __atomic_fetch_add(&stats->num_faults, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&g_stats.num_faults, 1, __ATOMIC_RELAXED);
+}
+
+void mfstats_direct(MFILE mfile, size_t bytes)
+{
+    __atomic_fetch_add(&mfile.stats->bytes_direct, bytes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&g_stats.bytes_direct, bytes, __ATOMIC_RELAXED);
+}
+
+void mfstats_process(MFILE_Stats *stats)
+{
+    size_t *src = (size_t *)&g_stats;
+    size_t *dst = (size_t *)stats;
+    
+    // Note: Each counter is read atomically, but not the structure as a whole
+    for (size_t i = 0; i < (sizeof(MFILE_Stats) / sizeof(size_t)); i++)
+    {
+        dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+    }
+}
+
+size_t mftime()
+{
+    struct timespec ts = { 0 };
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    
+    return (size_t)ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+/**
+ * Helper method that prefaults a range of the mapping. If the kernel does not
+ * support MADV_POPULATE_READ / MADV_POPULATE_WRITE (i.e., before Linux 5.14),
+ * each page is touched instead, without modifying its content.
+ */
+int populateRange(char *addr, size_t length, int write)
+{
+    if (length > 0 && madvise(addr, length, (write) ? MADV_POPULATE_WRITE :
+                                                      MADV_POPULATE_READ) != MPI_SUCCESS)
+    {
+        volatile char *addr_tmp = addr;
+        
+        CHKB(errno != EINVAL);
+        
+        for (size_t offset = 0; offset < length; offset += g_pagesize)
+        {
+            if (write)
+            {
+                __atomic_fetch_add(&addr_tmp[offset], 0, __ATOMIC_RELAXED);
+            }
+            else
+            {
+                (void)addr_tmp[offset];
+            }
+        }
+    }
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that prefaults the ranges assigned to a thread.
+ */
+void *populateMain(void *arg)
+{
+    MFILE_Populate *populate = (MFILE_Populate *)arg;
+    
+    for (int i = 0; i < 2 && populate->error == MPI_SUCCESS; i++)
+    {
+        populate->error = populateRange(populate->addr[i], populate->length[i], populate->write[i]);
+    }
+    
+    return NULL;
+}
+
+int mfpopulate(MFILE mfile, int mode, int num_threads)
+{
+    const size_t   length_m  = mfile.length - mfile.length_s;
+    const size_t   align     = (g_hugepagesize > g_pagesize) ? g_hugepagesize : g_pagesize;
+    int            hr        = MPI_SUCCESS;
+    pthread_t      *threads  = NULL;
+    MFILE_Populate *populate = NULL;
+    char           *addr[2]  = { NULL };
+    size_t         length[2] = { length_m, mfile.length_s };
+    size_t         chunk[2]  = { 0 };
+    
+    if (mode == 0 || mfile.length == 0)
+    {
+        return MPI_SUCCESS;
+    }
+    
+    // The memory part is located before or after the storage part
+    addr[0] = (mfile.addr_s == mfile.addr) ? (char *)mfile.addr_s + mfile.length_s :
+                                             (char *)mfile.addr;
+    addr[1] = (char *)mfile.addr_s;
+    
+    num_threads = (num_threads > 0) ? num_threads : 1;
+    threads     = (pthread_t *)malloc(sizeof(pthread_t) * num_threads);
+    populate    = (MFILE_Populate *)calloc(num_threads, sizeof(MFILE_Populate));
+    
+    // Each thread prefaults a consecutive chunk of each part, aligned to the
+    // huge page size to avoid sharing a huge page between threads
+    for (int j = 0; j < 2; j++)
+    {
+        chunk[j] = ALIGN_UP((length[j] + num_threads - 1) / num_threads, align);
+    }
+    
+    for (int i = 0; i < num_threads; i++)
+    {
+        for (int j = 0; j < 2; j++)
+        {
+            const size_t offset = chunk[j] * i;
+            const size_t remain = (offset < length[j]) ? (length[j] - offset) : 0;
+            
+            populate[i].addr[j]   = addr[j] + offset;
+            populate[i].length[j] = (remain < chunk[j]) ? remain : chunk[j];
+        }
+        
+        // Note: The memory part is always prefaulted for writing, as reading
+        //       anonymous memory would only map the zero page
+        populate[i].write[0] = TRUE;
+        populate[i].write[1] = (mode == MFILE_POPULATE_WRITE);
+    }
+    
+    // Launch the threads, but prefault the range in the calling thread if the
+    // creation fails for any reason (the first range is always local)
+    for (int i = 1; i < num_threads; i++)
+    {
+        if (pthread_create(&threads[i], NULL, populateMain, &populate[i]) != MPI_SUCCESS)
+        {
+            threads[i] = pthread_self();
+            
+            populateMain(&populate[i]);
+        }
+    }
+    
+    populateMain(&populate[0]);
+    
+    for (int i = 0; i < num_threads; i++)
+    {
+        if (i > 0 && !pthread_equal(threads[i], pthread_self()))
+        {
+            pthread_join(threads[i], NULL);
+        }
+        
+        hr = (populate[i].error != MPI_SUCCESS) ? populate[i].error : hr;
+    }
+    
+    DBGPRINTF("Mapping prefaulted with mode=%d (threads=%d hr=%d)", mode, num_threads, hr);
+    
+    free(threads);
+    free(populate);
+    
+    return hr;
+}
+
+/**
+ * Helper method that copies a range between two files, sharing the extents if
+ * the file system supports it (e.g., XFS or Btrfs). Otherwise, or for the
+ * unaligned tail of the range, the content is copied with copy_file_range.
+ */
+int cloneRange(int fd_in, off_t offset_in, int fd_out, off_t offset_out, size_t length)
+{
+    struct file_clone_range range = { fd_in, offset_in, ALIGN_DOWN(length, g_pagesize), offset_out };
+    
+    // Note: Cloning only requires to update the metadata of the destination,
+    //       but the offsets must be aligned to the block size
+    if (range.src_length > 0 && ioctl(fd_out, FICLONERANGE, &range) == MPI_SUCCESS)
+    {
+        offset_in  += range.src_length;
+        offset_out += range.src_length;
+        length     -= range.src_length;
+    }
+    
+    while (length > 0)
+    {
+        ssize_t bytes = copy_file_range(fd_in, &offset_in, fd_out, &offset_out, length, 0);
+        CHKB(bytes <= 0);
+        
+        length -= bytes;
+    }
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that transfers a range of the memory part to / from a file,
+ * retrying after partial transfers.
+ */
+int transferMemory(int fd, char *addr, off_t offset, size_t length, int write)
+{
+    while (length > 0)
+    {
+        ssize_t bytes = (write) ? pwrite(fd, addr, length, offset) :
+                                  pread(fd, addr, length, offset);
+        CHKB(bytes <= 0);
+        
+        addr   += bytes;
+        offset += bytes;
+        length -= bytes;
+    }
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that retrieves the range of a part of the mapping (i.e., memory
+ * or storage) within the snapshot, which starts at the address returned to the
+ * user. Returns FALSE if the part is empty or located before that address.
+ */
+int getSnapshotRange(MFILE mfile, size_t offset, size_t length, size_t *skip, size_t *offset_snap,
+                     size_t *length_snap)
+{
+    const size_t shift = (char *)mfile.addr_src - (char *)mfile.addr;
+    const size_t start = (offset > shift) ? offset : shift;
+    
+    *skip        = start - offset;
+    *offset_snap = start - shift;
+    *length_snap = ((offset + length) > start) ? ((offset + length) - start) : 0;
+    
+    return (*length_snap > 0);
+}
+
+int mfsnapshot(MFILE mfile, const char *path)
+{
+    const size_t offset_s = (char *)mfile.addr_s - (char *)mfile.addr;
+    const size_t offset_m = (offset_s == 0) ? mfile.length_s : 0;
+    const size_t length_m = mfile.length - mfile.length_s;
+    size_t       skip     = 0;
+    size_t       offset   = 0;
+    size_t       length   = 0;
+    int          error    = MPI_SUCCESS;
+    int          fd       = open(path, O_CREAT | O_WRONLY | O_TRUNC, S_IRUSR | S_IWUSR);
+    
+    CHKB(fd == ERROR);
+    
+    error = ftruncate(fd, mfile.length - ((char *)mfile.addr_src - (char *)mfile.addr));
+    
+    // The storage part is cloned from the file, which must have been flushed
+    // before, while the memory part is written from the mapping
+    if (error == MPI_SUCCESS && getSnapshotRange(mfile, offset_s, mfile.length_s, &skip, &offset, &length))
+    {
+        error = (mfile.stripes == NULL) ? cloneRange(mfile.fd, mfile.offset + skip, fd, offset, length) :
+                                          transferMemory(fd, (char *)mfile.addr_s + skip, offset, length, TRUE);
+    }
+    
+    if (error == MPI_SUCCESS && getSnapshotRange(mfile, offset_m, length_m, &skip, &offset, &length))
+    {
+        error = transferMemory(fd, (char *)mfile.addr + offset_m + skip, offset, length, TRUE);
+    }
+    
+    error = (error == MPI_SUCCESS) ? fdatasync(fd) : error;
+    
+    DBGPRINTF("Snapshot created with path=\"%s\" (hr=%d)", path, error);
+    
+    close(fd);
+    
+    return error;
+}
+
+int mfrestore(MFILE mfile, const char *path)
+{
+    const size_t offset_s = (char *)mfile.addr_s - (char *)mfile.addr;
+    const size_t offset_m = (offset_s == 0) ? mfile.length_s : 0;
+    const size_t length_m = mfile.length - mfile.length_s;
+    size_t       skip     = 0;
+    size_t       offset   = 0;
+    size_t       length   = 0;
+    int          error    = MPI_SUCCESS;
+    int          fd       = open(path, O_RDONLY);
+    struct stat  st;
+    
+    CHKB(fd == ERROR);
+    
+    error = fstat(fd, &st);
+    
+    // Note: The ranges are clipped to the size of the snapshot, and thus the
+    //       rest of the mapping keeps its content
+    if (error == MPI_SUCCESS && getSnapshotRange(mfile, offset_s, mfile.length_s, &skip, &offset, &length) &&
+        (off_t)offset < st.st_size)
+    {
+        length = ((off_t)(offset + length) < st.st_size) ? length : (st.st_size - offset);
+        error  = (mfile.stripes == NULL) ? cloneRange(fd, offset, mfile.fd, mfile.offset + skip, length) :
+                                           transferMemory(fd, (char *)mfile.addr_s + skip, offset, length, FALSE);
+    }
+    
+    if (error == MPI_SUCCESS && getSnapshotRange(mfile, offset_m, length_m, &skip, &offset, &length) &&
+        (off_t)offset < st.st_size)
+    {
+        length = ((off_t)(offset + length) < st.st_size) ? length : (st.st_size - offset);
+        error  = transferMemory(fd, (char *)mfile.addr + offset_m + skip, offset, length, FALSE);
+    }
+    
+    DBGPRINTF("Snapshot restored with path=\"%s\" (hr=%d)", path, error);
+    
+    close(fd);
+    
+    return error;
+}
+
+size_t mfheader_size()
+{
+    pthread_once(&g_pagesize_once, initPageSize);
+    
+    return g_pagesize;
+}
+
+int mfheader_read(const char *filename, size_t offset, MFILE_Header *header)
+{
+    int     fd    = ERROR;
+    ssize_t bytes = 0;
+    char    path[PATH_MAX];
+    
+    // Note: The header of a striped mapping is stored in the first file
+    snprintf(path, PATH_MAX, "%.*s", (int)strcspn(filename, STRIPE_SEPARATOR), filename);
+    
+    fd = open(path, O_RDONLY);
+    CHKB(fd == ERROR);
+    
+    bytes = pread(fd, header, sizeof(MFILE_Header), offset);
+    close(fd);
+    
+    // Note: The regions that were never written are read as zeros, or not
+    //       read at all if they are beyond the end of the file
+    CHKB(bytes != sizeof(MFILE_Header) || memcmp(header->magic, MFILE_HEADER_MAGIC,
+                                                 sizeof(MFILE_HEADER_MAGIC)));
+    
+    return MPI_SUCCESS;
+}
+
+int mfheader_write(MFILE *mfile, size_t offset, MFILE_Header *header)
+{
+    memcpy(header->magic, MFILE_HEADER_MAGIC, sizeof(MFILE_HEADER_MAGIC));
+    header->version = MFILE_HEADER_VERSION;
+    header->flags  &= ~MFILE_HEADER_CLEAN;
+    
+    CHKB(pwrite(mfile->fd, header, sizeof(MFILE_Header), offset) != sizeof(MFILE_Header));
+    CHK(fdatasync(mfile->fd));
+    
+    mfile->header = offset;
+    
+    return MPI_SUCCESS;
+}
+
+int mfheader_close(MFILE mfile)
+{
+    MFILE_Header header = { 0 };
+    
+    if (mfile.header == SIZE_MAX)
+    {
+        return MPI_SUCCESS;
+    }
+    
+    CHKB(pread(mfile.fd, &header, sizeof(MFILE_Header), mfile.header) != sizeof(MFILE_Header));
+    
+    header.flags |= MFILE_HEADER_CLEAN;
+    
+    CHKB(pwrite(mfile.fd, &header, sizeof(MFILE_Header), mfile.header) != sizeof(MFILE_Header));
+    
+    return fdatasync(mfile.fd);
+}
+
 int mffree(MFILE mfile)
 {
+    size_t start = mftime();
+    
+    if (mfile.uffd != NULL)
+    {
+        CHK(mfuffd_unregister(mfile));
+    }
+    
+    if (mfile.tier != NULL)
+    {
+        CHK(mftier_unregister(mfile));
+    }
+    
+    if (mfile.direct != NULL)
+    {
+        CHK(mfuring_unregister(mfile));
+    }
+    
     // Remove any given permissions to the mapped-memory and unmap the file
     CHK(mprotect(mfile.addr, mfile.length, PROT_NONE));
     CHK(munmap(mfile.addr, mfile.length));
     
     // Check if the file was created for the mapping and delete it
-    if (mfile.unlink)
+    if (mfile.unlink && mfile.stripes == NULL)
     {
         CHK(unlink(mfile.filename));
     }
+    else if (mfile.unlink)
+    {
+        char *saveptr = NULL;
+        
+        for (char *name = strtok_r(mfile.filename, STRIPE_SEPARATOR, &saveptr); name != NULL;
+             name = strtok_r(NULL, STRIPE_SEPARATOR, &saveptr))
+        {
+            CHK(unlink(name));
+        }
+    }
+    
+    // Note: The first file of a striped mapping is also the file of the mapping
+    for (int i = 1; mfile.stripes != NULL && i < mfile.stripes->count; i++)
+    {
+        CHK(close(mfile.stripes->fds[i]));
+    }
+    
+    CHK(close(mfile.fd));
+    
+    if (mfile.stripes != NULL)
+    {
+        free(mfile.stripes->fds);
+        free(mfile.stripes);
+    }
     
     free(mfile.filename);
+    free(mfile.stats);
+    
+    __atomic_fetch_add(&g_stats.num_frees, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&g_stats.time_free, mftime() - start, __ATOMIC_RELAXED);
     
     return MPI_SUCCESS;
 }
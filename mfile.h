@@ -5,38 +5,269 @@
 extern "C" {
 #endif
 
+#define MFILE_HUGEPAGES_EXPLICIT    0x2  // Backs the memory part with huge pages (i.e., hugetlbfs)
+#define MFILE_HUGEPAGES_TRANSPARENT 0x4  // Backs the memory part with transparent huge pages
+#define MFILE_PREALLOC_FALLOCATE    0x8  // Extends the file with preallocated extents (i.e., fallocate)
+#define MFILE_PREALLOC_KEEP_SIZE    0x10 // Preallocates the extents before extending the file size
+#define MFILE_PREALLOC_ZERO_RANGE   0x20 // Extends the file with zeroed extents (i.e., FALLOC_FL_ZERO_RANGE)
+#define MFILE_PREALLOC_AUTO         0x40 // Selects the preallocation based on the file system
+#define MFILE_FLUSH_FDATASYNC       0x80 // Flushes with sync_file_range and fdatasync instead of msync
+
+#define MFILE_POPULATE_READ         1    // Prefaults the storage part for reading (i.e., no dirty pages)
+#define MFILE_POPULATE_WRITE        2    // Prefaults the storage part for writing
+
+#define MFILE_HEADER_MAGIC          "MPISWIN"
+#define MFILE_HEADER_VERSION        1
+#define MFILE_HEADER_CLEAN          0x1  // The mapping was flushed and released (i.e., clean shutdown)
+
+typedef struct MFILE_Dirty  MFILE_Dirty;
+typedef struct MFILE_Uffd   MFILE_Uffd;
+typedef struct MFILE_Tier   MFILE_Tier;
+typedef struct MFILE_Direct MFILE_Direct;
+
+/**
+ * Structure that contains the counters of a memory-file object, useful to
+ * determine the amount of data that has been written back to storage. The
+ * same structure accumulates the counters of every mapping of the process.
+ */
+typedef struct
+{
+    size_t bytes_last;      // Bytes flushed during the last synchronization
+    size_t bytes_total;     // Bytes flushed since the mapping was created
+    size_t num_syncs;       // Number of synchronizations requested
+    size_t time_last;       // Elapsed time of the last synchronization (in nanoseconds)
+    size_t time_total;      // Elapsed time of every synchronization (in nanoseconds)
+    size_t num_faults;      // Page faults serviced by the library (i.e., userfaultfd engine)
+    size_t bytes_direct;    // Bytes transferred directly to the file (i.e., io_uring)
+    size_t num_allocs;      // Number of mappings created
+    size_t time_alloc;      // Elapsed time of the allocations (in nanoseconds)
+    size_t num_frees;       // Number of mappings released (only accumulated for the process)
+    size_t time_free;       // Elapsed time of the releases (only accumulated for the process)
+} MFILE_Stats;
+
+/**
+ * Structure that describes the layout of a mapping, which is stored in the
+ * file one page before the mapping begins (i.e., the header is page-aligned
+ * if the mapping is). The structure is stored as is, and thus the file can
+ * only be reattached on machines with the same architecture.
+ */
+typedef struct
+{
+    char     magic[8];      // Identifier of the header (i.e., MFILE_HEADER_MAGIC)
+    uint32_t version;       // Version of the layout (i.e., MFILE_HEADER_VERSION)
+    uint32_t flags;         // State of the mapping (e.g., MFILE_HEADER_CLEAN)
+    uint64_t offset;        // Offset of the mapping within the file
+    uint64_t length;        // Length of the mapping
+    double   factor;        // Allocation factor of the mapping
+    int32_t  order;         // Order of the allocation (e.g., memory first)
+    int32_t  disp_unit;     // Displacement unit of the window (zero if unknown)
+    int32_t  rank;          // Rank of the process that owns the mapping (ERROR if unknown)
+    int32_t  num_procs;     // Number of processes of the window (zero if unknown)
+} MFILE_Header;
+
+/**
+ * Structure that defines how the storage part of a mapping is striped across
+ * several files (e.g., on different devices). The stripes are assigned to the
+ * files in round-robin order, and the consecutive stripes of each file are
+ * separated by the stride starting at the offset of the mapping (i.e., they
+ * are contiguous if the stride matches the size of the stripes, or leave room
+ * for the stripes of other mappings of the same file otherwise).
+ */
+typedef struct
+{
+    int    count;   // Number of files
+    size_t size;    // Size of each stripe (aligned to the page size)
+    size_t stride;  // Distance between consecutive stripes within each file
+    int    *fds;    // File descriptors of the files (the first one is also the descriptor of the mapping)
+} MFILE_Stripes;
+
+/**
+ * Structure that defines the layout requested for a new file in a striped
+ * file system (i.e., zero keeps the default of the file system).
+ */
+typedef struct
+{
+    int    stripe_count;    // Number of devices (e.g., OSTs) where the file is striped (-1 uses every device)
+    size_t stripe_size;     // Size of each stripe
+} MFILE_Layout;
+
 /**
  * Structure that defines a memory-file object, which is used to map files
  * in storage to memory.
  */
 typedef struct
 {
-    char*  filename;    // Filename of the mapped-file (including path)
-    size_t offset;      // Offset within the file
-    size_t length;      // Length of the mapping
-    int    unlink;      // Flag that determines if the file has to be deleted
-    void*  addr;        // Address in memory of the mapping
-    void*  addr_src;    // Address in memory of the mapping (unaligned)
+    char*         filename;     // Filename of the mapped-file (including path)
+    int           fd;           // File descriptor of the mapped-file (kept open until released)
+    int           flags;        // Flags requested during the allocation (e.g., MFILE_FLUSH_FDATASYNC)
+    size_t        offset;       // Offset within the file
+    size_t        length;       // Length of the mapping
+    int           unlink;       // Flag that determines if the file has to be deleted
+    void*         addr;         // Address in memory of the mapping
+    void*         addr_src;     // Address in memory of the mapping (unaligned)
+    void*         addr_s;       // Address in memory of the storage part of the mapping
+    size_t        length_s;     // Length of the storage part of the mapping
+    MFILE_Stats   *stats;       // Counters of the mapping (shared between copies)
+    size_t        sync_chunk;   // Size of the chunks flushed concurrently (zero flushes each range at once)
+    int           sync_threads; // Number of threads per device that flush the chunks
+    MFILE_Uffd    *uffd;        // Paging engine of the storage part (NULL if mapped by the kernel)
+    size_t        io_threshold; // Minimum size of the local transfers issued directly to the file (zero if disabled)
+    MFILE_Direct  *direct;      // Transfers issued directly to the file that are pending (NULL if disabled)
+    MFILE_Tier    *tier;        // Migration of the storage part between memory and the file (NULL if disabled)
+    size_t        header;       // Offset of the header within the file (SIZE_MAX if disabled)
+    MFILE_Stripes *stripes;     // Striping of the storage part across several files (NULL if a single file)
 } MFILE;
 
 /**
- * Allocates a file in storage and creates a map in memory.
+ * Allocates a file in storage and creates a map in memory. If huge pages are
+ * requested for the memory part, the boundary between memory and storage is
+ * aligned to the huge page size, falling back to the default page size if
+ * huge pages are not available. If a list of files separated by commas is
+ * given, the storage part is striped across the files in round-robin order
+ * with stripes of the given size (e.g., to aggregate several devices). If a
+ * stride is given (i.e., a multiple of the stripe size), the stripes of each
+ * file are separated by the stride instead, so that several mappings can be
+ * interleaved in the same file (e.g., a block-cyclic layout).
  */
 int mfalloc(char const *filename, size_t offset, size_t length, double factor,
             int order, int unlink, int access_style, int file_flags,
-            int file_perm, MFILE *mfile);
+            int file_perm, int flags, size_t stripe_size, size_t stripe_stride,
+            MFILE *mfile);
 
 /**
- * Flushes to disk any change made to the mapped file in memory.
+ * Retrieves the size that the file requires to contain the storage part of a
+ * mapping with the given settings, assuming that the file already exists
+ * (i.e., the end of the storage part within the file).
+ */
+size_t mfextent(size_t offset, size_t length, double factor, int order, int flags);
+
+/**
+ * Creates the file with the given layout if it does not exist, using the
+ * handler of the file system of the parent directory. The layout is ignored
+ * if the file system does not support it (i.e., no handler is registered).
+ * Each file of a list separated by commas receives the same layout.
+ */
+int mflayout(char const *filename, int file_perm, MFILE_Layout layout);
+
+/**
+ * Checks if the file is placed on a file system that is shared between nodes
+ * (i.e., Lustre, GPFS or NFS), based on the parent directory if the file does
+ * not exist yet.
+ */
+int mfshared(char const *filename);
+
+/**
+ * Creates the file, if needed, and extends it up to the given size with the
+ * requested preallocation, without mapping it. Useful to create a file shared
+ * by several processes once, so that mfalloc only opens it afterwards.
+ */
+int mfcreate(char const *filename, size_t size, int file_flags, int file_perm, int flags);
+
+/**
+ * Flushes to disk any change made to the mapped file in memory. Note that the
+ * kernel only writes back the pages of the storage part that are dirty in the
+ * page cache, including those written by the NIC (e.g., RDMA) or by other
+ * processes. With MFILE_FLUSH_FDATASYNC, the write-back of every range is started first,
+ * and the method waits for all of them before calling fdatasync. If the
+ * storage part is serviced by the userfaultfd engine, the engine writes back
+ * the modified clusters instead. The regions migrated to memory by the tiering
+ * are written back before the rest of the mapping.
  */
 int mfsync(MFILE mfile);
 
+/**
+ * Waits until the whole storage part of the mapping is persisted, including
+ * the pages that were not tracked as modified. Useful to complete a flush that
+ * only started the write-back of the modified ranges.
+ */
+int mfsync_wait(MFILE mfile);
+
 /**
  * Flushes to disk any change made to the mapped file in memory within the
  * specified range.
  */
 int mfsync_at(MFILE mfile, size_t offset, size_t length, int async);
 
+/**
+ * Prefaults the pages of the mapping using several threads, so that the first
+ * accesses do not pay the page faults. The memory part is always prefaulted
+ * for writing, while the storage part follows the given mode. Note that
+ * prefaulting the storage part for writing marks all its pages as modified.
+ */
+int mfpopulate(MFILE mfile, int mode, int num_threads);
+
+/**
+ * Creates a snapshot of the mapping in a new file, which starts at the address
+ * returned to the user (i.e., the same layout as a window allocated from the
+ * snapshot). The storage part is cloned from the file (i.e., the extents are
+ * shared on XFS or Btrfs), falling back to copy_file_range, and thus it must
+ * be flushed before. The memory part is written from the mapping.
+ */
+int mfsnapshot(MFILE mfile, const char *path);
+
+/**
+ * Restores the content of a snapshot into the mapping, cloning the storage
+ * part into the file and reading the memory part. The snapshot is not
+ * modified afterwards, as the extents are copied on write.
+ */
+int mfrestore(MFILE mfile, const char *path);
+
+/**
+ * Updates the counters of the mapping after a flush of the given number of
+ * bytes, which took the elapsed time (in nanoseconds).
+ */
+void mfstats_update(MFILE mfile, size_t bytes, size_t elapsed);
+
+/**
+ * Adds the elapsed time (in nanoseconds) to the allocation of the mapping,
+ * useful to include the setup done after mfalloc (e.g., prefaulting).
+ */
+void mfstats_alloc(MFILE mfile, size_t elapsed);
+
+/**
+ * Updates the counters after a page fault of the mapping is serviced, or
+ * after the given number of bytes is transferred directly to the file.
+ */
+void mfstats_fault(MFILE_Stats *stats);
+void mfstats_direct(MFILE mfile, size_t bytes);
+
+/**
+ * Retrieves the counters accumulated for every mapping of the process,
+ * including the ones that were already released.
+ */
+void mfstats_process(MFILE_Stats *stats);
+
+/**
+ * Retrieves the current time of a monotonic clock (in nanoseconds).
+ */
+size_t mftime();
+
+/**
+ * Retrieves the size reserved for the header in front of the mapping (i.e.,
+ * the page size), so that the mapping remains page-aligned.
+ */
+size_t mfheader_size();
+
+/**
+ * Reads the header located at the given offset of the file. An error is
+ * returned if the file does not exist or the header is not valid (e.g., the
+ * region was never written or belongs to another kind of file).
+ */
+int mfheader_read(const char *filename, size_t offset, MFILE_Header *header);
+
+/**
+ * Writes the header of the mapping at the given offset of the file, and
+ * persists it with fdatasync. The clean flag is removed, so that an abnormal
+ * termination is detected when the file is reattached.
+ */
+int mfheader_write(MFILE *mfile, size_t offset, MFILE_Header *header);
+
+/**
+ * Marks the header of the mapping as clean (i.e., the mapping must have been
+ * flushed before). Does nothing if the mapping does not have a header.
+ */
+int mfheader_close(MFILE mfile);
+
 /**
  * Releases the mapped allocation and removes the associated file.
  */
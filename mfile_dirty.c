@@ -0,0 +1,228 @@
+
+#include "common.h"
+#include <pthread.h>
+#include "mfile.h"
+#include "mfile_dirty.h"
+
+#define PAGEMAP_PATH        "/proc/self/pagemap"
+#define CLEAR_REFS_PATH     "/proc/self/clear_refs"
+#define CLEAR_REFS_SDIRTY   "4"                 // Clears the soft-dirty bits of the process
+#define PM_SOFT_DIRTY       (1ULL << 55)        // Page modified since the last clear
+#define PM_PRESENT          (1ULL << 63)        // Page present in memory
+#define PM_ENTRIES          4096                // Number of pagemap entries read at once
+#define DIRTY_NUM_INIT      16
+#define BITS_PER_WORD       64
+
+#define BITMAP_WORDS(num_pages) (((num_pages) + BITS_PER_WORD - 1) / BITS_PER_WORD)
+#define BITMAP_TEST(b, i)       ((b)[(i) / BITS_PER_WORD] &  (1ULL << ((i) % BITS_PER_WORD)))
+#define BITMAP_SET(b, i)        ((b)[(i) / BITS_PER_WORD] |= (1ULL << ((i) % BITS_PER_WORD)))
+#define BITMAP_CLEAR(b, i)      ((b)[(i) / BITS_PER_WORD] &= ~(1ULL << ((i) % BITS_PER_WORD)))
+
+int             g_dirty_supported  = FALSE;
+int             g_dirty_pagemap_fd = ERROR;
+int             g_dirty_clear_fd   = ERROR;
+size_t          g_dirty_pagesize   = 0;
+MFILE_Dirty     **g_dirty_regs     = NULL;
+int             g_dirty_count      = 0;
+int             g_dirty_size       = 0;
+pthread_mutex_t g_dirty_mutex      = PTHREAD_MUTEX_INITIALIZER; // Note: Flushes can be concurrent (e.g., MPIX_Win_isync)
+pthread_once_t  g_dirty_once       = PTHREAD_ONCE_INIT;
+
+/**
+ * Helper method that reads the pagemap entries of a given range of pages and
+ * marks the modified pages inside the bitmap.
+ */
+int collectRange(MFILE_Dirty *dirty)
+{
+    uint64_t entries[PM_ENTRIES];
+    size_t   page_first = (uintptr_t)dirty->addr / g_dirty_pagesize;
+    
+    for (size_t page = 0; page < dirty->num_pages; page += PM_ENTRIES)
+    {
+        size_t  count = ((dirty->num_pages - page) < PM_ENTRIES) ? (dirty->num_pages - page) : PM_ENTRIES;
+        ssize_t bytes = pread(g_dirty_pagemap_fd, entries, count * sizeof(uint64_t),
+                              (page_first + page) * sizeof(uint64_t));
+        CHKB(bytes != (ssize_t)(count * sizeof(uint64_t)));
+        
+        for (size_t i = 0; i < count; i++)
+        {
+            // Note: Pages that are not present could not have been modified through
+            // the mapping, even if the soft-dirty flag is inherited from the VMA
+            if ((entries[i] & PM_PRESENT) && (entries[i] & PM_SOFT_DIRTY))
+            {
+                BITMAP_SET(dirty->bitmap, page + i);
+            }
+        }
+    }
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that checks if the kernel supports the soft-dirty bits.
+ */
+void probeSupport()
+{
+    uint64_t entry = 0;
+    char     *addr = NULL;
+    
+    g_dirty_supported  = FALSE;
+    g_dirty_pagesize   = sysconf(_SC_PAGESIZE);
+    g_dirty_pagemap_fd = open(PAGEMAP_PATH, O_RDONLY);
+    g_dirty_clear_fd   = open(CLEAR_REFS_PATH, O_WRONLY);
+    
+    if (g_dirty_pagemap_fd == ERROR || g_dirty_clear_fd == ERROR)
+    {
+        return;
+    }
+    
+    // A new mapping is always flagged as soft-dirty if the kernel supports the
+    // feature, and thus we can probe the support by touching a single page
+    addr = (char *)mmap(NULL, g_dirty_pagesize, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    
+    if (addr != MAP_FAILED)
+    {
+        addr[0] = 1;
+        
+        if (pread(g_dirty_pagemap_fd, &entry, sizeof(uint64_t),
+                  ((uintptr_t)addr / g_dirty_pagesize) * sizeof(uint64_t)) == sizeof(uint64_t))
+        {
+            g_dirty_supported = ((entry & PM_SOFT_DIRTY) != 0);
+        }
+        
+        munmap(addr, g_dirty_pagesize);
+    }
+    
+    DBGPRINTF("Soft-dirty bits support checked (supported=%d)", g_dirty_supported);
+}
+
+int mfdirty_supported()
+{
+    pthread_once(&g_dirty_once, probeSupport);
+    
+    return g_dirty_supported;
+}
+
+int mfdirty_register(void *addr, size_t length, MFILE_Dirty **dirty)
+{
+    MFILE_Dirty *dirty_tmp = NULL;
+    
+    *dirty = NULL;
+    
+    // Fallback to the default behaviour if the kernel does not support it
+    if (!mfdirty_supported() || length == 0)
+    {
+        return MPI_SUCCESS;
+    }
+    
+    pthread_mutex_lock(&g_dirty_mutex);
+    
+    if (g_dirty_regs == NULL)
+    {
+        g_dirty_regs = (MFILE_Dirty **)malloc(sizeof(MFILE_Dirty *) * DIRTY_NUM_INIT);
+        g_dirty_size = DIRTY_NUM_INIT;
+    }
+    else if (g_dirty_count == g_dirty_size)
+    {
+        g_dirty_size <<= 1;
+        g_dirty_regs   = (MFILE_Dirty **)realloc(g_dirty_regs, sizeof(MFILE_Dirty *) * g_dirty_size);
+    }
+    
+    dirty_tmp            = (MFILE_Dirty *)malloc(sizeof(MFILE_Dirty));
+    dirty_tmp->addr      = (char *)addr;
+    dirty_tmp->num_pages = (length + g_dirty_pagesize - 1) / g_dirty_pagesize;
+    dirty_tmp->bitmap    = (uint64_t *)calloc(BITMAP_WORDS(dirty_tmp->num_pages), sizeof(uint64_t));
+    
+    g_dirty_regs[g_dirty_count++] = dirty_tmp;
+    *dirty                        = dirty_tmp;
+    
+    pthread_mutex_unlock(&g_dirty_mutex);
+    
+    return MPI_SUCCESS;
+}
+
+int mfdirty_unregister(MFILE_Dirty *dirty)
+{
+    int hr = MPI_ERR_OTHER;
+    
+    pthread_mutex_lock(&g_dirty_mutex);
+    
+    for (int i = 0; i < g_dirty_count; i++)
+    {
+        if (g_dirty_regs[i] == dirty)
+        {
+            g_dirty_regs[i] = g_dirty_regs[--g_dirty_count];
+            
+            free(dirty->bitmap);
+            free(dirty);
+            
+            hr = MPI_SUCCESS;
+            break;
+        }
+    }
+    
+    pthread_mutex_unlock(&g_dirty_mutex);
+    
+    return hr;
+}
+
+int mfdirty_collect()
+{
+    int hr = MPI_SUCCESS;
+    
+    pthread_mutex_lock(&g_dirty_mutex);
+    
+    // Every tracked range is collected before clearing the bits, as otherwise the
+    // modifications on the rest of the ranges would be lost
+    for (int i = 0; hr == MPI_SUCCESS && i < g_dirty_count; i++)
+    {
+        hr = collectRange(g_dirty_regs[i]);
+    }
+    
+    if (hr == MPI_SUCCESS && pwrite(g_dirty_clear_fd, CLEAR_REFS_SDIRTY, 1, 0) != 1)
+    {
+        hr = ERROR;
+    }
+    
+    pthread_mutex_unlock(&g_dirty_mutex);
+    
+    return hr;
+}
+
+int mfdirty_take(MFILE_Dirty *dirty, size_t offset, size_t length)
+{
+    const size_t page_end = (offset + length + g_dirty_pagesize - 1) / g_dirty_pagesize;
+    int          found    = FALSE;
+    
+    pthread_mutex_lock(&g_dirty_mutex);
+    
+    for (size_t page = offset / g_dirty_pagesize; page < page_end && page < dirty->num_pages; page++)
+    {
+        if (BITMAP_TEST(dirty->bitmap, page))
+        {
+            BITMAP_CLEAR(dirty->bitmap, page);
+            
+            found = TRUE;
+        }
+    }
+    
+    pthread_mutex_unlock(&g_dirty_mutex);
+    
+    return found;
+}
+
+void mfdirty_mark(MFILE_Dirty *dirty, size_t offset, size_t length)
+{
+    const size_t page_end = (offset + length + g_dirty_pagesize - 1) / g_dirty_pagesize;
+    
+    pthread_mutex_lock(&g_dirty_mutex);
+    
+    for (size_t page = offset / g_dirty_pagesize; page < page_end && page < dirty->num_pages; page++)
+    {
+        BITMAP_SET(dirty->bitmap, page);
+    }
+    
+    pthread_mutex_unlock(&g_dirty_mutex);
+}
+
@@ -0,0 +1,66 @@
+#ifndef _MFILE_DIRTY_H
+#define _MFILE_DIRTY_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Structure that keeps track of the pages of a mapping that have been
+ * modified since they were last flushed to storage. The information is
+ * retrieved from the soft-dirty bits exposed in /proc/self/pagemap, and it is
+ * only a hint (i.e., the writes of the NIC, of other processes, or those that
+ * race with the clear of the bits are missed). It is only used by the tiering,
+ * which writes back the regions kept in memory on its own.
+ */
+struct MFILE_Dirty
+{
+    char      *addr;        // Start of the tracked range (aligned to the page size)
+    size_t    num_pages;    // Number of pages inside the tracked range
+    uint64_t  *bitmap;      // Pages modified, but not flushed yet (one bit per page)
+};
+
+/**
+ * Checks if the soft-dirty bits are supported by the kernel (i.e., requires
+ * CONFIG_MEM_SOFT_DIRTY). The result is cached after the first call.
+ */
+int mfdirty_supported();
+
+/**
+ * Starts tracking the modified pages of the given range. If the kernel does
+ * not support the soft-dirty bits, the output is set to NULL.
+ */
+int mfdirty_register(void *addr, size_t length, MFILE_Dirty **dirty);
+
+/**
+ * Stops tracking the modified pages of the given range.
+ */
+int mfdirty_unregister(MFILE_Dirty *dirty);
+
+/**
+ * Collects the soft-dirty bits of every tracked range and clears them
+ * afterwards. Note that the bits are process-wide, and thus all the tracked
+ * ranges must be collected at once to avoid losing any modification.
+ */
+int mfdirty_collect();
+
+/**
+ * Checks if any page of the given range (relative to the beginning of the
+ * tracked range) was modified, and marks the range as clean afterwards.
+ */
+int mfdirty_take(MFILE_Dirty *dirty, size_t offset, size_t length);
+
+/**
+ * Marks the given range (relative to the beginning of the tracked range) as
+ * modified again (e.g., if the flush of the range failed).
+ */
+void mfdirty_mark(MFILE_Dirty *dirty, size_t offset, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
@@ -0,0 +1,442 @@
+
+#include "common.h"
+#include <pthread.h>
+#include "mfile.h"
+#include "mfile_flush.h"
+#include "mfile_uffd.h"
+#include "mfile_tier.h"
+
+#define FLUSH_NUM_INIT    4
+#define FLUSH_MAX_THREADS 64
+
+/**
+ * Structure that represents a call to mfflush or mfflush_async, which is
+ * completed once every chunk of the given mappings has been flushed.
+ */
+typedef struct
+{
+    pthread_mutex_t  mutex;         // Mutex that protects the fields below
+    pthread_cond_t   cond;          // Condition signaled after the last chunk
+    int              pending;       // Number of chunks that are still being flushed
+    int              error;         // First error found while flushing the chunks
+    MFILE            **mfiles;      // Mappings of the call
+    int              count;         // Number of mappings of the call
+    size_t           *bytes;        // Bytes flushed for each mapping
+    size_t           start;         // Time when the call started
+    MFILE_Flush_Done callback;      // Callback invoked after the last chunk (NULL if the caller waits)
+    void             *arg;          // Argument of the callback
+} MFILE_Flush_Batch;
+
+/**
+ * Structure that defines a chunk of a mapping to be flushed (relative to the
+ * beginning of the storage part).
+ */
+typedef struct MFILE_Flush_Task
+{
+    MFILE_Flush_Batch       *batch;     // Call that the chunk belongs to
+    MFILE                   *mfile;     // Mapping that contains the chunk
+    size_t                  offset;     // Offset of the chunk
+    size_t                  length;     // Length of the chunk
+    size_t                  *bytes;     // Bytes written back from memory (NULL if the chunk is in the file mapping)
+    struct MFILE_Flush_Task *next;      // Next chunk inside the queue
+} MFILE_Flush_Task;
+
+/**
+ * Structure that represents the queue of chunks of a certain device, which is
+ * processed by its own set of threads.
+ */
+typedef struct
+{
+    dev_t            device;        // Device of the mapped files
+    pthread_mutex_t  mutex;         // Mutex that protects the fields below
+    pthread_cond_t   cond;          // Condition signaled after adding chunks
+    MFILE_Flush_Task *head;         // First chunk to be flushed
+    MFILE_Flush_Task *tail;         // Last chunk to be flushed
+    int              num_threads;   // Number of threads launched for the queue
+} MFILE_Flush_Queue;
+
+pthread_mutex_t   g_flush_mutex  = PTHREAD_MUTEX_INITIALIZER;
+MFILE_Flush_Queue **g_flush_regs = NULL;
+int               g_flush_count  = 0;
+int               g_flush_size   = 0;
+
+/**
+ * Helper method that flushes a chunk of a mapping and waits for completion.
+ * With MFILE_FLUSH_FDATASYNC, the metadata is persisted later on (i.e., once
+ * per mapping).
+ */
+int flushChunk(MFILE_Flush_Task *task)
+{
+    const int flags = SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER;
+    int       hr    = MPI_SUCCESS;
+    
+    // Note: The userfaultfd engine and the tiering write back the ranges kept
+    //       in memory on their own
+    if (task->bytes != NULL)
+    {
+        return (task->mfile->uffd != NULL) ? mfuffd_flush(*task->mfile, task->offset, task->length, task->bytes) :
+                                              mftier_flush(*task->mfile, task->offset, task->length);
+    }
+    else if (task->mfile->flags & MFILE_FLUSH_FDATASYNC)
+    {
+        hr = sync_file_range(task->mfile->fd, task->mfile->offset + task->offset, task->length, flags);
+    }
+    else
+    {
+        hr = msync((char *)task->mfile->addr_s + task->offset, task->length, MS_SYNC);
+    }
+    
+    return hr;
+}
+
+/**
+ * Helper method that completes a call after the last chunk, waiting for the
+ * whole storage part of the mappings that require it and updating their
+ * counters. The state of the call is released afterwards.
+ */
+int finishBatch(MFILE_Flush_Batch *batch)
+{
+    int    error   = batch->error;
+    size_t elapsed = 0;
+    
+    // Persist the metadata of the mappings that were flushed with the file
+    // descriptor (i.e., only once per mapping, after every chunk)
+    for (int i = 0; error == MPI_SUCCESS && i < batch->count; i++)
+    {
+        if ((batch->mfiles[i]->flags & MFILE_FLUSH_FDATASYNC) && mfsync_wait(*batch->mfiles[i]) != MPI_SUCCESS)
+        {
+            error = ERROR;
+        }
+    }
+    
+    // Note: Every mapping reports the elapsed time of the whole call, as the
+    //       chunks of the mappings were flushed concurrently
+    elapsed = mftime() - batch->start;
+    
+    for (int i = 0; error == MPI_SUCCESS && i < batch->count; i++)
+    {
+        mfstats_update(*batch->mfiles[i], batch->bytes[i], elapsed);
+    }
+    
+    DBGPRINTF("Mappings flushed in parallel (count=%d hr=%d elapsed=%zuns)", batch->count, error, elapsed);
+    
+    pthread_mutex_destroy(&batch->mutex);
+    pthread_cond_destroy(&batch->cond);
+    free(batch->mfiles);
+    free(batch->bytes);
+    free(batch);
+    
+    return error;
+}
+
+/**
+ * Helper method that marks a chunk as flushed. After the last chunk, the
+ * caller of mfflush is woken up, or the call is completed in the current
+ * thread if it was started with mfflush_async.
+ */
+void batchDone(MFILE_Flush_Batch *batch, int hr)
+{
+    MFILE_Flush_Done callback = batch->callback;
+    void             *arg     = batch->arg;
+    int              pending  = 0;
+    
+    pthread_mutex_lock(&batch->mutex);
+    
+    batch->error = (batch->error == MPI_SUCCESS) ? hr : batch->error;
+    pending      = --batch->pending;
+    
+    if (pending == 0 && callback == NULL)
+    {
+        pthread_cond_signal(&batch->cond);
+    }
+    
+    pthread_mutex_unlock(&batch->mutex);
+    
+    if (pending == 0 && callback != NULL)
+    {
+        callback(arg, finishBatch(batch));
+    }
+}
+
+/**
+ * Main method of the threads of a device, which flush the chunks of the queue
+ * as soon as they are available.
+ */
+void *flushMain(void *arg)
+{
+    MFILE_Flush_Queue *queue = (MFILE_Flush_Queue *)arg;
+    
+    while (TRUE)
+    {
+        MFILE_Flush_Task *task = NULL;
+        
+        pthread_mutex_lock(&queue->mutex);
+        
+        while (queue->head == NULL)
+        {
+            pthread_cond_wait(&queue->cond, &queue->mutex);
+        }
+        
+        task        = queue->head;
+        queue->head = task->next;
+        queue->tail = (queue->head != NULL) ? queue->tail : NULL;
+        
+        pthread_mutex_unlock(&queue->mutex);
+        
+        batchDone(task->batch, flushChunk(task));
+        
+        free(task);
+    }
+    
+    return NULL;
+}
+
+/**
+ * Helper method that retrieves the queue of the device of a file of a mapping,
+ * creating the queue if needed. The number of threads of the queue is
+ * increased if the mapping requests more threads than those available.
+ */
+MFILE_Flush_Queue *getQueue(MFILE *mfile, int fd)
+{
+    MFILE_Flush_Queue *queue      = NULL;
+    struct stat       st          = { 0 };
+    int               num_threads = (mfile->sync_threads < FLUSH_MAX_THREADS) ? mfile->sync_threads :
+                                                                                 FLUSH_MAX_THREADS;
+    
+    if (fstat(fd, &st) == ERROR)
+    {
+        return NULL;
+    }
+    
+    pthread_mutex_lock(&g_flush_mutex);
+    
+    for (int i = 0; queue == NULL && i < g_flush_count; i++)
+    {
+        queue = (g_flush_regs[i]->device == st.st_dev) ? g_flush_regs[i] : NULL;
+    }
+    
+    if (queue == NULL)
+    {
+        if (g_flush_count == g_flush_size)
+        {
+            g_flush_size = (g_flush_size == 0) ? FLUSH_NUM_INIT : (g_flush_size << 1);
+            g_flush_regs = (MFILE_Flush_Queue **)realloc(g_flush_regs, sizeof(MFILE_Flush_Queue *) * g_flush_size);
+        }
+        
+        queue         = (MFILE_Flush_Queue *)calloc(1, sizeof(MFILE_Flush_Queue));
+        queue->device = st.st_dev;
+        pthread_mutex_init(&queue->mutex, NULL);
+        pthread_cond_init(&queue->cond, NULL);
+        
+        g_flush_regs[g_flush_count++] = queue;
+    }
+    
+    // Note: The threads remain active until the process finishes
+    while (queue->num_threads < num_threads)
+    {
+        pthread_t thread;
+        
+        if (pthread_create(&thread, NULL, flushMain, queue) != MPI_SUCCESS)
+        {
+            break;
+        }
+        
+        pthread_detach(thread);
+        queue->num_threads++;
+        
+        DBGPRINTF("Flushing thread launched for device=%lu (count=%d)", (unsigned long)queue->device, queue->num_threads);
+    }
+    
+    pthread_mutex_unlock(&g_flush_mutex);
+    
+    return queue;
+}
+
+/**
+ * Helper method that adds a chunk to the given queue. If the queue has no
+ * threads, the chunk is flushed in the calling thread instead.
+ */
+void addTask(MFILE_Flush_Queue *queue, MFILE_Flush_Task *task)
+{
+    pthread_mutex_lock(&task->batch->mutex);
+    task->batch->pending++;
+    pthread_mutex_unlock(&task->batch->mutex);
+    
+    if (queue == NULL || queue->num_threads == 0)
+    {
+        batchDone(task->batch, flushChunk(task));
+        free(task);
+        return;
+    }
+    
+    pthread_mutex_lock(&queue->mutex);
+    
+    if (queue->tail != NULL)
+    {
+        queue->tail->next = task;
+    }
+    else
+    {
+        queue->head = task;
+    }
+    
+    queue->tail = task;
+    
+    pthread_cond_signal(&queue->cond);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+/**
+ * Helper method that adds the range of a mapping that is written back from
+ * memory (i.e., by the userfaultfd engine or the tiering) to the given queue,
+ * as a single chunk.
+ */
+void addMemory(MFILE_Flush_Queue *queue, MFILE_Flush_Batch *batch, MFILE *mfile, size_t *bytes)
+{
+    MFILE_Flush_Task *task = (MFILE_Flush_Task *)malloc(sizeof(MFILE_Flush_Task));
+    
+    task->batch  = batch;
+    task->mfile  = mfile;
+    task->offset = 0;
+    task->length = mfile->length_s;
+    task->bytes  = bytes;
+    task->next   = NULL;
+    
+    addTask(queue, task);
+}
+
+/**
+ * Helper method that divides a range of a mapping in chunks and adds them to
+ * the given queue.
+ */
+void addChunks(MFILE_Flush_Queue *queue, MFILE_Flush_Batch *batch, MFILE *mfile, size_t offset, size_t length)
+{
+    const size_t chunk_size = (mfile->sync_chunk > 0) ? mfile->sync_chunk : length;
+    
+    for (size_t chunk = 0; chunk < length; chunk += chunk_size)
+    {
+        MFILE_Flush_Task *task = (MFILE_Flush_Task *)malloc(sizeof(MFILE_Flush_Task));
+        
+        task->batch  = batch;
+        task->mfile  = mfile;
+        task->offset = offset + chunk;
+        task->length = ((length - chunk) < chunk_size) ? (length - chunk) : chunk_size;
+        task->bytes  = NULL;
+        task->next   = NULL;
+        
+        addTask(queue, task);
+    }
+}
+
+/**
+ * Helper method that adds a range of a mapping to the given queue. If the
+ * mapping is striped across several files, the range is divided at the
+ * boundaries of the stripes instead, so that each file is flushed by the
+ * threads of its own device.
+ */
+void addRange(MFILE_Flush_Queue *queue, MFILE_Flush_Batch *batch, MFILE *mfile, size_t offset, size_t length)
+{
+    const MFILE_Stripes *stripes = mfile->stripes;
+    const size_t        end      = offset + length;
+    
+    if (stripes == NULL || stripes->count == 1)
+    {
+        addChunks(queue, batch, mfile, offset, length);
+        return;
+    }
+    
+    while (offset < end)
+    {
+        const size_t stripe = offset / stripes->size;
+        const size_t next   = ((stripe + 1) * stripes->size < end) ? (stripe + 1) * stripes->size : end;
+        
+        addChunks(getQueue(mfile, stripes->fds[stripe % stripes->count]), batch, mfile, offset, next - offset);
+        
+        offset = next;
+    }
+}
+
+/**
+ * Helper method that starts a call, adding the chunks of every mapping to the
+ * queues of their devices. The caller keeps a reference to the call, so that
+ * it is not completed while the chunks are still being added.
+ */
+MFILE_Flush_Batch *startBatch(MFILE *mfiles[], int count, MFILE_Flush_Done callback, void *arg)
+{
+    MFILE_Flush_Batch *batch = (MFILE_Flush_Batch *)calloc(1, sizeof(MFILE_Flush_Batch));
+    
+    pthread_mutex_init(&batch->mutex, NULL);
+    pthread_cond_init(&batch->cond, NULL);
+    batch->pending  = 1;
+    batch->error    = MPI_SUCCESS;
+    batch->mfiles   = (MFILE **)malloc(sizeof(MFILE *) * count);
+    batch->count    = count;
+    batch->bytes    = (size_t *)calloc(count, sizeof(size_t));
+    batch->start    = mftime();
+    batch->callback = callback;
+    batch->arg      = arg;
+    
+    memcpy(batch->mfiles, mfiles, sizeof(MFILE *) * count);
+    
+    for (int i = 0; i < count; i++)
+    {
+        MFILE_Flush_Queue *queue = NULL;
+        
+        // Note: The queues of a mapping striped across several files are
+        //       retrieved for each stripe instead
+        queue = (mfiles[i]->length_s > 0 && (mfiles[i]->stripes == NULL || mfiles[i]->stripes->count == 1)) ?
+                    getQueue(mfiles[i], mfiles[i]->fd) : NULL;
+        
+        // Note: The userfaultfd engine writes back its own clusters, and thus
+        //       these mappings are flushed as a single chunk
+        if (mfiles[i]->uffd != NULL)
+        {
+            addMemory(queue, batch, mfiles[i], &batch->bytes[i]);
+            continue;
+        }
+        
+        // The regions migrated to memory are also written back as a single
+        // chunk, concurrently with the chunks of the file mapping
+        if (mfiles[i]->tier != NULL)
+        {
+            addMemory(queue, batch, mfiles[i], &batch->bytes[i]);
+        }
+        
+        if (mfiles[i]->length_s > 0)
+        {
+            addRange(queue, batch, mfiles[i], 0, mfiles[i]->length_s);
+            
+            batch->bytes[i] = mfiles[i]->length_s;
+        }
+    }
+    
+    return batch;
+}
+
+int mfflush(MFILE *mfiles[], int count)
+{
+    MFILE_Flush_Batch *batch = startBatch(mfiles, count, NULL, NULL);
+    
+    // Release the reference of the caller and wait for the rest of chunks
+    pthread_mutex_lock(&batch->mutex);
+    
+    batch->pending--;
+    
+    while (batch->pending > 0)
+    {
+        pthread_cond_wait(&batch->cond, &batch->mutex);
+    }
+    
+    pthread_mutex_unlock(&batch->mutex);
+    
+    return finishBatch(batch);
+}
+
+void mfflush_async(MFILE *mfiles[], int count, MFILE_Flush_Done callback, void *arg)
+{
+    MFILE_Flush_Batch *batch = startBatch(mfiles, count, callback, arg);
+    
+    // Release the reference of the caller, which completes the call in the
+    // current thread if every chunk was already flushed
+    batchDone(batch, MPI_SUCCESS);
+}
@@ -0,0 +1,37 @@
+#ifndef _MFILE_FLUSH_H
+#define _MFILE_FLUSH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Callback invoked once an asynchronous flush is completed, with the result
+ * of the flush.
+ */
+typedef void (*MFILE_Flush_Done)(void *arg, int hr);
+
+/**
+ * Flushes to disk the given mappings at once, dividing the modified ranges of
+ * each mapping in chunks of sync_chunk bytes that are flushed concurrently.
+ * The chunks are processed by a pool of threads with one queue per device,
+ * which is launched on first use with up to sync_threads threads per device.
+ * The counters of each mapping are updated with the elapsed time of the call.
+ */
+int mfflush(MFILE *mfiles[], int count);
+
+/**
+ * Starts the flush of the given mappings as in mfflush, but without waiting
+ * for the chunks. The callback is invoked by the thread that flushes the last
+ * chunk (or by the calling thread if the chunks were flushed before returning,
+ * e.g., because the pool has no threads). The mappings must not be released
+ * until then.
+ */
+void mfflush_async(MFILE *mfiles[], int count, MFILE_Flush_Done callback, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
@@ -0,0 +1,424 @@
+
+#include "common.h"
+#include <stdint.h>
+#include <pthread.h>
+#include <linux/falloc.h>
+#include "mfile.h"
+#include "mfile_dirty.h"
+#include "mfile_tier.h"
+#include "mfile_trace.h"
+
+#define PAGEMAP_PATH    "/proc/self/pagemap"
+#define PAGEMAP_PRESENT (1ULL << 63)            // Page mapped in the page table
+#define TIER_SAMPLES    16                      // Number of pages sampled per region
+#define TIER_NONE       UINT32_MAX              // Region kept in the file (i.e., no slot)
+
+/**
+ * Structure that represents the storage part of a mapping divided in regions,
+ * which keeps the slot of the memory pool and the access score of each region.
+ */
+typedef struct MFILE_Tier
+{
+    char            *addr;          // Start of the storage part (aligned to the page size)
+    size_t          length;         // Length of the storage part (aligned to the page size)
+    size_t          length_f;       // Length of the storage part that is backed by the file
+    int             fd;             // File descriptor of the mapped file
+    size_t          offset;         // Offset of the storage part within the file
+    int             prot;           // Protection of the mapping (based on the access mode of the file)
+    size_t          pagesize;       // Size of the pages of the mapping
+    size_t          region;         // Size of the regions (multiple of the page size)
+    size_t          num_regions;    // Number of regions of the storage part
+    size_t          num_slots;      // Number of regions that fit in the memory pool
+    size_t          num_used;       // Number of slots in use
+    int             pool_fd;        // File descriptor of the memory pool (i.e., memfd)
+    char            *pool;          // Mapping of the whole memory pool, used to copy the regions
+    int             pagemap;        // File descriptor of the page table entries of the process
+    uint64_t        *entries;       // Buffer used to read the page table entries of a region
+    uint32_t        *slot;          // Slot of each region in the memory pool (TIER_NONE if in the file)
+    uint32_t        *owner;         // Region that occupies each slot (TIER_NONE if free)
+    uint32_t        *score;         // Access score of each region (i.e., decays with every call)
+    MFILE_Dirty     *dirty;         // Tracking of the modified pages, used to skip clean regions (NULL if not supported)
+    size_t          num_promoted;   // Number of regions migrated to memory
+    size_t          num_demoted;    // Number of regions migrated to the file
+    pthread_mutex_t mutex;          // Mutex that protects the state of the regions
+} MFILE_Tier;
+
+/**
+ * Helper method that retrieves the length of a region, which is clipped to the
+ * end of the storage part (i.e., the mapping or the file).
+ */
+size_t getRegionLength(MFILE_Tier *tier, size_t index, int file)
+{
+    const size_t offset = index * tier->region;
+    const size_t length = (file) ? tier->length_f : tier->length;
+    
+    return ((offset + tier->region) < length) ? tier->region : (length - offset);
+}
+
+/**
+ * Helper method that copies a region between the memory pool and the file,
+ * retrying after partial transfers.
+ */
+int copyRegion(MFILE_Tier *tier, size_t index, size_t slot, int write)
+{
+    char   *buf   = tier->pool + slot * tier->region;
+    off_t  offset = tier->offset + index * tier->region;
+    size_t length = getRegionLength(tier, index, TRUE);
+    
+    while (length > 0)
+    {
+        ssize_t bytes = (write) ? pwrite(tier->fd, buf, length, offset) :
+                                  pread(tier->fd, buf, length, offset);
+        CHKB(bytes <= 0);
+        
+        buf    += bytes;
+        offset += bytes;
+        length -= bytes;
+    }
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that migrates a region from the file to the given slot of the
+ * memory pool, remapping the pool over the same addresses.
+ */
+int promoteRegion(MFILE_Tier *tier, size_t index, uint32_t slot)
+{
+    const off_t  offset = tier->offset + index * tier->region;
+    const size_t start  = mftime();
+    void         *addr  = NULL;
+    
+    CHK(copyRegion(tier, index, slot, FALSE));
+    
+    addr = mmap(tier->addr + index * tier->region, getRegionLength(tier, index, FALSE), tier->prot,
+                MAP_SHARED | MAP_NORESERVE | MAP_FIXED, tier->pool_fd, (off_t)slot * tier->region);
+    CHKB(addr == MAP_FAILED);
+    
+    // The copy in the page cache is no longer mapped, and thus it can be
+    // released (i.e., only the clean pages are discarded)
+    posix_fadvise(tier->fd, offset, getRegionLength(tier, index, TRUE), POSIX_FADV_DONTNEED);
+    
+    tier->slot[index] = slot;
+    tier->owner[slot] = index;
+    tier->num_used++;
+    tier->num_promoted++;
+    
+    mftrace(MFTRACE_PROMOTE, start, index);
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that checks if a region was modified since it was last
+ * written back, marking it as clean. Every region is considered modified if
+ * the soft-dirty bits are not supported.
+ */
+int takeRegion(MFILE_Tier *tier, size_t index)
+{
+    return (tier->dirty == NULL) || mfdirty_take(tier->dirty, index * tier->region, getRegionLength(tier, index, FALSE));
+}
+
+/**
+ * Helper method that migrates a region from the memory pool back to the file,
+ * releasing the pages of its slot afterwards. The region is only written back
+ * if it was modified.
+ */
+int demoteRegion(MFILE_Tier *tier, size_t index)
+{
+    const uint32_t slot   = tier->slot[index];
+    const off_t    offset = tier->offset + index * tier->region;
+    const size_t   start  = mftime();
+    void           *addr  = NULL;
+    
+    // Note: The slot is kept if the region cannot be written back, as it holds
+    //       the only copy of the modified data
+    if (takeRegion(tier, index) && copyRegion(tier, index, slot, TRUE) != MPI_SUCCESS)
+    {
+        if (tier->dirty != NULL)
+        {
+            mfdirty_mark(tier->dirty, index * tier->region, tier->region);
+        }
+        
+        return ERROR;
+    }
+    
+    addr = mmap(tier->addr + index * tier->region, getRegionLength(tier, index, FALSE), tier->prot,
+                MAP_SHARED | MAP_NORESERVE | MAP_FIXED, tier->fd, offset);
+    CHKB(addr == MAP_FAILED);
+    
+    fallocate(tier->pool_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)slot * tier->region,
+              tier->region);
+    
+    tier->slot[index] = TIER_NONE;
+    tier->owner[slot] = TIER_NONE;
+    tier->num_used--;
+    tier->num_demoted++;
+    
+    mftrace(MFTRACE_DEMOTE, start, index);
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that updates the score of each region with the sampled pages
+ * accessed since the last call, which are unmapped afterwards so that the next
+ * access faults them again. Note that both the file and the memory pool are
+ * shared mappings, and thus unmapping the pages does not discard their content.
+ */
+int sampleRegions(MFILE_Tier *tier)
+{
+    for (size_t index = 0; index < tier->num_regions; index++)
+    {
+        char         *addr     = tier->addr + index * tier->region;
+        const size_t num_pages = getRegionLength(tier, index, FALSE) / tier->pagesize;
+        const size_t stride    = (num_pages > TIER_SAMPLES) ? (num_pages / TIER_SAMPLES) : 1;
+        const off_t  offset    = ((uintptr_t)addr / tier->pagesize) * sizeof(uint64_t);
+        uint32_t     accesses  = 0;
+        
+        CHKB(pread(tier->pagemap, tier->entries, num_pages * sizeof(uint64_t), offset) !=
+             (ssize_t)(num_pages * sizeof(uint64_t)));
+        
+        for (size_t page = 0; page < num_pages; page += stride)
+        {
+            if (tier->entries[page] & PAGEMAP_PRESENT)
+            {
+                accesses++;
+                
+                CHK(madvise(addr + page * tier->pagesize, tier->pagesize, MADV_DONTNEED));
+            }
+        }
+        
+        tier->score[index] = (tier->score[index] >> 1) + accesses;
+    }
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that releases the state of the regions and the memory pool.
+ */
+void freeTier(MFILE_Tier *tier)
+{
+    if (tier->pool != NULL && tier->pool != MAP_FAILED)
+    {
+        munmap(tier->pool, tier->num_slots * tier->region);
+    }
+    
+    if (tier->pool_fd != ERROR)
+    {
+        close(tier->pool_fd);
+    }
+    
+    if (tier->pagemap != ERROR)
+    {
+        close(tier->pagemap);
+    }
+    
+    if (tier->dirty != NULL)
+    {
+        mfdirty_unregister(tier->dirty);
+    }
+    
+    pthread_mutex_destroy(&tier->mutex);
+    free(tier->entries);
+    free(tier->slot);
+    free(tier->owner);
+    free(tier->score);
+    free(tier);
+}
+
+int mftier_register(MFILE *mfile, size_t region, size_t budget)
+{
+    const size_t pagesize = sysconf(_SC_PAGESIZE);
+    const int    mode     = fcntl(mfile->fd, F_GETFL) & O_ACCMODE;
+    MFILE_Tier   *tier    = NULL;
+    
+    // Note: The userfaultfd engine replaces the file mapping of the storage
+    //       part, and the regions are transferred with a single descriptor
+    if (mfile->uffd != NULL || mfile->stripes != NULL)
+    {
+        return ERROR;
+    }
+    else if (mfile->length_s == 0)
+    {
+        return MPI_SUCCESS;
+    }
+    
+    tier              = (MFILE_Tier *)calloc(1, sizeof(MFILE_Tier));
+    tier->addr        = (char *)mfile->addr_s;
+    tier->length      = ((mfile->length_s + pagesize - 1) / pagesize) * pagesize;
+    tier->length_f    = mfile->length_s;
+    tier->fd          = mfile->fd;
+    tier->offset      = mfile->offset;
+    tier->prot        = (mode == O_RDONLY) ? PROT_READ  :
+                        (mode == O_WRONLY) ? PROT_WRITE :
+                                               (PROT_READ | PROT_WRITE);
+    tier->pagesize    = pagesize;
+    tier->region      = (region > pagesize) ? ((region + pagesize - 1) / pagesize) * pagesize : pagesize;
+    tier->num_regions = (tier->length + tier->region - 1) / tier->region;
+    tier->num_slots   = budget / tier->region;
+    tier->num_slots   = (tier->num_slots < tier->num_regions) ? tier->num_slots : tier->num_regions;
+    tier->pool_fd     = memfd_create("mpi_swin_tier", MFD_CLOEXEC);
+    tier->pagemap     = open(PAGEMAP_PATH, O_RDONLY);
+    tier->entries     = (uint64_t *)malloc((tier->region / pagesize) * sizeof(uint64_t));
+    tier->slot        = (uint32_t *)malloc(tier->num_regions * sizeof(uint32_t));
+    tier->owner       = (uint32_t *)malloc(tier->num_slots * sizeof(uint32_t));
+    tier->score       = (uint32_t *)calloc(tier->num_regions, sizeof(uint32_t));
+    pthread_mutex_init(&tier->mutex, NULL);
+    
+    memset(tier->slot,  0xFF, tier->num_regions * sizeof(uint32_t));
+    memset(tier->owner, 0xFF, tier->num_slots * sizeof(uint32_t));
+    
+    // The pool must hold at least one region, and the sampling requires the
+    // page table entries of the process
+    if (tier->num_slots == 0 || tier->pool_fd == ERROR || tier->pagemap == ERROR ||
+        ftruncate(tier->pool_fd, tier->num_slots * tier->region) != MPI_SUCCESS)
+    {
+        DBGPRINTF("Tiering not available (num_slots=%zu errno=%d)", tier->num_slots, errno);
+        
+        freeTier(tier);
+        
+        return ERROR;
+    }
+    
+    tier->pool = mmap(NULL, tier->num_slots * tier->region, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_NORESERVE, tier->pool_fd, 0);
+    
+    if (tier->pool == MAP_FAILED)
+    {
+        freeTier(tier);
+        
+        return MPI_ERR_NO_MEM;
+    }
+    
+    // Track the modified pages of the storage part, so that the regions in
+    // memory are only written back if they were modified
+    mfdirty_register(tier->addr, tier->length, &tier->dirty);
+    
+    mfile->tier = tier;
+    
+    DBGPRINTF("Storage part tiered with region=%zu (num_regions=%zu num_slots=%zu)", tier->region,
+                                                                                    tier->num_regions,
+                                                                                    tier->num_slots);
+    
+    return MPI_SUCCESS;
+}
+
+int mftier_unregister(MFILE mfile)
+{
+    DBGPRINTF("Tiering finished with promoted=%zu demoted=%zu", mfile.tier->num_promoted,
+                                                                mfile.tier->num_demoted);
+    
+    freeTier(mfile.tier);
+    
+    return MPI_SUCCESS;
+}
+
+int mftier_flush(MFILE mfile, size_t offset, size_t length)
+{
+    MFILE_Tier   *tier  = mfile.tier;
+    const size_t first  = offset / tier->region;
+    const size_t last   = (offset + length + tier->region - 1) / tier->region;
+    const size_t end    = (last < tier->num_regions) ? last : tier->num_regions;
+    size_t       count  = 0;
+    int          error  = MPI_SUCCESS;
+    
+    pthread_mutex_lock(&tier->mutex);
+    
+    // Note: Every region in memory is written back if the modified pages are
+    //       not tracked, and the bits of the regions in the file are discarded
+    error = (tier->dirty != NULL) ? mfdirty_collect() : MPI_SUCCESS;
+    
+    for (size_t index = first; index < end && error == MPI_SUCCESS; index++)
+    {
+        if (takeRegion(tier, index) && tier->slot[index] != TIER_NONE)
+        {
+            error = copyRegion(tier, index, tier->slot[index], TRUE);
+            count++;
+            
+            if (error != MPI_SUCCESS && tier->dirty != NULL)
+            {
+                mfdirty_mark(tier->dirty, index * tier->region, tier->region);
+            }
+        }
+    }
+    
+    pthread_mutex_unlock(&tier->mutex);
+    
+    CHK(error);
+    
+    return (count > 0) ? fdatasync(tier->fd) : MPI_SUCCESS;
+}
+
+int mftier_rebalance(MFILE mfile)
+{
+    MFILE_Tier *tier = mfile.tier;
+    int        error = MPI_SUCCESS;
+    
+    pthread_mutex_lock(&tier->mutex);
+    
+    // Note: The soft-dirty bits of the sampled pages are discarded when they
+    //       are unmapped, and thus they are collected first
+    error = (tier->dirty != NULL) ? mfdirty_collect() : MPI_SUCCESS;
+    error = (error == MPI_SUCCESS) ? sampleRegions(tier) : error;
+    
+    // Promote the hottest region in the file while there are free slots, or
+    // while it is hotter than the coldest region in memory (i.e., a region
+    // demoted is never promoted again during the same call)
+    while (error == MPI_SUCCESS)
+    {
+        size_t hot  = tier->num_regions;
+        size_t cold = tier->num_regions;
+        
+        for (size_t index = 0; index < tier->num_regions; index++)
+        {
+            if (tier->slot[index] == TIER_NONE)
+            {
+                hot = (tier->score[index] > 0 && (hot == tier->num_regions ||
+                                                  tier->score[index] > tier->score[hot])) ? index : hot;
+            }
+            else if (cold == tier->num_regions || tier->score[index] < tier->score[cold])
+            {
+                cold = index;
+            }
+        }
+        
+        if (hot == tier->num_regions)
+        {
+            break;
+        }
+        else if (tier->num_used < tier->num_slots)
+        {
+            uint32_t slot = 0;
+            
+            while (tier->owner[slot] != TIER_NONE)
+            {
+                slot++;
+            }
+            
+            error = promoteRegion(tier, hot, slot);
+        }
+        else if (tier->score[hot] > tier->score[cold])
+        {
+            const uint32_t slot = tier->slot[cold];
+            
+            error = demoteRegion(tier, cold);
+            error = (error == MPI_SUCCESS) ? promoteRegion(tier, hot, slot) : error;
+        }
+        else
+        {
+            break;
+        }
+    }
+    
+    DBGPRINTF("Regions rebalanced with num_used=%zu (promoted=%zu demoted=%zu hr=%d)", tier->num_used,
+                                                                                      tier->num_promoted,
+                                                                                      tier->num_demoted,
+                                                                                      error);
+    
+    pthread_mutex_unlock(&tier->mutex);
+    
+    return error;
+}
+
@@ -0,0 +1,46 @@
+#ifndef _MFILE_TIER_H
+#define _MFILE_TIER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Divides the storage part of the mapping in regions of the given size, which
+ * can be migrated to memory (i.e., a shared memory pool of budget bytes) and
+ * back to the file without changing their addresses. The soft-dirty bits are
+ * no longer tracked, as sampling the accesses discards them. An error is
+ * returned if the storage part is already serviced by the userfaultfd engine.
+ */
+int mftier_register(MFILE *mfile, size_t region, size_t budget);
+
+/**
+ * Releases the memory pool of the mapping. Note that the regions in memory
+ * are not written back.
+ */
+int mftier_unregister(MFILE mfile);
+
+/**
+ * Writes back the regions in memory within the given range of the storage
+ * part (relative to its beginning), and persists them with fdatasync.
+ */
+int mftier_flush(MFILE mfile, size_t offset, size_t length);
+
+/**
+ * Samples the accesses to each region since the last call, and migrates the
+ * hottest regions to memory while demoting the coldest ones to the file. The
+ * mapping must not be accessed during the call (i.e., neither by other threads
+ * nor by RMA operations), as the content of the regions is copied before being
+ * remapped. The remapped regions are backed by different pages, and thus any
+ * registration of the mapping with the network (e.g., RDMA) keeps pointing to
+ * the previous pages. The caller cannot register the mapping again, as this is
+ * done by the MPI implementation when the window is created.
+ */
+int mftier_rebalance(MFILE mfile);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
@@ -0,0 +1,163 @@
+
+#include "common.h"
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include "mfile.h"
+#include "mfile_trace.h"
+
+#define TRACE_ENV        "MPI_SWIN_TRACE"           // Prefix of the trace files (disabled if not set)
+#define TRACE_ENV_EVENTS "MPI_SWIN_TRACE_EVENTS"    // Capacity of the ring buffer (in events)
+#define TRACE_EVENTS     (1 << 16)
+#define CONV_USEC        1e-3
+
+/**
+ * Structure that defines an event recorded in the ring buffer.
+ */
+typedef struct
+{
+    uint64_t start;         // Start of the event (i.e., monotonic clock in nanoseconds)
+    uint64_t end;           // End of the event (zero while the entry is being written)
+    uint64_t arg;           // Argument of the event (e.g., bytes flushed)
+    uint32_t event;         // Type of the event (i.e., MFILE_Trace_Event)
+    uint32_t tid;           // Thread that recorded the event
+} MFILE_Trace_Entry;
+
+/**
+ * Structure that contains the ring buffer of the process, where each thread
+ * reserves an entry by incrementing the position atomically.
+ */
+typedef struct
+{
+    MFILE_Trace_Entry *entries;     // Events recorded (NULL if the tracer is disabled)
+    size_t            mask;         // Capacity of the ring buffer minus one (i.e., power of two)
+    size_t            position;     // Number of events recorded since the tracer was enabled
+    char              *prefix;      // Prefix of the trace files
+} MFILE_Trace;
+
+pthread_once_t   g_trace_once = PTHREAD_ONCE_INIT;
+MFILE_Trace      g_trace      = { NULL };
+__thread int32_t g_trace_tid  = 0;                  // Identifier of the calling thread (cached)
+
+const char *g_trace_names[MFTRACE_NUM_EVENTS][2] = { { "alloc",   "length" },
+                                                     { "free",    "length" },
+                                                     { "attach",  "length" },
+                                                     { "detach",  "length" },
+                                                     { "sync",    "allocations" },
+                                                     { "flush",   "bytes" },
+                                                     { "promote", "region" },
+                                                     { "demote",  "region" } };
+
+/**
+ * Helper method that enables the tracer if requested through the environment,
+ * allocating the ring buffer with the requested capacity.
+ */
+void initTrace()
+{
+    const char *prefix   = getenv(TRACE_ENV);
+    const char *events   = getenv(TRACE_ENV_EVENTS);
+    size_t     capacity  = TRACE_EVENTS;
+    size_t     requested = 0;
+    
+    if (prefix == NULL || prefix[0] == '\0')
+    {
+        return;
+    }
+    
+    // Round the capacity up to a power of two, so that the position of each
+    // entry is obtained with a mask
+    if (events != NULL && sscanf(events, "%zu", &requested) == 1 && requested > 0)
+    {
+        for (capacity = 1; capacity < requested; capacity <<= 1);
+    }
+    
+    g_trace.entries = (MFILE_Trace_Entry *)calloc(capacity, sizeof(MFILE_Trace_Entry));
+    g_trace.mask    = capacity - 1;
+    g_trace.prefix  = strdup(prefix);
+    
+    DBGPRINTF("Tracer enabled with prefix=\"%s\" capacity=%zu", prefix, capacity);
+}
+
+void mftrace(MFILE_Trace_Event event, size_t start, size_t arg)
+{
+    MFILE_Trace_Entry *entry   = NULL;
+    size_t            position = 0;
+    
+    pthread_once(&g_trace_once, initTrace);
+    
+    if (g_trace.entries == NULL)
+    {
+        return;
+    }
+    
+    if (g_trace_tid == 0)
+    {
+        g_trace_tid = syscall(SYS_gettid);
+    }
+    
+    position = __atomic_fetch_add(&g_trace.position, 1, __ATOMIC_RELAXED);
+    entry    = &g_trace.entries[position & g_trace.mask];
+    
+    // Note: The end is written last, so that the entries being written (or
+    //       overwritten) while the trace is written are discarded
+    __atomic_store_n(&entry->end, 0, __ATOMIC_RELAXED);
+    entry->start = start;
+    entry->arg   = arg;
+    entry->event = event;
+    entry->tid   = g_trace_tid;
+    __atomic_store_n(&entry->end, mftime(), __ATOMIC_RELEASE);
+}
+
+int mftrace_write(int rank)
+{
+    const size_t    position = __atomic_load_n(&g_trace.position, __ATOMIC_ACQUIRE);
+    const size_t    count    = (position > g_trace.mask) ? (g_trace.mask + 1) : position;
+    char            filename[PATH_MAX];
+    struct timespec ts       = { 0 };
+    double          offset   = 0.0;
+    FILE            *file    = NULL;
+    int             first    = TRUE;
+    
+    pthread_once(&g_trace_once, initTrace);
+    
+    if (g_trace.entries == NULL)
+    {
+        return MPI_SUCCESS;
+    }
+    
+    // Retrieve the offset between the clocks, as the events are recorded with
+    // the monotonic clock (i.e., only comparable within the same node)
+    clock_gettime(CLOCK_REALTIME, &ts);
+    offset = ((double)ts.tv_sec * 1e9 + ts.tv_nsec) - (double)mftime();
+    
+    snprintf(filename, PATH_MAX, "%s.%d.json", g_trace.prefix, rank);
+    file = fopen(filename, "w");
+    CHKB(file == NULL);
+    
+    fprintf(file, "{\"traceEvents\":[\n");
+    
+    for (size_t i = position - count; i < position; i++)
+    {
+        const MFILE_Trace_Entry *entry = &g_trace.entries[i & g_trace.mask];
+        const uint64_t          end    = __atomic_load_n(&entry->end, __ATOMIC_ACQUIRE);
+        
+        if (end == 0 || entry->event >= MFTRACE_NUM_EVENTS)
+        {
+            continue;
+        }
+        
+        fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"mpi_swin\",\"ph\":\"X\",\"ts\":%.3lf,\"dur\":%.3lf,"
+                      "\"pid\":%d,\"tid\":%u,\"args\":{\"%s\":%lu}}",
+                (first) ? "" : ",\n", g_trace_names[entry->event][0], (entry->start + offset) * CONV_USEC,
+                (end - entry->start) * CONV_USEC, rank, entry->tid, g_trace_names[entry->event][1],
+                (unsigned long)entry->arg);
+        
+        first = FALSE;
+    }
+    
+    fprintf(file, "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped\":%zu}}\n", position - count);
+    
+    return fclose(file);
+}
+
@@ -0,0 +1,41 @@
+#ifndef _MFILE_TRACE_H
+#define _MFILE_TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Enumerate that defines the events recorded by the tracer.
+ */
+typedef enum
+{
+    MFTRACE_ALLOC, MFTRACE_FREE, MFTRACE_ATTACH, MFTRACE_DETACH, MFTRACE_SYNC, MFTRACE_FLUSH,
+    MFTRACE_PROMOTE, MFTRACE_DEMOTE, MFTRACE_NUM_EVENTS
+} MFILE_Trace_Event;
+
+/**
+ * Records an event that started at the given time (i.e., mftime) and finished
+ * now, together with an argument that depends on the event (e.g., the bytes
+ * flushed). Instant events are recorded with the current time as start. The
+ * events are kept in a lock-free ring buffer per process, which overwrites the
+ * oldest events once full. Does nothing unless the tracer was enabled through
+ * the "MPI_SWIN_TRACE" environment variable.
+ */
+void mftrace(MFILE_Trace_Event event, size_t start, size_t arg);
+
+/**
+ * Writes the recorded events in the Chrome trace format (JSON), in a file
+ * named after the prefix given in "MPI_SWIN_TRACE" and the given rank (e.g.,
+ * "prefix.0.json"). The timestamps are converted to the realtime clock, so
+ * that the files of several nodes can be aligned. Does nothing if the tracer
+ * is not enabled.
+ */
+int mftrace_write(int rank);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
@@ -0,0 +1,556 @@
+
+#include "common.h"
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/userfaultfd.h>
+#include "mfile.h"
+#include "mfile_uffd.h"
+
+#define UFFD_NUM_INIT       16
+#define UFFD_NUM_MSGS       16                  // Number of events read at once
+#define UFFD_RESIDENT       0x1                 // Cluster loaded in memory
+#define UFFD_DIRTY          0x2                 // Cluster modified since the last write-back
+#define UFFD_REFERENCED     0x4                 // Cluster accessed since the last pass of the clock
+#define UFFD_BUSY           0x8                 // Cluster being written back (i.e., cannot be evicted)
+#define UFFD_FILE           0x10                // Cluster mapped from the file after a failed load (i.e., not serviced)
+
+/**
+ * Structure that represents a range serviced by the userfaultfd engine, which
+ * keeps the state of each cluster of pages.
+ */
+typedef struct MFILE_Uffd
+{
+    char            *addr;          // Start of the range (aligned to the page size)
+    size_t          length;         // Length of the range (aligned to the page size)
+    size_t          length_f;       // Length of the range that is backed by the file
+    int             fd;             // File descriptor of the mapped file
+    size_t          offset;         // Offset of the range within the file
+    size_t          cluster;        // Size of the clusters (multiple of the page size)
+    size_t          num_clusters;   // Number of clusters of the range
+    size_t          max_resident;   // Maximum number of clusters in memory (zero if unlimited)
+    size_t          num_resident;   // Number of clusters in memory
+    size_t          hand;           // Position of the clock for the eviction
+    uint8_t         *state;         // State of each cluster (e.g., UFFD_DIRTY)
+    char            *buffer;        // Buffer used to read the clusters from the file
+    pthread_mutex_t mutex;          // Mutex that protects the state of the clusters
+    MFILE_Stats     *stats;         // Counters of the mapping
+} MFILE_Uffd;
+
+pthread_mutex_t g_uffd_mutex  = PTHREAD_MUTEX_INITIALIZER; // Protects the registered ranges
+int             g_uffd_fd     = ERROR;
+MFILE_Uffd      **g_uffd_regs = NULL;
+int             g_uffd_count  = 0;
+int             g_uffd_size   = 0;
+
+/**
+ * Helper method that retrieves the length of a cluster, which is clipped to the
+ * end of the range.
+ */
+size_t getClusterLength(MFILE_Uffd *range, size_t index)
+{
+    const size_t offset = index * range->cluster;
+    
+    return ((offset + range->cluster) < range->length) ? range->cluster : (range->length - offset);
+}
+
+/**
+ * Helper method that changes the write protection of a range of clusters,
+ * waking up the threads that were blocked on it.
+ */
+int protectClusters(MFILE_Uffd *range, size_t first, size_t count, int protect)
+{
+    struct uffdio_writeprotect wp = { 0 };
+    
+    wp.range.start = (uintptr_t)(range->addr + first * range->cluster);
+    wp.range.len   = (count - 1) * range->cluster + getClusterLength(range, first + count - 1);
+    wp.mode        = (protect) ? UFFDIO_WRITEPROTECT_MODE_WP : 0;
+    
+    return ioctl(g_uffd_fd, UFFDIO_WRITEPROTECT, &wp);
+}
+
+/**
+ * Helper method that writes back a set of consecutive clusters to the file,
+ * which must be resident in memory.
+ */
+int writeClusters(MFILE_Uffd *range, size_t first, size_t count)
+{
+    size_t offset = first * range->cluster;
+    size_t length = count * range->cluster;
+    
+    // The clusters are clipped to the part of the range backed by the file
+    length = (offset >= range->length_f)          ? 0                        :
+             ((offset + length) > range->length_f) ? (range->length_f - offset) :
+                                                    length;
+    
+    while (length > 0)
+    {
+        ssize_t bytes = pwrite(range->fd, range->addr + offset, length, range->offset + offset);
+        CHKB(bytes <= 0);
+        
+        offset += bytes;
+        length -= bytes;
+    }
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that evicts a cluster based on the CLOCK policy, writing it
+ * back to the file if it was modified. Clusters referenced since the last
+ * pass get a second chance, and clusters being written back are skipped.
+ */
+void evictCluster(MFILE_Uffd *range)
+{
+    for (size_t step = 0; step < (range->num_clusters << 1); step++)
+    {
+        const size_t victim = range->hand;
+        uint8_t      *state = &range->state[victim];
+        
+        range->hand = (range->hand + 1) % range->num_clusters;
+        
+        if (!(*state & UFFD_RESIDENT) || (*state & UFFD_BUSY))
+        {
+            continue;
+        }
+        else if (*state & UFFD_REFERENCED)
+        {
+            *state &= ~UFFD_REFERENCED;
+            continue;
+        }
+        
+        // Note: The cluster is protected first, so that any write during the
+        //       write-back waits for the handler (i.e., until it is evicted)
+        if ((*state & UFFD_DIRTY) && (protectClusters(range, victim, 1, TRUE) != MPI_SUCCESS ||
+                                      writeClusters(range, victim, 1) != MPI_SUCCESS))
+        {
+            protectClusters(range, victim, 1, FALSE);
+            continue;
+        }
+        
+        // Note: The last cluster might be shorter than the rest. The pages are
+        //       released, and thus any registration of the cluster with the
+        //       network (e.g., RDMA) keeps pointing to the released pages
+        madvise(range->addr + victim * range->cluster, getClusterLength(range, victim), MADV_DONTNEED);
+        
+        *state = 0;
+        range->num_resident--;
+        
+        return;
+    }
+}
+
+/**
+ * Helper method that maps a cluster directly from the file after a failed load,
+ * so that its page faults are serviced by the kernel instead (i.e., the thread
+ * receives SIGBUS if the file still cannot be read). The cluster is protected
+ * if it cannot be remapped, so that the thread does not fault indefinitely.
+ */
+void disableCluster(MFILE_Uffd *range, size_t index)
+{
+    char                *addr  = range->addr + index * range->cluster;
+    const size_t        length = getClusterLength(range, index);
+    struct uffdio_range wake   = { (uintptr_t)addr, length };
+    
+    if (mmap(addr, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE | MAP_FIXED, range->fd,
+             range->offset + index * range->cluster) == MAP_FAILED)
+    {
+        mprotect(addr, length, PROT_NONE);
+    }
+    
+    range->state[index] = UFFD_FILE;
+    
+    ioctl(g_uffd_fd, UFFDIO_WAKE, &wake);
+    
+    DBGPRINTF("Cluster %zu disabled after a failed load (errno=%d)", index, errno);
+}
+
+/**
+ * Helper method that loads a cluster from the file after a missing page. The
+ * cluster is mapped write-protected, unless the fault was caused by a write.
+ * The cluster is disabled if it cannot be read or mapped, instead of exposing
+ * zeros to the application.
+ */
+void loadCluster(MFILE_Uffd *range, size_t index, int write)
+{
+    const size_t       pagesize = sysconf(_SC_PAGESIZE);
+    const size_t       offset   = index * range->cluster;
+    const size_t       length   = getClusterLength(range, index);
+    struct uffdio_copy copy     = { 0 };
+    ssize_t            bytes    = 0;
+    
+    if (range->max_resident > 0 && range->num_resident >= range->max_resident)
+    {
+        evictCluster(range);
+    }
+    
+    // Read the cluster, filling with zeros the part beyond the end of the file
+    if (offset < range->length_f)
+    {
+        bytes = pread(range->fd, range->buffer, ((offset + length) < range->length_f) ?
+                                                length : (range->length_f - offset), range->offset + offset);
+    }
+    
+    if (bytes < 0)
+    {
+        disableCluster(range, index);
+        
+        return;
+    }
+    
+    memset(range->buffer + ((bytes > 0) ? bytes : 0), 0, length - ((bytes > 0) ? bytes : 0));
+    
+    // Map the cluster page by page if the copy is interrupted (e.g., EAGAIN),
+    // skipping the pages that are already mapped (e.g., EEXIST)
+    for (size_t copied = 0; copied < length; )
+    {
+        copy.dst  = (uintptr_t)(range->addr + offset + copied);
+        copy.src  = (uintptr_t)(range->buffer + copied);
+        copy.len  = length - copied;
+        copy.mode = (write) ? 0 : UFFDIO_COPY_MODE_WP;
+        copy.copy = 0;
+        
+        // Note: The field contains the negated error code if nothing was copied
+        if (ioctl(g_uffd_fd, UFFDIO_COPY, &copy) == MPI_SUCCESS || copy.copy > 0)
+        {
+            copied += copy.copy;
+        }
+        else if (errno == EEXIST)
+        {
+            struct uffdio_range wake = { copy.dst, pagesize };
+            
+            ioctl(g_uffd_fd, UFFDIO_WAKE, &wake);
+            
+            copied += pagesize;
+        }
+        else if (errno != EAGAIN)
+        {
+            disableCluster(range, index);
+            
+            return;
+        }
+    }
+    
+    range->state[index] = UFFD_RESIDENT | UFFD_REFERENCED | ((write) ? UFFD_DIRTY : 0);
+    range->num_resident++;
+}
+
+/**
+ * Helper method that services a page fault of a registered range.
+ */
+void handleFault(struct uffd_msg *msg)
+{
+    const uintptr_t addr   = (uintptr_t)msg->arg.pagefault.address;
+    const int       write  = (msg->arg.pagefault.flags & UFFD_PAGEFAULT_FLAG_WRITE) != 0;
+    MFILE_Uffd      *range = NULL;
+    
+    pthread_mutex_lock(&g_uffd_mutex);
+    
+    for (int i = 0; range == NULL && i < g_uffd_count; i++)
+    {
+        range = (addr >= (uintptr_t)g_uffd_regs[i]->addr &&
+                 addr <  (uintptr_t)g_uffd_regs[i]->addr + g_uffd_regs[i]->length) ? g_uffd_regs[i] : NULL;
+    }
+    
+    if (range != NULL)
+    {
+        const size_t index = (addr - (uintptr_t)range->addr) / range->cluster;
+        
+        pthread_mutex_lock(&range->mutex);
+        
+        mfstats_fault(range->stats);
+        
+        if (!(range->state[index] & UFFD_RESIDENT))
+        {
+            loadCluster(range, index, write);
+        }
+        else if (msg->arg.pagefault.flags & UFFD_PAGEFAULT_FLAG_WP)
+        {
+            // First write after loading or writing back the cluster
+            range->state[index] |= UFFD_DIRTY | UFFD_REFERENCED;
+            protectClusters(range, index, 1, FALSE);
+        }
+        else
+        {
+            struct uffdio_range wake = { addr & ~(uintptr_t)(sysconf(_SC_PAGESIZE) - 1), sysconf(_SC_PAGESIZE) };
+            
+            ioctl(g_uffd_fd, UFFDIO_WAKE, &wake);
+        }
+        
+        pthread_mutex_unlock(&range->mutex);
+    }
+    
+    pthread_mutex_unlock(&g_uffd_mutex);
+}
+
+/**
+ * Main method of the handler thread, which services the page faults of every
+ * registered range.
+ */
+void *handlerMain(void *arg)
+{
+    struct uffd_msg msgs[UFFD_NUM_MSGS];
+    
+    (void)arg;
+    
+    while (TRUE)
+    {
+        ssize_t bytes = read(g_uffd_fd, msgs, sizeof(msgs));
+        
+        for (ssize_t i = 0; i < (bytes / (ssize_t)sizeof(struct uffd_msg)); i++)
+        {
+            if (msgs[i].event == UFFD_EVENT_PAGEFAULT)
+            {
+                handleFault(&msgs[i]);
+            }
+        }
+    }
+    
+    return NULL;
+}
+
+/**
+ * Helper method that opens the userfaultfd object and launches the handler
+ * thread, which is shared by every registered range.
+ */
+int initEngine()
+{
+    struct uffdio_api api = { UFFD_API, 0, 0 };
+    pthread_t         thread;
+    
+    // Note: The faults from the kernel must be serviced as well (e.g., when MPI
+    //       reads the window inside a system call), and thus the engine is not
+    //       available if the process is restricted to user-mode faults (i.e.,
+    //       unprivileged_userfaultfd), so that the mmap engine is used instead
+    g_uffd_fd = syscall(__NR_userfaultfd, O_CLOEXEC);
+    CHKB(g_uffd_fd == ERROR);
+    
+    if (ioctl(g_uffd_fd, UFFDIO_API, &api) != MPI_SUCCESS || !(api.features & UFFD_FEATURE_PAGEFAULT_FLAG_WP) ||
+        pthread_create(&thread, NULL, handlerMain, NULL) != MPI_SUCCESS)
+    {
+        close(g_uffd_fd);
+        g_uffd_fd = ERROR;
+        
+        return ERROR;
+    }
+    
+    // Note: The thread remains active until the process finishes
+    pthread_detach(thread);
+    
+    DBGPRINT("Userfaultfd handler thread launched");
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that releases the state of a range.
+ */
+void freeRange(MFILE_Uffd *range)
+{
+    pthread_mutex_destroy(&range->mutex);
+    free(range->state);
+    free(range->buffer);
+    free(range);
+}
+
+int mfuffd_register(MFILE *mfile, size_t cluster, size_t budget)
+{
+    const size_t           pagesize = sysconf(_SC_PAGESIZE);
+    MFILE_Uffd             *range   = NULL;
+    struct uffdio_register reg      = { 0 };
+    void                   *addr    = NULL;
+    int                    hr       = MPI_SUCCESS;
+    
+    // Note: The clusters are transferred with the descriptor of a single file
+    if (mfile->stripes != NULL)
+    {
+        return ERROR;
+    }
+    else if (mfile->length_s == 0)
+    {
+        return MPI_SUCCESS;
+    }
+    
+    range               = (MFILE_Uffd *)calloc(1, sizeof(MFILE_Uffd));
+    range->addr         = (char *)mfile->addr_s;
+    range->length       = ((mfile->length_s + pagesize - 1) / pagesize) * pagesize;
+    range->length_f     = mfile->length_s;
+    range->fd           = mfile->fd;
+    range->offset       = mfile->offset;
+    range->cluster      = (cluster > pagesize) ? ((cluster + pagesize - 1) / pagesize) * pagesize : pagesize;
+    range->num_clusters = (range->length + range->cluster - 1) / range->cluster;
+    range->max_resident = (budget > 0) ? ((budget / range->cluster > 0) ? budget / range->cluster : 1) : 0;
+    range->state        = (uint8_t *)calloc(range->num_clusters, sizeof(uint8_t));
+    range->stats        = mfile->stats;
+    pthread_mutex_init(&range->mutex, NULL);
+    
+    if (posix_memalign((void **)&range->buffer, pagesize, range->cluster) != MPI_SUCCESS)
+    {
+        range->buffer = NULL;
+        freeRange(range);
+        
+        return ERROR;
+    }
+    
+    pthread_mutex_lock(&g_uffd_mutex);
+    
+    if (g_uffd_fd == ERROR)
+    {
+        hr = initEngine();
+    }
+    
+    // Replace the file mapping with an anonymous range and register it, which
+    // is only possible for private anonymous mappings (i.e., write-protect)
+    if (hr == MPI_SUCCESS)
+    {
+        addr = mmap(range->addr, range->length, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+        
+        reg.range.start = (uintptr_t)range->addr;
+        reg.range.len   = range->length;
+        reg.mode        = UFFDIO_REGISTER_MODE_MISSING | UFFDIO_REGISTER_MODE_WP;
+        
+        hr = (addr == MAP_FAILED) ? ERROR : ioctl(g_uffd_fd, UFFDIO_REGISTER, &reg);
+    }
+    
+    if (hr == MPI_SUCCESS)
+    {
+        if (g_uffd_count == g_uffd_size)
+        {
+            g_uffd_size = (g_uffd_size == 0) ? UFFD_NUM_INIT : (g_uffd_size << 1);
+            g_uffd_regs = (MFILE_Uffd **)realloc(g_uffd_regs, sizeof(MFILE_Uffd *) * g_uffd_size);
+        }
+        
+        g_uffd_regs[g_uffd_count++] = range;
+    }
+    else if (addr != NULL && addr != MAP_FAILED)
+    {
+        // Restore the original file mapping if the registration failed
+        addr = mmap(range->addr, mfile->length_s, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_NORESERVE | MAP_FIXED, mfile->fd, mfile->offset);
+    }
+    
+    pthread_mutex_unlock(&g_uffd_mutex);
+    
+    if (hr != MPI_SUCCESS)
+    {
+        DBGPRINTF("Userfaultfd engine not available (errno=%d)", errno);
+        
+        freeRange(range);
+        
+        return (addr == MAP_FAILED) ? MPI_ERR_NO_MEM : ERROR;
+    }
+    
+    mfile->uffd = range;
+    
+    DBGPRINTF("Storage part serviced by userfaultfd (cluster=%zu max_resident=%zu)", range->cluster, range->max_resident);
+    
+    return MPI_SUCCESS;
+}
+
+int mfuffd_unregister(MFILE mfile)
+{
+    MFILE_Uffd *range = mfile.uffd;
+    
+    // Note: The handler holds the lock while servicing a fault, and thus the
+    //       range can be released safely after removing it
+    pthread_mutex_lock(&g_uffd_mutex);
+    
+    for (int i = 0; i < g_uffd_count; i++)
+    {
+        if (g_uffd_regs[i] == range)
+        {
+            g_uffd_regs[i] = g_uffd_regs[--g_uffd_count];
+            break;
+        }
+    }
+    
+    // Note: The disabled clusters are no longer registered, and thus only
+    //       the runs of clusters between them are unregistered
+    for (size_t index = 0; index < range->num_clusters; index++)
+    {
+        size_t count = 0;
+        
+        while ((index + count) < range->num_clusters && !(range->state[index + count] & UFFD_FILE))
+        {
+            count++;
+        }
+        
+        if (count > 0)
+        {
+            struct uffdio_range unreg = { (uintptr_t)(range->addr + index * range->cluster),
+                                          (count - 1) * range->cluster +
+                                          getClusterLength(range, index + count - 1) };
+            
+            ioctl(g_uffd_fd, UFFDIO_UNREGISTER, &unreg);
+        }
+        
+        index += count;
+    }
+    
+    pthread_mutex_unlock(&g_uffd_mutex);
+    
+    freeRange(range);
+    
+    return MPI_SUCCESS;
+}
+
+int mfuffd_flush(MFILE mfile, size_t offset, size_t length, size_t *bytes)
+{
+    MFILE_Uffd   *range = mfile.uffd;
+    const size_t first  = offset / range->cluster;
+    const size_t last   = (offset + length + range->cluster - 1) / range->cluster;
+    const size_t end    = (last < range->num_clusters) ? last : range->num_clusters;
+    int          error  = MPI_SUCCESS;
+    
+    *bytes = 0;
+    
+    // Protect the modified clusters and mark them as clean before the write-back,
+    // so that any write afterwards marks them as modified again
+    pthread_mutex_lock(&range->mutex);
+    
+    for (size_t index = first; index < end; index++)
+    {
+        if ((range->state[index] & UFFD_DIRTY) && protectClusters(range, index, 1, TRUE) == MPI_SUCCESS)
+        {
+            range->state[index] = (range->state[index] & ~UFFD_DIRTY) | UFFD_BUSY;
+        }
+    }
+    
+    pthread_mutex_unlock(&range->mutex);
+    
+    // Write back each set of consecutive clusters at once (i.e., the clusters
+    // cannot be evicted while they are busy)
+    for (size_t index = first; index < end; index++)
+    {
+        size_t count = 0;
+        
+        while ((index + count) < end && (range->state[index + count] & UFFD_BUSY))
+        {
+            count++;
+        }
+        
+        if (count > 0 && writeClusters(range, index, count) != MPI_SUCCESS)
+        {
+            error = ERROR;
+        }
+        
+        pthread_mutex_lock(&range->mutex);
+        
+        for (size_t i = index; i < (index + count); i++)
+        {
+            range->state[i] = (range->state[i] & ~UFFD_BUSY) | ((error != MPI_SUCCESS) ? UFFD_DIRTY : 0);
+        }
+        
+        pthread_mutex_unlock(&range->mutex);
+        
+        *bytes += count * range->cluster;
+        index  += count;
+    }
+    
+    CHK(error);
+    
+    return fdatasync(range->fd);
+}
+
@@ -0,0 +1,41 @@
+#ifndef _MFILE_UFFD_H
+#define _MFILE_UFFD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Replaces the storage part of the mapping with an anonymous range whose page
+ * faults are serviced by the library through userfaultfd. The file is read in
+ * clusters of the given size, and at most budget bytes remain in memory (zero
+ * disables the limit), evicting clusters with a CLOCK policy. If the engine is
+ * not supported (e.g., no write-protect support or the faults from the kernel
+ * cannot be serviced), an error is returned and the mapping remains unmodified.
+ * Note that the evicted clusters are released with MADV_DONTNEED, which breaks
+ * any registration of the pages with the network (e.g., RDMA), and thus the
+ * budget must be disabled if the window is accessed through RDMA. A cluster
+ * that cannot be read is mapped directly from the file instead, so that the
+ * page faults fail as with the default engine (i.e., SIGBUS).
+ */
+int mfuffd_register(MFILE *mfile, size_t cluster, size_t budget);
+
+/**
+ * Stops servicing the page faults of the mapping. Note that the modified
+ * clusters are not written back.
+ */
+int mfuffd_unregister(MFILE mfile);
+
+/**
+ * Writes back the modified clusters within the given range of the storage
+ * part (relative to its beginning), and persists them with fdatasync. The
+ * number of bytes written is returned through the output parameter.
+ */
+int mfuffd_flush(MFILE mfile, size_t offset, size_t length, size_t *bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
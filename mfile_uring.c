@@ -0,0 +1,327 @@
+
+#include "common.h"
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "mfile.h"
+#include "mfile_uring.h"
+
+#define URING_ENTRIES 64
+#define URING_CHUNK   (1 << 20)             // Maximum size of each submitted operation
+
+/**
+ * Structure that keeps the transfers of a mapping that have not completed yet,
+ * so that each mapping only waits for its own transfers.
+ */
+typedef struct MFILE_Direct
+{
+    unsigned num_pending;   // Number of operations that have not completed yet
+    int      error;         // First error found since the last wait
+} MFILE_Direct;
+
+/**
+ * Structure that defines an operation submitted to the ring, which is
+ * identified by its position in the list of operations.
+ */
+typedef struct
+{
+    MFILE_Direct *direct;   // Transfers of the mapping that the operation belongs to (NULL if unused)
+    int          fd;        // File descriptor of the mapped file
+    off_t        offset;    // Offset within the file
+    char         *buf;      // Buffer of the operation
+    size_t       length;    // Length of the operation
+    int          write;     // Flag that determines if the operation writes to the file
+} MFILE_Uring_Op;
+
+/**
+ * Structure that contains the submission and completion queues shared with
+ * the kernel, as well as the operations that have not completed yet.
+ */
+typedef struct
+{
+    int                 fd;             // File descriptor of the ring (ERROR if not supported)
+    unsigned            *sq_tail;       // Tail of the submission queue (i.e., written by the library)
+    unsigned            *sq_mask;       // Mask of the submission queue
+    unsigned            *sq_array;      // Indices of the submitted entries
+    struct io_uring_sqe *sqes;          // Entries of the submission queue
+    unsigned            *cq_head;       // Head of the completion queue (i.e., written by the library)
+    unsigned            *cq_tail;       // Tail of the completion queue
+    unsigned            *cq_mask;       // Mask of the completion queue
+    struct io_uring_cqe *cqes;          // Entries of the completion queue
+    unsigned            entries;        // Number of entries of the submission queue
+    MFILE_Uring_Op      ops[URING_ENTRIES];
+    unsigned            num_pending;    // Number of operations that have not completed yet
+    unsigned            num_queued;     // Number of operations that have not been submitted yet
+} MFILE_Uring;
+
+pthread_once_t  g_uring_once  = PTHREAD_ONCE_INIT;
+pthread_mutex_t g_uring_mutex = PTHREAD_MUTEX_INITIALIZER;  // Protects the ring and the operations
+MFILE_Uring     g_uring       = { .fd = ERROR };
+
+/**
+ * Helper method that creates the ring and maps the queues shared with the
+ * kernel. If io_uring is not supported (e.g., disabled), the file descriptor
+ * of the ring remains invalid.
+ */
+void initRing()
+{
+    struct io_uring_params params = { 0 };
+    size_t                 sq_size = 0;
+    size_t                 cq_size = 0;
+    char                   *sq_ptr = NULL;
+    char                   *cq_ptr = NULL;
+    void                   *sqes   = NULL;
+    int                    fd      = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+    
+    if (fd == ERROR)
+    {
+        DBGPRINTF("io_uring not available (errno=%d)", errno);
+        return;
+    }
+    
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size = params.cq_off.cqes  + params.cq_entries * sizeof(struct io_uring_cqe);
+    
+    // Note: Both queues share the same mapping in recent kernels
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        sq_size = cq_size = (sq_size > cq_size) ? sq_size : cq_size;
+    }
+    
+    sq_ptr = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    cq_ptr = (params.features & IORING_FEAT_SINGLE_MMAP) ? sq_ptr :
+             mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    sqes   = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    
+    if (sq_ptr == MAP_FAILED || cq_ptr == MAP_FAILED || sqes == MAP_FAILED)
+    {
+        close(fd);
+        return;
+    }
+    
+    g_uring.sq_tail  = (unsigned *)(sq_ptr + params.sq_off.tail);
+    g_uring.sq_mask  = (unsigned *)(sq_ptr + params.sq_off.ring_mask);
+    g_uring.sq_array = (unsigned *)(sq_ptr + params.sq_off.array);
+    g_uring.sqes     = (struct io_uring_sqe *)sqes;
+    g_uring.cq_head  = (unsigned *)(cq_ptr + params.cq_off.head);
+    g_uring.cq_tail  = (unsigned *)(cq_ptr + params.cq_off.tail);
+    g_uring.cq_mask  = (unsigned *)(cq_ptr + params.cq_off.ring_mask);
+    g_uring.cqes     = (struct io_uring_cqe *)(cq_ptr + params.cq_off.cqes);
+    g_uring.entries  = (params.sq_entries < URING_ENTRIES) ? params.sq_entries : URING_ENTRIES;
+    g_uring.fd       = fd;
+    
+    DBGPRINTF("io_uring created with entries=%u", g_uring.entries);
+}
+
+/**
+ * Helper method that transfers a range synchronously (i.e., with pread or
+ * pwrite), which is used if io_uring is not supported or after a partial
+ * completion.
+ */
+int transferRange(int fd, off_t offset, char *buf, size_t length, int write)
+{
+    while (length > 0)
+    {
+        ssize_t bytes = (write) ? pwrite(fd, buf, length, offset) :
+                                  pread(fd, buf, length, offset);
+        CHKB(bytes <= 0);
+        
+        offset += bytes;
+        buf    += bytes;
+        length -= bytes;
+    }
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that submits the queued operations and processes the
+ * completed ones, waiting for at least one operation if none has completed.
+ * The partial completions (e.g., short reads) are finished synchronously, and
+ * the errors are recorded in the mapping of each operation.
+ */
+int reapRing()
+{
+    unsigned head = *g_uring.cq_head;
+    unsigned tail = __atomic_load_n(g_uring.cq_tail, __ATOMIC_ACQUIRE);
+    
+    // Wait for the next operation if the completion queue is empty
+    if (head == tail)
+    {
+        int hr = syscall(__NR_io_uring_enter, g_uring.fd, g_uring.num_queued, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        
+        if (hr == ERROR && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+        {
+            return ERROR;
+        }
+        
+        g_uring.num_queued -= (hr > 0) ? hr : 0;
+        
+        return MPI_SUCCESS;
+    }
+    
+    for (; head != tail; head++)
+    {
+        struct io_uring_cqe *cqe  = &g_uring.cqes[head & *g_uring.cq_mask];
+        MFILE_Uring_Op      *op   = &g_uring.ops[cqe->user_data];
+        size_t              bytes = (cqe->res > 0) ? cqe->res : 0;
+        int                 hr    = MPI_SUCCESS;
+        
+        if (bytes < op->length)
+        {
+            hr = transferRange(op->fd, op->offset + bytes, op->buf + bytes, op->length - bytes, op->write);
+        }
+        
+        op->direct->error = (op->direct->error == MPI_SUCCESS) ? hr : op->direct->error;
+        op->direct->num_pending--;
+        op->direct = NULL;
+        
+        g_uring.num_pending--;
+    }
+    
+    __atomic_store_n(g_uring.cq_head, head, __ATOMIC_RELEASE);
+    
+    return MPI_SUCCESS;
+}
+
+int mfuring_submit(MFILE mfile, size_t offset, void *buf, size_t length, int write)
+{
+    const size_t offset_s = (char *)mfile.addr_s - (char *)mfile.addr;
+    
+    int          error    = MPI_SUCCESS;
+    
+    // The transfer must be contained in the storage part of the mapping (i.e.,
+    // of a single file), and neither the engine nor the tiering must keep their
+    // own copy of the pages
+    if (offset < offset_s || (offset + length) > (offset_s + mfile.length_s) || mfile.direct == NULL ||
+        mfile.uffd != NULL || mfile.tier != NULL || mfile.stripes != NULL)
+    {
+        return ERROR;
+    }
+    
+    pthread_once(&g_uring_once, initRing);
+    
+    mfstats_direct(mfile, length);
+    
+    if (g_uring.fd == ERROR)
+    {
+        return transferRange(mfile.fd, mfile.offset + (offset - offset_s), (char *)buf, length, write);
+    }
+    
+    pthread_mutex_lock(&g_uring_mutex);
+    
+    for (size_t chunk = 0; chunk < length; chunk += URING_CHUNK)
+    {
+        const unsigned      tail = *g_uring.sq_tail;
+        const unsigned      slot = tail & *g_uring.sq_mask;
+        struct io_uring_sqe *sqe = &g_uring.sqes[slot];
+        MFILE_Uring_Op      *op  = NULL;
+        unsigned            id   = 0;
+        
+        // Wait for some of the previous operations if every entry is in use
+        while (error == MPI_SUCCESS && g_uring.num_pending == g_uring.entries)
+        {
+            error = reapRing();
+        }
+        
+        if (error != MPI_SUCCESS)
+        {
+            break;
+        }
+        
+        // Note: The operations complete in any order, and thus the first
+        //       unused one is taken
+        while (g_uring.ops[id].direct != NULL)
+        {
+            id++;
+        }
+        
+        op         = &g_uring.ops[id];
+        op->direct = mfile.direct;
+        op->fd     = mfile.fd;
+        op->offset = mfile.offset + (offset - offset_s) + chunk;
+        op->buf    = (char *)buf + chunk;
+        op->length = ((length - chunk) < URING_CHUNK) ? (length - chunk) : URING_CHUNK;
+        op->write  = write;
+        
+        memset(sqe, 0, sizeof(struct io_uring_sqe));
+        sqe->opcode    = (write) ? IORING_OP_WRITE : IORING_OP_READ;
+        sqe->fd        = op->fd;
+        sqe->off       = op->offset;
+        sqe->addr      = (uintptr_t)op->buf;
+        sqe->len       = op->length;
+        sqe->user_data = id;
+        
+        g_uring.sq_array[slot] = slot;
+        __atomic_store_n(g_uring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+        
+        g_uring.num_pending++;
+        g_uring.num_queued++;
+        mfile.direct->num_pending++;
+    }
+    
+    // Submit the whole batch at once, without waiting for completion
+    if (g_uring.num_queued > 0)
+    {
+        int hr = syscall(__NR_io_uring_enter, g_uring.fd, g_uring.num_queued, 0, 0, NULL, 0);
+        
+        g_uring.num_queued -= (hr > 0) ? hr : 0;
+    }
+    
+    // Note: The chunks already submitted are still waited for by the mapping
+    mfile.direct->error = (mfile.direct->error == MPI_SUCCESS) ? error : mfile.direct->error;
+    
+    pthread_mutex_unlock(&g_uring_mutex);
+    
+    return MPI_SUCCESS;
+}
+
+int mfuring_register(MFILE *mfile)
+{
+    if (mfile->uffd != NULL || mfile->tier != NULL || mfile->stripes != NULL)
+    {
+        return ERROR;
+    }
+    
+    mfile->direct = (MFILE_Direct *)calloc(1, sizeof(MFILE_Direct));
+    
+    return MPI_SUCCESS;
+}
+
+int mfuring_unregister(MFILE mfile)
+{
+    const int error = mfuring_wait(mfile);
+    
+    free(mfile.direct);
+    
+    return error;
+}
+
+int mfuring_wait(MFILE mfile)
+{
+    int hr = MPI_SUCCESS;
+    
+    if (mfile.direct == NULL || g_uring.fd == ERROR)
+    {
+        return MPI_SUCCESS;
+    }
+    
+    pthread_mutex_lock(&g_uring_mutex);
+    
+    // Note: The operations of other mappings that complete in the meantime
+    //       are also processed, but their errors are kept for their own wait
+    while (hr == MPI_SUCCESS && mfile.direct->num_pending > 0)
+    {
+        hr = reapRing();
+    }
+    
+    hr                  = (hr == MPI_SUCCESS) ? mfile.direct->error : hr;
+    mfile.direct->error = MPI_SUCCESS;
+    
+    pthread_mutex_unlock(&g_uring_mutex);
+    
+    return hr;
+}
+
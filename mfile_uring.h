@@ -0,0 +1,43 @@
+#ifndef _MFILE_URING_H
+#define _MFILE_URING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Starts a transfer between the given buffer and the storage part of the
+ * mapping (the offset is relative to the beginning of the mapping), which is
+ * issued directly to the file through io_uring (i.e., without page faults).
+ * The transfer is divided in chunks that are submitted as a single batch, and
+ * the buffer must remain valid until mfuring_wait is called. If io_uring is
+ * not supported, the transfer is completed with pread / pwrite instead. An
+ * error is returned if the range is not fully contained in the storage part,
+ * or if the mapping was not registered with mfuring_register.
+ */
+int mfuring_submit(MFILE mfile, size_t offset, void *buf, size_t length, int write);
+
+/**
+ * Enables the transfers issued directly to the file of the mapping, keeping
+ * track of the transfers that have not completed yet. An error is returned if
+ * the mapping does not support them (e.g., striped across several files).
+ */
+int mfuring_register(MFILE *mfile);
+
+/**
+ * Waits for the pending transfers of the mapping and releases their state.
+ */
+int mfuring_unregister(MFILE mfile);
+
+/**
+ * Waits for every transfer of the mapping submitted so far, returning the
+ * first error found. The transfers of other mappings are not waited for.
+ */
+int mfuring_wait(MFILE mfile);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
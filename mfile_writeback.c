@@ -0,0 +1,310 @@
+
+#include "common.h"
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include "mfile.h"
+#include "mfile_writeback.h"
+
+#ifndef __NR_cachestat
+#define __NR_cachestat 451
+#endif
+
+#define WRITEBACK_NUM_INIT 16
+#define NSEC_PER_MSEC      1000000L
+#define NSEC_PER_SEC       1000000000L
+
+/**
+ * Structures that define the range and the result of the cachestat system
+ * call (Linux 6.5+), which allows to query the number of dirty pages.
+ */
+typedef struct
+{
+    uint64_t off;
+    uint64_t len;
+} cachestat_range_t;
+
+typedef struct
+{
+    uint64_t nr_cache;
+    uint64_t nr_dirty;
+    uint64_t nr_writeback;
+    uint64_t nr_evicted;
+    uint64_t nr_recently_evicted;
+} cachestat_t;
+
+/**
+ * Structure that represents a mapping registered in the background flusher.
+ */
+typedef struct
+{
+    void            *addr;          // Address of the mapping (used as identifier)
+    int             fd;             // File descriptor of the mapped file (owned by the mapping)
+    size_t          offset;         // Offset of the storage part within the file
+    size_t          length;         // Length of the storage part
+    size_t          threshold;      // Dirty bytes that trigger the write-back
+    int             interval;       // Interval between checks (in milliseconds)
+    struct timespec deadline;       // Next time that the mapping has to be checked
+} MFILE_Writeback;
+
+pthread_t       g_wb_thread;
+pthread_mutex_t g_wb_lifecycle = PTHREAD_MUTEX_INITIALIZER;  // Serializes the creation / termination of the thread
+pthread_mutex_t g_wb_mutex     = PTHREAD_MUTEX_INITIALIZER;  // Protects the registered mappings
+pthread_cond_t  g_wb_cond;
+int             g_wb_active    = FALSE;
+int             g_wb_cachestat = TRUE;
+MFILE_Writeback *g_wb_regs     = NULL;
+int             g_wb_count     = 0;
+int             g_wb_size      = 0;
+
+/**
+ * Helper method that adds the given number of milliseconds to a timestamp.
+ */
+void addMsec(struct timespec *ts, int msec)
+{
+    ts->tv_sec  += msec / 1000;
+    ts->tv_nsec += (long)(msec % 1000) * NSEC_PER_MSEC;
+    
+    if (ts->tv_nsec >= NSEC_PER_SEC)
+    {
+        ts->tv_sec++;
+        ts->tv_nsec -= NSEC_PER_SEC;
+    }
+}
+
+/**
+ * Helper method that compares two timestamps (i.e., similar to strcmp).
+ */
+int cmpTime(struct timespec a, struct timespec b)
+{
+    return (a.tv_sec  != b.tv_sec)  ? ((a.tv_sec  < b.tv_sec)  ? -1 : 1) :
+           (a.tv_nsec != b.tv_nsec) ? ((a.tv_nsec < b.tv_nsec) ? -1 : 1) : 0;
+}
+
+/**
+ * Helper method that determines if the write-back of a mapping has to be
+ * started, based on the amount of dirty pages in the page cache.
+ */
+int isAboveThreshold(MFILE_Writeback *wb)
+{
+    cachestat_range_t range = { wb->offset, wb->length };
+    cachestat_t       cstat = { 0 };
+    
+    // If the kernel does not support cachestat, we always start the write-back
+    // (i.e., the request is cheap if there are no dirty pages)
+    if (!g_wb_cachestat || syscall(__NR_cachestat, wb->fd, &range, &cstat, 0) == ERROR)
+    {
+        g_wb_cachestat = (g_wb_cachestat && errno != ENOSYS);
+        
+        return TRUE;
+    }
+    
+    return ((cstat.nr_dirty * sysconf(_SC_PAGESIZE)) >= wb->threshold);
+}
+
+/**
+ * Main method of the background flusher thread, which checks the registered
+ * mappings when their interval expires and starts the asynchronous write-back.
+ * The write-back is started without holding the lock, as it might block if the
+ * queue of the device is congested (i.e., it would block the registrations).
+ */
+void *flusherMain(void *arg)
+{
+    MFILE_Writeback *due      = NULL;
+    int             due_size  = 0;
+    
+    (void)arg;
+    
+    pthread_mutex_lock(&g_wb_mutex);
+    
+    while (g_wb_active)
+    {
+        struct timespec now       = { 0 };
+        struct timespec deadline  = { 0 };
+        int             due_count = 0;
+        
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        
+        deadline = now;
+        addMsec(&deadline, INT_MAX);
+        
+        if (due_size < g_wb_count)
+        {
+            due_size = g_wb_size;
+            due      = (MFILE_Writeback *)realloc(due, sizeof(MFILE_Writeback) * due_size);
+        }
+        
+        for (int i = 0; i < g_wb_count; i++)
+        {
+            MFILE_Writeback *wb = &g_wb_regs[i];
+            
+            if (cmpTime(wb->deadline, now) <= 0)
+            {
+                // Note: The descriptor is duplicated, as the mapping might be
+                //       released while its write-back is being started
+                due[due_count]    = *wb;
+                due[due_count].fd = dup(wb->fd);
+                due_count        += (due[due_count].fd != ERROR);
+                
+                wb->deadline = now;
+                addMsec(&wb->deadline, wb->interval);
+            }
+            
+            if (cmpTime(wb->deadline, deadline) < 0)
+            {
+                deadline = wb->deadline;
+            }
+        }
+        
+        if (due_count > 0)
+        {
+            pthread_mutex_unlock(&g_wb_mutex);
+            
+            for (int i = 0; i < due_count; i++)
+            {
+                // Note: SYNC_FILE_RANGE_WRITE only starts the write-back of the
+                // dirty pages, without waiting for the completion
+                if (isAboveThreshold(&due[i]))
+                {
+                    sync_file_range(due[i].fd, due[i].offset, due[i].length,
+                                    SYNC_FILE_RANGE_WRITE);
+                }
+                
+                close(due[i].fd);
+            }
+            
+            pthread_mutex_lock(&g_wb_mutex);
+            
+            // Note: The deadlines are recomputed before waiting, as the signals
+            //       from the registrations are lost while the lock is released
+            continue;
+        }
+        
+        pthread_cond_timedwait(&g_wb_cond, &g_wb_mutex, &deadline);
+    }
+    
+    pthread_mutex_unlock(&g_wb_mutex);
+    
+    free(due);
+    
+    return NULL;
+}
+
+int mfwriteback_register(MFILE mfile, size_t threshold, int interval)
+{
+    MFILE_Writeback wb = { 0 };
+    
+    // Note: The dirty pages are sampled from the cache of a single file
+    if (mfile.stripes != NULL)
+    {
+        return ERROR;
+    }
+    else if (mfile.length_s == 0)
+    {
+        return MPI_SUCCESS;
+    }
+    
+    wb.fd        = mfile.fd;
+    wb.addr      = mfile.addr;
+    wb.offset    = mfile.offset;
+    wb.length    = mfile.length_s;
+    wb.threshold = threshold;
+    wb.interval  = (interval > 0) ? interval : 1;
+    
+    clock_gettime(CLOCK_MONOTONIC, &wb.deadline);
+    addMsec(&wb.deadline, wb.interval);
+    
+    pthread_mutex_lock(&g_wb_lifecycle);
+    pthread_mutex_lock(&g_wb_mutex);
+    
+    if (g_wb_regs == NULL)
+    {
+        g_wb_regs = (MFILE_Writeback *)malloc(sizeof(MFILE_Writeback) * WRITEBACK_NUM_INIT);
+        g_wb_size = WRITEBACK_NUM_INIT;
+    }
+    else if (g_wb_count == g_wb_size)
+    {
+        g_wb_size <<= 1;
+        g_wb_regs   = (MFILE_Writeback *)realloc(g_wb_regs, sizeof(MFILE_Writeback) * g_wb_size);
+    }
+    
+    g_wb_regs[g_wb_count++] = wb;
+    
+    // Launch the flusher thread if this is the first mapping, or wake it up
+    // to consider the new deadline otherwise
+    if (!g_wb_active)
+    {
+        pthread_condattr_t attr;
+        
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&g_wb_cond, &attr);
+        pthread_condattr_destroy(&attr);
+        
+        g_wb_active = TRUE;
+        
+        if (pthread_create(&g_wb_thread, NULL, flusherMain, NULL) != MPI_SUCCESS)
+        {
+            g_wb_active = FALSE;
+            g_wb_count--;
+            
+            pthread_mutex_unlock(&g_wb_mutex);
+            pthread_mutex_unlock(&g_wb_lifecycle);
+            
+            return ERROR;
+        }
+        
+        DBGPRINT("Background flusher thread launched");
+    }
+    else
+    {
+        pthread_cond_signal(&g_wb_cond);
+    }
+    
+    pthread_mutex_unlock(&g_wb_mutex);
+    pthread_mutex_unlock(&g_wb_lifecycle);
+    
+    return MPI_SUCCESS;
+}
+
+int mfwriteback_unregister(MFILE mfile)
+{
+    int found = FALSE;
+    
+    pthread_mutex_lock(&g_wb_lifecycle);
+    pthread_mutex_lock(&g_wb_mutex);
+    
+    for (int i = 0; i < g_wb_count; i++)
+    {
+        if (g_wb_regs[i].addr == mfile.addr)
+        {
+            found        = TRUE;
+            g_wb_regs[i] = g_wb_regs[--g_wb_count];
+            break;
+        }
+    }
+    
+    // Stop the flusher thread after the last mapping is removed
+    if (found && g_wb_count == 0)
+    {
+        g_wb_active = FALSE;
+        
+        pthread_cond_signal(&g_wb_cond);
+        pthread_mutex_unlock(&g_wb_mutex);
+        pthread_join(g_wb_thread, NULL);
+        pthread_cond_destroy(&g_wb_cond);
+        
+        DBGPRINT("Background flusher thread stopped");
+    }
+    else
+    {
+        pthread_mutex_unlock(&g_wb_mutex);
+    }
+    
+    pthread_mutex_unlock(&g_wb_lifecycle);
+    
+    // Note: Mappings that were not registered are ignored
+    return MPI_SUCCESS;
+}
+
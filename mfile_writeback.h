@@ -0,0 +1,28 @@
+#ifndef _MFILE_WRITEBACK_H
+#define _MFILE_WRITEBACK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Registers the storage part of a mapping in the background flusher thread,
+ * which periodically starts the asynchronous write-back of the modified pages
+ * once they exceed the given threshold (in bytes). The interval between checks
+ * is defined in milliseconds. The thread is created on the first registration.
+ * The file descriptor of the mapping must remain open until it is removed.
+ */
+int mfwriteback_register(MFILE mfile, size_t threshold, int interval);
+
+/**
+ * Removes the mapping from the background flusher thread, if registered. The
+ * thread is stopped after the last mapping is removed.
+ */
+int mfwriteback_unregister(MFILE mfile);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
@@ -0,0 +1,106 @@
+#ifndef _MPI_STORAGE_WINDOWS_EXT_H
+#define _MPI_STORAGE_WINDOWS_EXT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MPIX_WIN_STATE_NEW   0 // The file of the window was created (i.e., no valid header was found)
+#define MPIX_WIN_STATE_CLEAN 1 // The window was reattached to a file that was released cleanly
+#define MPIX_WIN_STATE_DIRTY 2 // The window was reattached to a file that was not released cleanly
+
+/**
+ * Structure that contains the counters of the storage allocations of a window,
+ * or of every storage allocation of the process (including released ones).
+ */
+typedef struct
+{
+    MPI_Count num_allocs;       // Number of storage allocations
+    double    time_alloc;       // Time spent creating the allocations (in seconds)
+    MPI_Count num_frees;        // Number of storage allocations released (only for the process)
+    double    time_free;        // Time spent releasing the allocations (only for the process)
+    MPI_Count num_syncs;        // Number of synchronizations of the allocations
+    double    time_sync;        // Time spent synchronizing the allocations (in seconds)
+    MPI_Count bytes_flushed;    // Bytes flushed to storage
+    MPI_Count num_faults;       // Page faults serviced by the "uffd" engine
+    MPI_Count bytes_direct;     // Bytes of the local MPI_Put / MPI_Get issued directly to the file
+} MPIX_Win_stats;
+
+/**
+ * Extension that starts the synchronization of a window without blocking,
+ * handing the storage allocations to the flushing threads of each device
+ * (see "storage_alloc_sync_threads"). The request is completed with MPI_Wait /
+ * MPI_Test once every allocation is flushed. Note that the window must not be
+ * released while the request is active. If MPI was not initialized with
+ * MPI_THREAD_MULTIPLE, the window is flushed before returning and the request
+ * is already completed.
+ */
+int MPIX_Win_isync(MPI_Win win, MPI_Request *request);
+
+/**
+ * Extension that retrieves the number of bytes flushed to storage for a
+ * given window, both during the last MPI_Win_sync and since the window was
+ * created (i.e., accumulated for every storage allocation of the window).
+ */
+int MPIX_Win_get_flushed(MPI_Win win, MPI_Count *bytes_last, MPI_Count *bytes_total);
+
+/**
+ * Extension that retrieves the bandwidth of the last MPI_Win_sync of a given
+ * window (in bytes per second), considering every storage allocation of the
+ * window. The bandwidth is zero if the window has not been flushed yet.
+ */
+int MPIX_Win_get_flush_bandwidth(MPI_Win win, double *bandwidth);
+
+/**
+ * Extension that synchronizes a window and creates a snapshot of its storage
+ * allocations in the given path (i.e., one file per allocation, adding the
+ * index as suffix after the first one). The storage part is cloned from the
+ * mapped file, which only requires to update the metadata on file systems
+ * with shared extents (e.g., XFS or Btrfs), falling back to a copy otherwise.
+ * The snapshot can be restored into a new window with "storage_alloc_snapshot".
+ */
+int MPIX_Win_snapshot(MPI_Win win, const char *path);
+
+/**
+ * Extension that migrates the regions of the storage allocations created with
+ * "storage_alloc_tier_budget", promoting the hottest regions to memory and
+ * demoting the coldest ones to the file. The call is collective and must be
+ * issued by every process outside any access or exposure epoch of the window,
+ * as it completes the pending RMA operations with a fence before the regions
+ * are remapped. Other threads must not access the window during the call.
+ * Note that the fence does not register the window again with the network, and
+ * thus the remote operations issued afterwards through RDMA would still target
+ * the pages that were registered when the window was created (i.e., tiering is
+ * only safe if the MPI implementation does not register the window memory).
+ */
+int MPIX_Win_rebalance(MPI_Win win);
+
+/**
+ * Extension that retrieves the state of the files of a window when it was
+ * created with "storage_alloc_header" (e.g., MPIX_WIN_STATE_CLEAN if every
+ * file was reattached after a clean release). The state is DIRTY if any file
+ * was not released cleanly, and NEW if any file was created or the window
+ * does not have storage allocations with a header.
+ */
+int MPIX_Win_get_state(MPI_Win win, int *state);
+
+/**
+ * Extension that retrieves the counters accumulated by the storage allocations
+ * of a given window since they were created.
+ */
+int MPIX_Win_get_stats(MPI_Win win, MPIX_Win_stats *stats);
+
+/**
+ * Extension that retrieves the counters accumulated by every storage
+ * allocation of the calling process, including the ones already released.
+ * If the "MPI_SWIN_STATS" environment variable is set (and not "0"), these
+ * counters are printed by each process during MPI_Finalize.
+ */
+int MPIX_Get_stats(MPIX_Win_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
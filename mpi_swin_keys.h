@@ -2,18 +2,39 @@
 #define _MPI_STORAGE_WINDOWS_KEYS_H
 
 // MPI Storage Windows keys
-#define MPI_SWIN_ALLOC_TYPE     "alloc_type"                // Defines if the window is allocated in storage ({ "memory", "storage" })
-#define MPI_SWIN_FILENAME       "storage_alloc_filename"    // Determines the file-path for the mapping
-#define MPI_SWIN_OFFSET         "storage_alloc_offset"      // Specifies the offset inside the given file or device
-#define MPI_SWIN_FACTOR         "storage_alloc_factor"      // Defines the allocation factor (i.e., the part on storage)
-#define MPI_SWIN_ORDER          "storage_alloc_order"       // Defines the order of the allocation (i.e., first memory or storage)
-#define MPI_SWIN_UNLINK         "storage_alloc_unlink"      // Allows to delete the file during window deallocation ({ "true", "false" })
+#define MPI_SWIN_ALLOC_TYPE          "alloc_type"                        // Defines if the window is allocated in storage ({ "memory", "storage" })
+#define MPI_SWIN_FILENAME            "storage_alloc_filename"            // Determines the file-path for the mapping (or a list of files to stripe it)
+#define MPI_SWIN_OFFSET              "storage_alloc_offset"              // Specifies the offset inside the given file or device (or "auto")
+#define MPI_SWIN_FACTOR              "storage_alloc_factor"              // Defines the allocation factor (i.e., the part on storage)
+#define MPI_SWIN_ORDER               "storage_alloc_order"               // Defines the order of the allocation (i.e., first memory or storage)
+#define MPI_SWIN_UNLINK              "storage_alloc_unlink"              // Allows to delete the file during window deallocation ({ "true", "false" })
+#define MPI_SWIN_DIRTY_TRACKING      "storage_alloc_dirty_tracking"      // Ignored, as the kernel only flushes the modified pages already ({ "true", "false" })
+#define MPI_SWIN_WRITEBACK           "storage_alloc_writeback"           // Defines how the modified pages are written back ({ "sync", "background" })
+#define MPI_SWIN_WRITEBACK_THRESHOLD "storage_alloc_writeback_threshold" // Dirty bytes that start the background write-back
+#define MPI_SWIN_WRITEBACK_INTERVAL  "storage_alloc_writeback_interval"  // Interval between background write-back checks (in milliseconds)
+#define MPI_SWIN_HUGEPAGES           "storage_alloc_hugepages"           // Backs the memory part with huge pages ({ "none", "explicit", "transparent" })
+#define MPI_SWIN_POPULATE            "storage_alloc_populate"            // Prefaults the allocation before returning it ({ "none", "read", "write" })
+#define MPI_SWIN_POPULATE_THREADS    "storage_alloc_populate_threads"    // Number of threads that prefault the allocation
+#define MPI_SWIN_PREALLOC            "storage_alloc_prealloc"            // Preallocation of the file ({ "none", "fallocate", "fallocate_keep_size", "zero_range", "auto" })
+#define MPI_SWIN_FLUSH               "storage_alloc_flush"               // Defines how MPI_Win_sync flushes the storage part ({ "msync", "fdatasync" })
+#define MPI_SWIN_SYNC_THREADS        "storage_alloc_sync_threads"        // Number of threads per device that flush the window during MPI_Win_sync
+#define MPI_SWIN_SYNC_CHUNK          "storage_alloc_sync_chunk"          // Size of the chunks flushed concurrently during MPI_Win_sync (in bytes)
+#define MPI_SWIN_ENGINE              "storage_alloc_engine"              // Defines who services the page faults of the storage part ({ "mmap", "uffd" })
+#define MPI_SWIN_ENGINE_CLUSTER      "storage_alloc_engine_cluster"      // Size of the clusters read and written by the "uffd" engine (in bytes)
+#define MPI_SWIN_ENGINE_BUDGET       "storage_alloc_engine_budget"       // Maximum bytes kept in memory by the "uffd" engine (zero if unlimited, required with RDMA)
+#define MPI_SWIN_URING_THRESHOLD     "storage_alloc_uring_threshold"     // Minimum size of the local MPI_Put / MPI_Get issued through io_uring (zero disables it)
+#define MPI_SWIN_TIER_BUDGET         "storage_alloc_tier_budget"         // Memory available to the hot regions of the storage part (zero disables the tiering, not valid with RDMA)
+#define MPI_SWIN_TIER_REGION         "storage_alloc_tier_region"         // Size of the regions migrated between memory and storage (in bytes)
+#define MPI_SWIN_SNAPSHOT            "storage_alloc_snapshot"            // Restores the content of a snapshot created with MPIX_Win_snapshot
+#define MPI_SWIN_HEADER              "storage_alloc_header"              // Describes the layout of the window in a header of the file ({ "true", "false" })
+#define MPI_SWIN_STRIPE_SIZE         "storage_alloc_stripe_size"         // Size of the stripes if several files are given, separated by commas (in bytes)
+#define MPI_SWIN_LAYOUT              "storage_alloc_layout"              // Layout of the allocations that share a file ({ "contiguous", "block_cyclic" })
 
 // MPI I/O supported keys
-#define MPI_IO_ACCESS_STYLE     "access_style"              // Defines the access style of the window
-#define MPI_IO_FILE_PERM        "file_perm"                 // Sets the permission of the file mapping (OR of mode_t values - see "man open")
-#define MPI_IO_STRIPING_FACTOR  "striping_factor"           // Number of I/O devices that the file should be stripped across
-#define MPI_IO_STRIPING_UNIT    "striping_unit"             // Stripe unit used for the file
+#define MPI_IO_ACCESS_STYLE          "access_style"                      // Defines the access style of the window
+#define MPI_IO_FILE_PERM             "file_perm"                         // Sets the permission of the file mapping (OR of mode_t values - see "man open")
+#define MPI_IO_STRIPING_FACTOR       "striping_factor"                   // Number of I/O devices that the file should be stripped across
+#define MPI_IO_STRIPING_UNIT         "striping_unit"                     // Stripe unit used for the file
 
 #endif
 
@@ -0,0 +1,722 @@
+#include "common.h"
+#include "mpi_swin_keys.h"
+#include "mpi_swin_ext.h"
+
+#define NUM_ELEMS       10000
+#define NUM_STRIPES     2
+#define CYCLIC_BLOCKS   3
+#define NUM_ITERATIONS  16
+#define ENGINE_CLUSTERS 4
+#define NUM_ALLOCS      2
+#define TIER_REGIONS    8
+#define TIER_SLOTS      2
+
+/**
+ * Helper method that allows to create an MPI_Info object that sets the
+ * allocation of the window to the storage device, using the given file(s).
+ */
+int createDefaultInfo(const char *filename, const char *offset, MPI_Info* info)
+{
+    CHK(MPI_Info_create(info));
+    CHK(MPI_Info_set(*info, MPI_SWIN_ALLOC_TYPE, "storage"));
+    CHK(MPI_Info_set(*info, MPI_SWIN_FILENAME,   filename));
+    CHK(MPI_Info_set(*info, MPI_SWIN_OFFSET,     offset));
+    CHK(MPI_Info_set(*info, MPI_SWIN_UNLINK,     "false"));
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that fills the given buffer with consecutive values.
+ */
+void fillValues(int *baseptr, size_t count, int value)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        baseptr[i] = value + (int)i;
+    }
+}
+
+/**
+ * Helper method that verifies that the given buffer contains consecutive
+ * values, starting with the given one.
+ */
+int checkValues(const int *baseptr, size_t count, int value)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        CHKB(baseptr[i] != value + (int)i);
+    }
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that verifies that the file contains consecutive values at
+ * the given offset, reading the file directly (i.e., without the window).
+ */
+int checkFile(const char *filename, off_t offset, size_t count, int value)
+{
+    int *buffer = (int *)malloc(count * sizeof(int));
+    int fd      = open(filename, O_RDONLY);
+    int error   = (buffer == NULL || fd == ERROR);
+    
+    if (!error)
+    {
+        error = (pread(fd, buffer, count * sizeof(int), offset) != (ssize_t)(count * sizeof(int))) ||
+                (checkValues(buffer, count, value) != MPI_SUCCESS);
+    }
+    
+    if (fd != ERROR)
+    {
+        close(fd);
+    }
+    
+    free(buffer);
+    
+    return (error) ? ERROR : MPI_SUCCESS;
+}
+
+/**
+ * Helper method that creates a snapshot of a combined window (i.e., half of
+ * the window in memory) and restores it into a window mapped to another file,
+ * after the content of the original window was modified.
+ */
+int testSnapshot(int rank)
+{
+    const MPI_Aint size       = NUM_ELEMS * sizeof(int);
+    const int      value      = rank * NUM_ELEMS;
+    MPI_Win        win        = MPI_WIN_NULL;
+    MPI_Info       info       = MPI_INFO_NULL;
+    int            *baseptr   = NULL;
+    char           filename[PATH_MAX];
+    char           filename_r[PATH_MAX];
+    char           path[PATH_MAX];
+    
+    sprintf(filename,   "./mpi_swin_snap_%d.win", rank);
+    sprintf(filename_r, "./mpi_swin_restore_%d.win", rank);
+    sprintf(path,       "./mpi_swin_snap_%d.tmp", rank);
+    
+    CHK(createDefaultInfo(filename, "0", &info));
+    CHK(MPI_Info_set(info, MPI_SWIN_FACTOR, "0.5"));
+    CHK(MPI_Win_allocate(size, sizeof(int), info, MPI_COMM_WORLD, (void**)&baseptr, &win));
+    
+    fillValues(baseptr, NUM_ELEMS, value);
+    
+    CHK(MPIX_Win_snapshot(win, path));
+    CHK(checkFile(path, 0, NUM_ELEMS, value));
+    
+    // Modify the window after the snapshot, which must not affect the restore
+    fillValues(baseptr, NUM_ELEMS, -value);
+    
+    CHK(MPI_Win_free(&win));
+    CHK(MPI_Info_free(&info));
+    
+    CHK(createDefaultInfo(filename_r, "0", &info));
+    CHK(MPI_Info_set(info, MPI_SWIN_FACTOR,   "0.5"));
+    CHK(MPI_Info_set(info, MPI_SWIN_SNAPSHOT, path));
+    CHK(MPI_Win_allocate(size, sizeof(int), info, MPI_COMM_WORLD, (void**)&baseptr, &win));
+    CHK(checkValues(baseptr, NUM_ELEMS, value));
+    CHK(MPI_Win_free(&win));
+    CHK(MPI_Info_free(&info));
+    
+    unlink(filename);
+    unlink(filename_r);
+    unlink(path);
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that reattaches a window with a header to its file, both after
+ * a clean release and while the file is still mapped by another window (i.e.,
+ * the header is not marked as clean, as it would happen if the job aborts).
+ */
+int testHeader(int rank)
+{
+    const MPI_Aint size       = NUM_ELEMS * sizeof(int);
+    const int      value      = rank * NUM_ELEMS;
+    MPI_Win        win        = MPI_WIN_NULL;
+    MPI_Win        win_dirty  = MPI_WIN_NULL;
+    MPI_Info       info       = MPI_INFO_NULL;
+    int            *baseptr   = NULL;
+    int            *baseptr_d = NULL;
+    int            state      = ERROR;
+    char           filename[PATH_MAX];
+    
+    sprintf(filename, "./mpi_swin_header_%d.win", rank);
+    unlink(filename);
+    
+    CHK(createDefaultInfo(filename, "0", &info));
+    CHK(MPI_Info_set(info, MPI_SWIN_HEADER, "true"));
+    
+    // Create the file and release the window cleanly
+    CHK(MPI_Win_allocate(size, sizeof(int), info, MPI_COMM_WORLD, (void**)&baseptr, &win));
+    CHK(MPIX_Win_get_state(win, &state));
+    CHKB(state != MPIX_WIN_STATE_NEW);
+    
+    fillValues(baseptr, NUM_ELEMS, value);
+    
+    CHK(MPI_Win_free(&win));
+    
+    // Reattach the file, which keeps the content of the previous window
+    CHK(MPI_Win_allocate(size, sizeof(int), info, MPI_COMM_WORLD, (void**)&baseptr, &win));
+    CHK(MPIX_Win_get_state(win, &state));
+    CHKB(state != MPIX_WIN_STATE_CLEAN);
+    CHK(checkValues(baseptr, NUM_ELEMS, value));
+    
+    fillValues(baseptr, NUM_ELEMS, value + 1);
+    
+    CHK(MPI_Win_lock(MPI_LOCK_EXCLUSIVE, rank, 0, win));
+    CHK(MPI_Win_sync(win));
+    CHK(MPI_Win_unlock(rank, win));
+    
+    // Reattach the file before the window is released
+    CHK(MPI_Win_allocate(size, sizeof(int), info, MPI_COMM_WORLD, (void**)&baseptr_d, &win_dirty));
+    CHK(MPIX_Win_get_state(win_dirty, &state));
+    CHKB(state != MPIX_WIN_STATE_DIRTY);
+    CHK(checkValues(baseptr_d, NUM_ELEMS, value + 1));
+    CHK(MPI_Win_free(&win_dirty));
+    CHK(MPI_Win_free(&win));
+    
+    // A different layout must be rejected, instead of mapping the file
+    CHK(MPI_Info_set(info, MPI_SWIN_FACTOR, "0.5"));
+    CHKB(MPI_Win_allocate(size, sizeof(int), info, MPI_COMM_WORLD, (void**)&baseptr, &win) == MPI_SUCCESS);
+    CHK(MPI_Info_free(&info));
+    
+    unlink(filename);
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that allocates windows of different size on a single file
+ * with "auto" offsets, which must be placed consecutively in rank order and
+ * padded to the page size. Note that every process is expected to run on the
+ * same node, as the file is only shared by the processes of a node.
+ */
+int testAutoOffset(int rank)
+{
+    const size_t   page_size = sysconf(_SC_PAGESIZE);
+    const char     *filename = "./mpi_swin_auto.win";
+    const size_t   count     = (rank + 1) * NUM_ELEMS;
+    const int      value     = rank * NUM_ELEMS * 100;
+    MPI_Win        win       = MPI_WIN_NULL;
+    MPI_Info       info      = MPI_INFO_NULL;
+    int            *baseptr  = NULL;
+    off_t          offset    = 0;
+    
+    CHK(createDefaultInfo(filename, "auto", &info));
+    CHK(MPI_Win_allocate(count * sizeof(int), sizeof(int), info, MPI_COMM_WORLD, (void**)&baseptr, &win));
+    
+    fillValues(baseptr, count, value);
+    
+    CHK(MPI_Win_free(&win));
+    CHK(MPI_Info_free(&info));
+    CHK(MPI_Barrier(MPI_COMM_WORLD));
+    
+    for (int i = 0; i < rank; i++)
+    {
+        offset += (((i + 1) * NUM_ELEMS * sizeof(int) + page_size - 1) / page_size) * page_size;
+    }
+    
+    CHK(checkFile(filename, offset, count, value));
+    CHK(MPI_Barrier(MPI_COMM_WORLD));
+    
+    if (rank == 0)
+    {
+        unlink(filename);
+    }
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that stripes a window across several files, which must keep
+ * the stripes in round-robin order (i.e., the last stripe is incomplete).
+ */
+int testStriping(int rank)
+{
+    const size_t   stripe_size  = 2 * sysconf(_SC_PAGESIZE);
+    const size_t   stripe_elems = stripe_size / sizeof(int);
+    const int      value        = rank * NUM_ELEMS;
+    MPI_Win        win          = MPI_WIN_NULL;
+    MPI_Info       info         = MPI_INFO_NULL;
+    int            *baseptr     = NULL;
+    char           filenames[NUM_STRIPES][PATH_MAX];
+    char           filename[NUM_STRIPES * PATH_MAX];
+    char           stripe[PATH_MAX];
+    
+    filename[0] = '\0';
+    
+    for (int i = 0; i < NUM_STRIPES; i++)
+    {
+        sprintf(filenames[i], "./mpi_swin_stripe_%d_%d.win", rank, i);
+        
+        strcat(filename, (i > 0) ? "," : "");
+        strcat(filename, filenames[i]);
+    }
+    
+    sprintf(stripe, "%zu", stripe_size);
+    
+    CHK(createDefaultInfo(filename, "0", &info));
+    CHK(MPI_Info_set(info, MPI_SWIN_STRIPE_SIZE, stripe));
+    CHK(MPI_Win_allocate(NUM_ELEMS * sizeof(int), sizeof(int), info, MPI_COMM_WORLD, (void**)&baseptr, &win));
+    
+    fillValues(baseptr, NUM_ELEMS, value);
+    
+    CHK(MPI_Win_free(&win));
+    CHK(MPI_Info_free(&info));
+    
+    for (size_t i = 0; i * stripe_elems < NUM_ELEMS; i++)
+    {
+        const size_t count = (NUM_ELEMS - i * stripe_elems < stripe_elems) ? (NUM_ELEMS - i * stripe_elems) :
+                                                                              stripe_elems;
+        
+        CHK(checkFile(filenames[i % NUM_STRIPES], (i / NUM_STRIPES) * stripe_size, count,
+                      value + (int)(i * stripe_elems)));
+    }
+    
+    for (int i = 0; i < NUM_STRIPES; i++)
+    {
+        unlink(filenames[i]);
+    }
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that interleaves the windows of every process in a single file
+ * with the "block_cyclic" layout, which must keep the global order of the
+ * elements (i.e., each process writes its blocks at "block * num_procs + rank").
+ */
+int testBlockCyclic(int rank, int num_procs)
+{
+    const size_t   block_size  = sysconf(_SC_PAGESIZE);
+    const size_t   block_elems = block_size / sizeof(int);
+    const char     *filename   = "./mpi_swin_cyclic.win";
+    MPI_Win        win         = MPI_WIN_NULL;
+    MPI_Info       info        = MPI_INFO_NULL;
+    int            *baseptr    = NULL;
+    char           block[PATH_MAX];
+    
+    sprintf(block, "%zu", block_size);
+    
+    CHK(createDefaultInfo(filename, "0", &info));
+    CHK(MPI_Info_set(info, MPI_SWIN_LAYOUT,      "block_cyclic"));
+    CHK(MPI_Info_set(info, MPI_SWIN_STRIPE_SIZE, block));
+    CHK(MPI_Win_allocate(CYCLIC_BLOCKS * block_size, sizeof(int), info, MPI_COMM_WORLD, (void**)&baseptr,
+                         &win));
+    
+    for (int i = 0; i < CYCLIC_BLOCKS; i++)
+    {
+        fillValues(&baseptr[i * block_elems], block_elems, (int)((i * num_procs + rank) * block_elems));
+    }
+    
+    CHK(MPI_Win_free(&win));
+    CHK(MPI_Info_free(&info));
+    CHK(MPI_Barrier(MPI_COMM_WORLD));
+    
+    if (rank == 0)
+    {
+        CHK(checkFile(filename, 0, CYCLIC_BLOCKS * num_procs * block_elems, 0));
+        
+        unlink(filename);
+    }
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that modifies a window while the background flusher writes
+ * it back, releasing the window afterwards (i.e., the flusher might still be
+ * writing back the mapping when it is unregistered).
+ */
+int testWriteback(int rank)
+{
+    const MPI_Aint size     = NUM_ELEMS * sizeof(int);
+    const int      value    = rank * NUM_ELEMS;
+    MPI_Win        win      = MPI_WIN_NULL;
+    MPI_Info       info     = MPI_INFO_NULL;
+    int            *baseptr = NULL;
+    char           filename[PATH_MAX];
+    
+    sprintf(filename, "./mpi_swin_writeback_%d.win", rank);
+    
+    CHK(createDefaultInfo(filename, "0", &info));
+    CHK(MPI_Info_set(info, MPI_SWIN_WRITEBACK,           "background"));
+    CHK(MPI_Info_set(info, MPI_SWIN_WRITEBACK_THRESHOLD, "1"));
+    CHK(MPI_Info_set(info, MPI_SWIN_WRITEBACK_INTERVAL,  "1"));
+    CHK(MPI_Win_allocate(size, sizeof(int), info, MPI_COMM_WORLD, (void**)&baseptr, &win));
+    
+    for (int i = 0; i < NUM_ITERATIONS; i++)
+    {
+        fillValues(baseptr, NUM_ELEMS, value + i);
+        usleep(1000);
+    }
+    
+    CHK(MPI_Win_lock(MPI_LOCK_EXCLUSIVE, rank, 0, win));
+    CHK(MPI_Win_sync(win));
+    CHK(MPI_Win_unlock(rank, win));
+    CHK(checkFile(filename, 0, NUM_ELEMS, value + NUM_ITERATIONS - 1));
+    
+    fillValues(baseptr, NUM_ELEMS, value);
+    
+    CHK(MPI_Win_free(&win));
+    CHK(MPI_Info_free(&info));
+    CHK(checkFile(filename, 0, NUM_ELEMS, value));
+    
+    unlink(filename);
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that synchronizes a window with MPIX_Win_isync, which must
+ * flush the window once the request is completed (i.e., the request is
+ * already completed if MPI_THREAD_MULTIPLE is not provided).
+ */
+int testIsync(int rank)
+{
+    const MPI_Aint size       = NUM_ELEMS * sizeof(int);
+    const int      value      = rank * NUM_ELEMS;
+    MPI_Win        win        = MPI_WIN_NULL;
+    MPI_Info       info       = MPI_INFO_NULL;
+    MPI_Request    request    = MPI_REQUEST_NULL;
+    MPI_Count      bytes_last = 0;
+    MPI_Count      bytes      = 0;
+    int            *baseptr   = NULL;
+    char           filename[PATH_MAX];
+    
+    sprintf(filename, "./mpi_swin_isync_%d.win", rank);
+    
+    CHK(createDefaultInfo(filename, "0", &info));
+    CHK(MPI_Win_allocate(size, sizeof(int), info, MPI_COMM_WORLD, (void**)&baseptr, &win));
+    
+    fillValues(baseptr, NUM_ELEMS, value);
+    
+    CHK(MPI_Win_lock(MPI_LOCK_EXCLUSIVE, rank, 0, win));
+    CHK(MPIX_Win_isync(win, &request));
+    CHK(MPI_Wait(&request, MPI_STATUS_IGNORE));
+    CHK(MPI_Win_unlock(rank, win));
+    CHK(MPIX_Win_get_flushed(win, &bytes_last, &bytes));
+    CHKB(bytes_last < size);
+    CHK(checkFile(filename, 0, NUM_ELEMS, value));
+    CHK(MPI_Win_free(&win));
+    CHK(MPI_Info_free(&info));
+    
+    unlink(filename);
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that pages a window with the "uffd" engine, whose budget only
+ * keeps a few clusters in memory (i.e., the clusters are evicted and loaded
+ * again). The engine falls back to "mmap" if the kernel does not support it,
+ * which is reported through the flag (i.e., no page faults were serviced).
+ */
+int testEngine(int rank, int *active)
+{
+    const size_t   page_size = sysconf(_SC_PAGESIZE);
+    const size_t   count     = ENGINE_CLUSTERS * NUM_ELEMS;
+    const int      value     = rank * NUM_ELEMS;
+    MPI_Win        win       = MPI_WIN_NULL;
+    MPI_Info       info      = MPI_INFO_NULL;
+    MPIX_Win_stats stats     = { 0 };
+    int            *baseptr  = NULL;
+    char           filename[PATH_MAX];
+    char           cluster[PATH_MAX];
+    char           budget[PATH_MAX];
+    
+    sprintf(filename, "./mpi_swin_engine_%d.win", rank);
+    sprintf(cluster,  "%zu", page_size);
+    sprintf(budget,   "%zu", ENGINE_CLUSTERS * page_size);
+    
+    CHK(createDefaultInfo(filename, "0", &info));
+    CHK(MPI_Info_set(info, MPI_SWIN_ENGINE,         "uffd"));
+    CHK(MPI_Info_set(info, MPI_SWIN_ENGINE_CLUSTER, cluster));
+    CHK(MPI_Info_set(info, MPI_SWIN_ENGINE_BUDGET,  budget));
+    CHK(MPI_Win_allocate(count * sizeof(int), sizeof(int), info, MPI_COMM_WORLD, (void**)&baseptr, &win));
+    
+    fillValues(baseptr, count, value);
+    
+    CHK(MPI_Win_lock(MPI_LOCK_EXCLUSIVE, rank, 0, win));
+    CHK(MPI_Win_sync(win));
+    CHK(MPI_Win_unlock(rank, win));
+    CHK(checkFile(filename, 0, count, value));
+    CHK(checkValues(baseptr, count, value));
+    CHK(MPIX_Win_get_stats(win, &stats));
+    CHK(MPI_Win_free(&win));
+    
+    // Reattach the file, whose content must be loaded by the engine
+    CHK(MPI_Win_allocate(count * sizeof(int), sizeof(int), info, MPI_COMM_WORLD, (void**)&baseptr, &win));
+    CHK(checkValues(baseptr, count, value));
+    CHK(MPI_Win_free(&win));
+    CHK(MPI_Info_free(&info));
+    
+    *active = (stats.num_faults > 0);
+    
+    unlink(filename);
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that issues local MPI_Put / MPI_Get operations on the storage
+ * allocations attached to a dynamic window, which are transferred directly to
+ * the files through io_uring. The transfers fall back to the original
+ * implementation if the kernel does not support io_uring, which is reported
+ * through the flag (i.e., no bytes were transferred directly).
+ */
+int testUring(int rank, int *active)
+{
+    const MPI_Aint size      = NUM_ELEMS * sizeof(int);
+    const int      value     = rank * NUM_ELEMS;
+    MPI_Win        win       = MPI_WIN_NULL;
+    MPI_Info       info      = MPI_INFO_NULL;
+    MPIX_Win_stats stats     = { 0 };
+    MPI_Aint       disp      = 0;
+    int            *baseptr[NUM_ALLOCS];
+    int            buffer[NUM_ALLOCS][NUM_ELEMS];
+    char           filename[NUM_ALLOCS][PATH_MAX];
+    
+    CHK(MPI_Win_create_dynamic(MPI_INFO_NULL, MPI_COMM_WORLD, &win));
+    
+    for (int i = 0; i < NUM_ALLOCS; i++)
+    {
+        sprintf(filename[i], "./mpi_swin_uring_%d_%d.win", rank, i);
+        
+        CHK(createDefaultInfo(filename[i], "0", &info));
+        CHK(MPI_Info_set(info, MPI_SWIN_URING_THRESHOLD, "1"));
+        CHK(MPI_Alloc_mem(size, info, (void**)&baseptr[i]));
+        CHK(MPI_Win_attach(win, baseptr[i], size));
+        CHK(MPI_Info_free(&info));
+    }
+    
+    CHK(MPI_Win_lock(MPI_LOCK_EXCLUSIVE, rank, 0, win));
+    
+    for (int i = 0; i < NUM_ALLOCS; i++)
+    {
+        fillValues(buffer[i], NUM_ELEMS, value + i);
+        
+        CHK(MPI_Get_address(baseptr[i], &disp));
+        CHK(MPI_Put(buffer[i], NUM_ELEMS, MPI_INT, rank, disp, NUM_ELEMS, MPI_INT, win));
+    }
+    
+    CHK(MPI_Win_sync(win));
+    CHK(MPI_Win_unlock(rank, win));
+    
+    for (int i = 0; i < NUM_ALLOCS; i++)
+    {
+        CHK(checkValues(baseptr[i], NUM_ELEMS, value + i));
+        CHK(checkFile(filename[i], 0, NUM_ELEMS, value + i));
+        
+        fillValues(baseptr[i], NUM_ELEMS, -value - i);
+    }
+    
+    CHK(MPI_Win_lock(MPI_LOCK_EXCLUSIVE, rank, 0, win));
+    CHK(MPI_Win_sync(win));
+    
+    for (int i = 0; i < NUM_ALLOCS; i++)
+    {
+        CHK(MPI_Get_address(baseptr[i], &disp));
+        CHK(MPI_Get(buffer[i], NUM_ELEMS, MPI_INT, rank, disp, NUM_ELEMS, MPI_INT, win));
+    }
+    
+    CHK(MPI_Win_unlock(rank, win));
+    
+    for (int i = 0; i < NUM_ALLOCS; i++)
+    {
+        CHK(checkValues(buffer[i], NUM_ELEMS, -value - i));
+    }
+    
+    CHK(MPIX_Win_get_stats(win, &stats));
+    
+    for (int i = 0; i < NUM_ALLOCS; i++)
+    {
+        CHK(MPI_Win_detach(win, baseptr[i]));
+        CHK(MPI_Free_mem(baseptr[i]));
+        
+        unlink(filename[i]);
+    }
+    
+    CHK(MPI_Win_free(&win));
+    
+    // Note: Every transfer is issued directly if io_uring is supported (i.e.,
+    //       none of them is served by the original implementation)
+    *active = (stats.bytes_direct > 0);
+    CHKB(*active && stats.bytes_direct != 2 * NUM_ALLOCS * size);
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that modifies the last regions of a window with tiering, which
+ * are promoted to memory by MPIX_Win_rebalance while the rest remain in the
+ * file (i.e., the content must not depend on where each region is placed).
+ */
+int testTier(int rank)
+{
+    const size_t   region     = 2 * sysconf(_SC_PAGESIZE);
+    const size_t   count      = TIER_REGIONS * region / sizeof(int);
+    const size_t   count_hot  = TIER_SLOTS * region / sizeof(int);
+    const size_t   count_cold = count - count_hot;
+    const int      value      = rank * NUM_ELEMS;
+    MPI_Win        win        = MPI_WIN_NULL;
+    MPI_Info       info       = MPI_INFO_NULL;
+    int            *baseptr   = NULL;
+    char           filename[PATH_MAX];
+    char           region_s[PATH_MAX];
+    char           budget[PATH_MAX];
+    
+    sprintf(filename, "./mpi_swin_tier_%d.win", rank);
+    sprintf(region_s, "%zu", region);
+    sprintf(budget,   "%zu", TIER_SLOTS * region);
+    
+    CHK(createDefaultInfo(filename, "0", &info));
+    CHK(MPI_Info_set(info, MPI_SWIN_TIER_BUDGET, budget));
+    CHK(MPI_Info_set(info, MPI_SWIN_TIER_REGION, region_s));
+    CHK(MPI_Win_allocate(count * sizeof(int), sizeof(int), info, MPI_COMM_WORLD, (void**)&baseptr, &win));
+    
+    fillValues(baseptr, count, value);
+    
+    for (int i = 0; i < NUM_ITERATIONS; i++)
+    {
+        fillValues(&baseptr[count_cold], count_hot, value + i);
+        
+        CHK(MPI_Win_lock(MPI_LOCK_EXCLUSIVE, rank, 0, win));
+        CHK(MPI_Win_sync(win));
+        CHK(MPI_Win_unlock(rank, win));
+        CHK(MPIX_Win_rebalance(win));
+        CHK(checkValues(&baseptr[count_cold], count_hot, value + i));
+    }
+    
+    CHK(checkValues(baseptr, count_cold, value));
+    CHK(checkFile(filename, 0, count_cold, value));
+    CHK(checkFile(filename, count_cold * sizeof(int), count_hot, value + NUM_ITERATIONS - 1));
+    
+    // Modify the window once more, which must be written back when released
+    fillValues(baseptr, count, value + NUM_ITERATIONS);
+    
+    CHK(MPI_Win_free(&win));
+    CHK(MPI_Info_free(&info));
+    CHK(checkFile(filename, 0, count, value + NUM_ITERATIONS));
+    
+    unlink(filename);
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that allocates a shared window of different size per process
+ * on a single file, whose segments must be accessible by every process and
+ * placed consecutively in rank order (i.e., without padding).
+ */
+int testShared(int rank, int num_procs)
+{
+    const char     *filename = "./mpi_swin_shared.win";
+    const size_t   count     = (rank + 1) * NUM_ELEMS;
+    const int      value     = rank * (rank + 1) / 2 * NUM_ELEMS;
+    MPI_Win        win       = MPI_WIN_NULL;
+    MPI_Info       info      = MPI_INFO_NULL;
+    MPI_Aint       size      = 0;
+    int            disp_unit = 0;
+    int            *baseptr  = NULL;
+    int            *segment  = NULL;
+    
+    CHK(createDefaultInfo(filename, "0", &info));
+    CHK(MPI_Win_allocate_shared(count * sizeof(int), sizeof(int), info, MPI_COMM_WORLD, (void**)&baseptr,
+                                &win));
+    
+    fillValues(baseptr, count, value);
+    
+    CHK(MPI_Win_lock_all(0, win));
+    CHK(MPI_Win_sync(win));
+    CHK(MPI_Barrier(MPI_COMM_WORLD));
+    CHK(MPI_Win_sync(win));
+    
+    // Verify the segments of every process through the shared mapping
+    for (int i = 0; i < num_procs; i++)
+    {
+        CHK(MPI_Win_shared_query(win, i, &size, &disp_unit, (void**)&segment));
+        CHKB(size != (MPI_Aint)((i + 1) * NUM_ELEMS * sizeof(int)) || disp_unit != sizeof(int));
+        CHK(checkValues(segment, (i + 1) * NUM_ELEMS, i * (i + 1) / 2 * NUM_ELEMS));
+    }
+    
+    CHK(MPI_Win_unlock_all(win));
+    CHK(MPI_Win_free(&win));
+    CHK(MPI_Info_free(&info));
+    CHK(MPI_Barrier(MPI_COMM_WORLD));
+    
+    if (rank == 0)
+    {
+        CHK(checkFile(filename, 0, num_procs * (num_procs + 1) / 2 * NUM_ELEMS, 0));
+        
+        unlink(filename);
+    }
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Main method that verifies the content of the windows and of their files
+ * with the features that define how the window is placed in the files (i.e.,
+ * snapshots, headers, "auto" offsets, striping, the block-cyclic layout and
+ * shared windows), and with the ones that define how the window is paged,
+ * tiered, transferred and written back.
+ */
+int main (int argc, char *argv[])
+{
+    int rank      = 0;
+    int num_procs = 0;
+    int provided  = 0;
+    int active    = FALSE;
+    
+    // Initialize MPI and retrieve the rank of the process (the multi-threaded
+    // support allows MPIX_Win_isync to flush the window in the background)
+    CHKPRINT(MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided));
+    CHKPRINT(MPI_Comm_rank(MPI_COMM_WORLD, &rank));
+    CHKPRINT(MPI_Comm_size(MPI_COMM_WORLD, &num_procs));
+    
+    CHKPRINT(testSnapshot(rank));
+    printf("Rank %d restored the snapshot of the window.\n", rank);
+    
+    CHKPRINT(testHeader(rank));
+    printf("Rank %d reattached the window after a clean and a dirty release.\n", rank);
+    
+    CHKPRINT(testAutoOffset(rank));
+    printf("Rank %d verified the file with \"auto\" offsets.\n", rank);
+    
+    CHKPRINT(testStriping(rank));
+    printf("Rank %d verified the striped files.\n", rank);
+    
+    CHKPRINT(testBlockCyclic(rank, num_procs));
+    printf("Rank %d verified the file with the block-cyclic layout.\n", rank);
+    
+    CHKPRINT(testWriteback(rank));
+    printf("Rank %d verified the window with the background write-back.\n", rank);
+    
+    CHKPRINT(testIsync(rank));
+    printf("Rank %d verified the window after MPIX_Win_isync (%s).\n", rank,
+           (provided == MPI_THREAD_MULTIPLE) ? "background" : "blocking");
+    
+    CHKPRINT(testEngine(rank, &active));
+    printf("Rank %d verified the window with the \"uffd\" engine%s.\n", rank,
+           (active) ? "" : " (not supported, paged by \"mmap\")");
+    
+    CHKPRINT(testUring(rank, &active));
+    printf("Rank %d verified the local transfers through io_uring%s.\n", rank,
+           (active) ? "" : " (not supported, transferred by MPI)");
+    
+    CHKPRINT(testTier(rank));
+    printf("Rank %d verified the window with tiering.\n", rank);
+    
+    CHKPRINT(testShared(rank, num_procs));
+    printf("Rank %d verified the segments of the shared window.\n", rank);
+    
+    CHKPRINT(MPI_Finalize());
+    
+    return MPI_SUCCESS;
+}
+
@@ -0,0 +1,170 @@
+
+#include "common.h"
+#include <pthread.h>
+#include "mpi_swin_keys.h"
+
+#define NUM_THREADS    8
+#define NUM_ITERATIONS 32
+#define NUM_ELEMS      4096
+
+/**
+ * Structure that contains the settings and the result of each thread.
+ */
+typedef struct
+{
+    int      rank;          // Rank of the process
+    int      thread_id;     // Identifier of the thread inside the process
+    MPI_Comm comm;          // Communicator used by the thread (i.e., duplicated)
+    int      error;         // Result of the stress test for the thread
+} ThreadArgs;
+
+/**
+ * Helper method that allows to create a default MPI_Info object that sets the
+ * allocation of the window to the storage device, using a different file for
+ * each thread.
+ */
+int createDefaultInfo(int rank, int thread_id, MPI_Info* info)
+{
+    char filename[PATH_MAX];
+    
+    // Define the path according to the rank of the process and the thread
+    sprintf(filename, "./mpi_swin_mt_%d_%d.win", rank, thread_id);
+    
+    CHK(MPI_Info_create(info));
+    CHK(MPI_Info_set(*info, MPI_SWIN_ALLOC_TYPE, "storage"));
+    CHK(MPI_Info_set(*info, MPI_SWIN_FILENAME,   filename));
+    CHK(MPI_Info_set(*info, MPI_SWIN_OFFSET,     "0"));
+    CHK(MPI_Info_set(*info, MPI_SWIN_UNLINK,     "true"));
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that fills the given buffer, flushes the window to storage
+ * and verifies that the content remains the same.
+ */
+int fillAndSync(MPI_Win win, int rank, int *baseptr, int value)
+{
+    for (int i = 0; i < NUM_ELEMS; i++)
+    {
+        baseptr[i] = value + i;
+    }
+    
+    CHK(MPI_Win_lock(MPI_LOCK_EXCLUSIVE, rank, 0, win));
+    CHK(MPI_Win_sync(win));
+    CHK(MPI_Win_unlock(rank, win));
+    
+    for (int i = 0; i < NUM_ELEMS; i++)
+    {
+        CHKB(baseptr[i] != value + i);
+    }
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that repeatedly allocates, attaches, synchronizes and releases
+ * storage allocations, both with dynamic windows and MPI_Win_allocate.
+ */
+int launchStressTest(ThreadArgs *args)
+{
+    const MPI_Aint size     = NUM_ELEMS * sizeof(int);
+    MPI_Win        win      = MPI_WIN_NULL;
+    MPI_Win        win_dyn  = MPI_WIN_NULL;
+    MPI_Info       info     = MPI_INFO_NULL;
+    int            *baseptr = NULL;
+    
+    CHK(createDefaultInfo(args->rank, args->thread_id, &info));
+    CHK(MPI_Win_create_dynamic(MPI_INFO_NULL, args->comm, &win_dyn));
+    
+    for (int iteration = 0; iteration < NUM_ITERATIONS; iteration++)
+    {
+        const int value = (args->rank * NUM_THREADS + args->thread_id) * NUM_ITERATIONS + iteration;
+        
+        // Allocate the memory and attach it to the dynamic window
+        CHK(MPI_Alloc_mem(size, info, (void**)&baseptr));
+        CHK(MPI_Win_attach(win_dyn, baseptr, size));
+        CHK(fillAndSync(win_dyn, args->rank, baseptr, value));
+        CHK(MPI_Win_detach(win_dyn, baseptr));
+        CHK(MPI_Free_mem(baseptr));
+        
+        // Allocate a window on the communicator of the thread
+        CHK(MPI_Win_allocate(size, sizeof(int), info, args->comm, (void**)&baseptr, &win));
+        CHK(fillAndSync(win, args->rank, baseptr, value));
+        CHK(MPI_Win_free(&win));
+    }
+    
+    CHK(MPI_Win_free(&win_dyn));
+    CHK(MPI_Info_free(&info));
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Main method of each thread, which launches the stress test.
+ */
+void *threadMain(void *arg)
+{
+    ThreadArgs *args = (ThreadArgs *)arg;
+    
+    args->error = launchStressTest(args);
+    
+    return NULL;
+}
+
+/**
+ * Main method that launches several threads per process, which allocate,
+ * attach, synchronize and release MPI storage windows at the same time. Each
+ * thread uses a duplicated communicator to perform the collective operations.
+ */
+int main (int argc, char *argv[])
+{
+    pthread_t  threads[NUM_THREADS];
+    ThreadArgs args[NUM_THREADS];
+    int        rank     = 0;
+    int        provided = 0;
+    int        errors   = 0;
+    
+    // Initialize MPI with support for multiple threads
+    CHKPRINT(MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided));
+    CHKPRINT(MPI_Comm_rank(MPI_COMM_WORLD, &rank));
+    
+    if (provided < MPI_THREAD_MULTIPLE)
+    {
+        printf("Rank %d skipping the test (MPI_THREAD_MULTIPLE not provided).\n", rank);
+        
+        CHKPRINT(MPI_Finalize());
+        
+        return MPI_SUCCESS;
+    }
+    
+    // Duplicate the communicator for each thread and launch the threads
+    for (int i = 0; i < NUM_THREADS; i++)
+    {
+        args[i].rank      = rank;
+        args[i].thread_id = i;
+        args[i].error     = MPI_SUCCESS;
+        
+        CHKPRINT(MPI_Comm_dup(MPI_COMM_WORLD, &args[i].comm));
+    }
+    
+    for (int i = 0; i < NUM_THREADS; i++)
+    {
+        CHKPRINT(pthread_create(&threads[i], NULL, threadMain, &args[i]));
+    }
+    
+    for (int i = 0; i < NUM_THREADS; i++)
+    {
+        CHKPRINT(pthread_join(threads[i], NULL));
+        CHKPRINT(MPI_Comm_free(&args[i].comm));
+        
+        errors += (args[i].error != MPI_SUCCESS);
+    }
+    
+    printf("Rank %d completed the stress test with %d threads (errors=%d).\n", rank, NUM_THREADS, errors);
+    
+    CHKPRINT(MPI_Finalize());
+    
+    return (errors == 0) ? MPI_SUCCESS : ERROR;
+}
+
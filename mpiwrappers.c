@@ -1,11 +1,18 @@
 
 #include "common.h"
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/resource.h>
 #include "mfile.h"
+#include "mfile_writeback.h"
+#include "mfile_uffd.h"
+#include "mfile_flush.h"
+#include "mfile_uring.h"
+#include "mfile_tier.h"
+#include "mfile_trace.h"
 #include "mpiwrappers_util.h"
 #include "mpiwrappers.h"
-//#ifdef MPI_SWIN_LUSTRE
-//#include <lustre/lustreapi.h>
-//#endif
+#include "mpi_swin_ext.h"
 
 ///////////////////////////////////
 // PRIVATE DEFINITIONS & METHODS //
@@ -13,8 +20,40 @@
 
 typedef struct sysinfo sysinfo_t;
 
-#define CONV_MB(length)  (length >> 20)
-#define MEM_LIMIT_FACTOR 0.921
+/**
+ * Structure that represents an ongoing non-blocking synchronization of a
+ * window, which is completed by the flushing threads of the allocations.
+ */
+typedef struct
+{
+    MPI_Request request;    // Generalized request returned to the user
+    int         error;      // Error found while flushing the allocations
+} MPI_Win_Isync;
+
+/**
+ * Structure that identifies the file requested by a process, which is only
+ * shared with the processes of the same node on local file systems.
+ */
+typedef struct
+{
+    int  node;                          // First process of the node (ERROR if the file system is shared)
+    char filename[MPI_MAX_INFO_VAL];    // Requested filename for the mapped file
+} MPI_Win_File_Key;
+
+#define MEM_LIMIT_FACTOR     0.921                     // Fraction of the memory that can be used (i.e., page cache headroom)
+#define MEMINFO_PATH         "/proc/meminfo"
+#define MEMINFO_TOTAL        "MemTotal: %zu kB"
+#define MEMINFO_AVAILABLE    "MemAvailable: %zu kB"
+#define CGROUP_PROC_PATH     "/proc/self/cgroup"
+#define CGROUP_V1_PATH       "/sys/fs/cgroup/memory"
+#define CGROUP_V2_PATH       "/sys/fs/cgroup"
+#define STATS_ENV            "MPI_SWIN_STATS"          // Prints the counters of the process during MPI_Finalize
+#define CONV_SEC             1e-9
+#define ALLOC_SHARED_FILE    0x1                       // Some process requested a file that could be shared
+#define ALLOC_HEADER         0x2                       // Some process requested a header for its file
+
+size_t g_uring_threshold = SIZE_MAX;              // Smallest threshold requested for io_uring (i.e., fast check)
+int    g_shared_flavor   = MPI_WIN_FLAVOR_SHARED; // Flavor reported for the shared windows in storage
 
 /**
  * Helper method that allows to release a window allocation based on storage
@@ -22,6 +61,9 @@ typedef struct sysinfo sysinfo_t;
  */
 int releaseWinAlloc(MPI_Win_Alloc *win_alloc)
 {
+    const size_t start  = mftime();
+    size_t       length = 0;
+    
     // Check the type of window allocation before releasing any data
     if (win_alloc->alloc_type == MPI_WIN_ALLOC_STORAGE)
     {
@@ -29,7 +71,12 @@ int releaseWinAlloc(MPI_Win_Alloc *win_alloc)
         
         DBGPRINTF("Storage mapping release with filename=\"%s\" offset=%zu length=%zu", mfile->filename, mfile->offset, mfile->length);
         
+        length = mfile->length;
+        
+        CHK(mfwriteback_unregister(*mfile));
+        CHK(mfuring_wait(*mfile));
         CHK(mfsync(*mfile));
+        CHK(mfheader_close(*mfile));
         CHK(mffree(*mfile));
         
         free(mfile);
@@ -41,8 +88,11 @@ int releaseWinAlloc(MPI_Win_Alloc *win_alloc)
         CHK(PMPI_Free_mem(win_alloc->data));
     }
     
+    free(win_alloc->segments);
     free(win_alloc);
     
+    mftrace(MFTRACE_FREE, start, length);
+    
     return MPI_SUCCESS;
 }
 
@@ -60,24 +110,31 @@ int MPI_Win_copy_attr(MPI_Win oldwin, int win_keyval, void *extra_state, void *a
  */
 int MPI_Win_release_attr(MPI_Win win, int win_keyval, void *attribute_val, void *extra_state)
 {
-    MPI_Win_Alloc *win_alloc = (MPI_Win_Alloc *)attribute_val;
+    MPI_Win_Alloc_List *list = (MPI_Win_Alloc_List *)attribute_val;
     
-    DBGPRINT("Release attribute callback function called");
+    DBGPRINTF("Release attribute callback function called (count=%d)", list->count);
     
-    if (win_alloc->alloc_release)
+    while (list->head != NULL)
     {
-        DBGPRINT("Releasing the allocation attached to the window");
+        MPI_Win_Alloc *win_alloc = list->head;
         
-        CHK(releaseWinAlloc(win_alloc));
-    }
-    else
-    {
-        DBGPRINT("Adding the allocation to the cache (owned by the user)");
+        unlinkWinAlloc(win_alloc);
         
-        CHK(addWinAlloc(win_alloc));
+        if (win_alloc->alloc_release)
+        {
+            DBGPRINT("Releasing the allocation attached to the window");
+            
+            CHK(removeWinAlloc(win_alloc));
+            CHK(releaseWinAlloc(win_alloc));
+        }
+        else
+        {
+            DBGPRINT("Keeping the allocation in the cache (owned by the user)");
+        }
     }
     
-    CHK(removeWinKeyval(win_keyval));
+    free(list->ranges);
+    free(list);
     
     return MPI_SUCCESS;
 }
@@ -89,20 +146,16 @@ int MPI_Win_release_attr(MPI_Win win, int win_keyval, void *attribute_val, void
 int cacheWinAlloc(MPI_Win win, void* base)
 {
     MPI_Win_Alloc *win_alloc = NULL;
-    int           win_keyval = 0;
     
-    if (getWinAllocFromPtr(base, TRUE, &win_alloc) == MPI_SUCCESS)
+    CHK(initWinKeyval(MPI_Win_copy_attr, MPI_Win_release_attr));
+    
+    // Associate the allocation data to the list of allocations of the window, which
+    // will allow to release the mapped-memory afterwards (if needed)
+    if (attachWinAlloc(win, base, &win_alloc) == MPI_SUCCESS)
     {
         DBGPRINT("Base pointer allocated internally with MPI_Alloc_mem (caching allocation in window)");
         
-        // Associate the allocation data to the window object as an attribute, which
-        // will allow to release the mapped-memory afterwards (if needed)
-        CHK(MPI_Win_create_keyval(MPI_Win_copy_attr, MPI_Win_release_attr, &win_keyval, NULL));
-        CHK(MPI_Win_set_attr(win, win_keyval, (void*)win_alloc));
-        
-        DBGPRINTF("Window attribute set with type=%s", ((win_alloc->alloc_type == MPI_WIN_ALLOC_MEM) ? "MEM" : "STORAGE"));
-        
-        CHK(addWinKeyval(win_keyval));
+        DBGPRINTF("Window allocation attached with type=%s", ((win_alloc->alloc_type == MPI_WIN_ALLOC_MEM) ? "MEM" : "STORAGE"));
     }
     
     return MPI_SUCCESS;
@@ -114,250 +167,1692 @@ int cacheWinAlloc(MPI_Win win, void* base)
  */
 int uncacheWinAlloc(MPI_Win win, const void* base)
 {
-    int win_keyval = 0;
+    MPI_Win_Alloc *win_alloc = NULL;
     
-    if (getWinKeyvalFromWinPtr(win, (void*)base, &win_keyval) == MPI_SUCCESS)
+    if (detachWinAlloc(win, base, &win_alloc) == MPI_SUCCESS)
     {
-        DBGPRINT("Base pointer found internally within the window (uncaching allocation in window)");
-        
-        // Disassociate the allocation data to the window object as an attribute (note
-        // that the callback will be triggered, which will cache the alloc)
-        CHK(MPI_Win_delete_attr(win, win_keyval));
-        
-        DBGPRINT("Window attribute unset from the window");
+        DBGPRINT("Base pointer found internally within the window (allocation detached from the window)");
     }
     
     return MPI_SUCCESS;
 }
 
-double calculateFactor(MPI_Aint size)
+/**
+ * Callback function used to fill the status of a non-blocking synchronization.
+ */
+int isyncQuery(void *extra_state, MPI_Status *status)
 {
-    sysinfo_t sinfo     = { 0 };
-    size_t    mem_req   = CONV_MB(size);
-    size_t    mem_total = 0;
-    size_t    mem_limit = 0;
-    size_t    mem_used  = 0;
-    size_t    mem_check = 0;
+    MPI_Win_Isync *isync = (MPI_Win_Isync *)extra_state;
     
-    sysinfo(&sinfo);
-    mem_total = CONV_MB(sinfo.totalram * sinfo.mem_unit);
-    mem_limit = (double)mem_total * MEM_LIMIT_FACTOR;
-    mem_used  = CONV_MB((sinfo.totalram - sinfo.freeram) * sinfo.mem_unit);
-    mem_check = (mem_used + mem_req);
+    MPI_Status_set_elements(status, MPI_BYTE, 0);
+    MPI_Status_set_cancelled(status, FALSE);
+    status->MPI_SOURCE = MPI_UNDEFINED;
+    status->MPI_TAG    = MPI_UNDEFINED;
+    status->MPI_ERROR  = isync->error;
     
-    return (mem_used  > mem_limit) ? 1.0 :
-           (mem_check < mem_limit) ? 0.0 :
-                                     ((double)(mem_check - mem_limit) / (double)mem_req);
+    return isync->error;
 }
 
+/**
+ * Callback function used to release a non-blocking synchronization.
+ */
+int isyncFree(void *extra_state)
+{
+    free(extra_state);
+    
+    return MPI_SUCCESS;
+}
 
-//////////////////////////////////
-// PUBLIC DEFINITIONS & METHODS //
-//////////////////////////////////
-
-int MPI_Alloc_mem(MPI_Aint size, MPI_Info info, void *baseptr)
+/**
+ * Callback function used to cancel a non-blocking synchronization. Note that
+ * the flush cannot be cancelled once it has started.
+ */
+int isyncCancel(void *extra_state, int complete)
 {
-    MPI_Win_Alloc   *win_alloc  = NULL;
-    MPI_Info_Values info_values = { 0 };
+    (void)extra_state;
+    (void)complete;
     
-    DBGPRINT("MPI allocation wrapper called");
+    return MPI_SUCCESS;
+}
+
+/**
+ * Callback function that completes a non-blocking synchronization once every
+ * allocation is flushed.
+ */
+void isyncDone(void *arg, int hr)
+{
+    MPI_Win_Isync *isync = (MPI_Win_Isync *)arg;
     
-    win_alloc = (MPI_Win_Alloc *)calloc(1, sizeof(MPI_Win_Alloc));
+    isync->error = (hr != MPI_SUCCESS) ? MPI_ERR_IO : MPI_SUCCESS;
     
-    // Parse the MPI_Info object to determine if the allocation has to be based
-    // in traditional RAM memory or storage
-    parseInfo(info, &info_values);
+    // Important: The request might be released as soon as it is completed, and
+    // thus the object must not be accessed afterwards
+    MPI_Grequest_complete(isync->request);
+}
+
+/**
+ * Helper method that determines if a given number of elements of a datatype
+ * are contiguous in memory, retrieving their size in bytes.
+ */
+int isContiguous(int count, MPI_Datatype datatype, size_t *bytes)
+{
+    MPI_Aint lb          = 0;
+    MPI_Aint extent      = 0;
+    MPI_Aint true_lb     = 0;
+    MPI_Aint true_extent = 0;
+    int      size        = 0;
     
-    // Check if we have to calculate the factor (i.e., it was set to "auto")
-    if (info_values.factor < 0.0f)
-    {
-        info_values.factor = calculateFactor(size);
-    }
-     
-    // Make sure that the allocation type and factor are correctly set
-    if (info_values.alloc_type == MPI_WIN_ALLOC_STORAGE && info_values.factor > 0.0f)
-    {
-        MFILE *mfile = NULL;
-        
-        DBGPRINTF("Storage allocation requested with filename=\"%s\" (offset=%zu unlink=%d)", info_values.filename,
-                                                                                              info_values.offset,
-                                                                                              info_values.unlink);
-        
-#ifdef MPI_SWIN_LUSTRE
-        // Set the striping values for the file if it does not exist
-        if (access(info_values.filename, F_OK) == ERROR && (info_values.striping_factor != 0 ||
-                                                            info_values.striping_unit   != 0))
-        {
-            // Note: The Lustre support using the low-level API has been temporary removed after finding
-            //       some compilation issues on a Cray XC40 machine. We will investigate the reasons and
-            //       enable the support when a generic solution is available (e.g., using ioctl).
-            //
-            // int fd = llapi_file_open(info_values.filename, info_values.file_flags, info_values.file_perm,
-            //                          info_values.striping_unit, -1, info_values.striping_factor, 0);
-            // CHKB(fd == ERROR);
-            // CHK(close(fd));
-            
-            char lfs_command[PATH_MAX];
-            
-            sprintf(lfs_command, "lfs setstripe --stripe-count=%d --stripe-size=%ld %s", info_values.striping_factor,
-                                                                                         info_values.striping_unit,
-                                                                                         info_values.filename);
-            
-            CHK(system(lfs_command));
-        }
-#endif
-        
-        // Create the mapping of the given file into memory
-        mfile = (MFILE *)malloc(sizeof(MFILE));
-        CHK(mfalloc(info_values.filename, info_values.offset, size,
-                    info_values.factor, info_values.order, info_values.unlink,
-                    info_values.access_style, info_values.file_flags,
-                    info_values.file_perm, mfile));
-        
-        // Fill the window allocation object with the mapping details (note that
-        // the address returned matches the original request and is not aligned)
-        win_alloc->alloc_type = MPI_WIN_ALLOC_STORAGE;
-        win_alloc->data       = mfile;
-        *((void**)baseptr)    = mfile->addr_src;
-        
-        DBGPRINTF("Allocation in storage successful with length=%lu", mfile->length);
-    }
-    else
+    if (MPI_Type_size(datatype, &size) != MPI_SUCCESS ||
+        MPI_Type_get_extent(datatype, &lb, &extent) != MPI_SUCCESS ||
+        MPI_Type_get_true_extent(datatype, &true_lb, &true_extent) != MPI_SUCCESS)
     {
-        DBGPRINT("Memory allocation requested (replicating the default behaviour)");
-        
-        // Allocate the requested size using MPI functionality
-        CHK(PMPI_Alloc_mem(size, info, (void*)&win_alloc->data));
-        
-        // Fill the window allocation object with the allocation details
-        win_alloc->alloc_type = MPI_WIN_ALLOC_MEM;
-        *((void**)baseptr)    = win_alloc->data;
-        
-        DBGPRINTF("Allocation in memory successful with length=%ld", size);
+        return FALSE;
     }
     
-    // Disable the release flag to avoid issues if the user is allocating this memory
-    // from outside (i.e., it will not be released during window deallocation)
-    win_alloc->alloc_release = FALSE;
+    *bytes = (size_t)count * size;
     
-    return addWinAlloc(win_alloc);
+    return (lb == 0 && true_lb == 0 && extent == size && true_extent == size);
 }
 
-int MPI_Free_mem(void *base)
+/**
+ * Helper method that issues a transfer between the origin buffer and the
+ * window directly to the mapped file (i.e., through io_uring), if the target
+ * is the calling process and the transfer is large and contiguous. Otherwise,
+ * an error is returned and the original implementation has to be used.
+ */
+int issueLocalTransfer(void *origin_addr, int origin_count, MPI_Datatype origin_datatype,
+                       int target_rank, MPI_Aint target_disp, int target_count,
+                       MPI_Datatype target_datatype, MPI_Win win, int write)
 {
-    MPI_Win_Alloc *win_alloc = NULL;
+    MPI_Win_Alloc *win_alloc    = NULL;
+    MPI_Group     group         = MPI_GROUP_NULL;
+    MFILE         *mfile        = NULL;
+    char          *addr         = NULL;
+    void          *base         = NULL;
+    int           *flavor       = NULL;
+    int           *disp_unit    = NULL;
+    size_t        origin_bytes  = 0;
+    size_t        target_bytes  = 0;
+    int           rank          = 0;
+    int           flag[3]       = { 0 };
     
-    DBGPRINT("MPI allocation release wrapper called");
+    // Note: No allocation requested io_uring (i.e., avoids the datatype queries)
+    if (__atomic_load_n(&g_uring_threshold, __ATOMIC_RELAXED) == SIZE_MAX)
+    {
+        return ERROR;
+    }
     
-    if (getWinAllocFromPtr(base, TRUE, &win_alloc) == MPI_SUCCESS)
+    // Discard the small and non-contiguous transfers first, as these checks
+    // are cheaper than retrieving the attributes of the window
+    if (!isContiguous(origin_count, origin_datatype, &origin_bytes) || origin_bytes < g_uring_threshold ||
+        !isContiguous(target_count, target_datatype, &target_bytes) || origin_bytes != target_bytes)
     {
-        return releaseWinAlloc(win_alloc);
+        return ERROR;
     }
     
-    DBGPRINT("MPI allocation unknown");
+    CHK(MPI_Win_get_group(win, &group));
+    CHK(MPI_Group_rank(group, &rank));
+    CHK(MPI_Group_free(&group));
+    CHKB(rank != target_rank);
     
-    return MPI_ERR_BASE;
+    CHK(MPI_Win_get_attr(win, MPI_WIN_CREATE_FLAVOR, &flavor,    &flag[0]));
+    CHK(MPI_Win_get_attr(win, MPI_WIN_BASE,          &base,      &flag[1]));
+    CHK(MPI_Win_get_attr(win, MPI_WIN_DISP_UNIT,     &disp_unit, &flag[2]));
+    CHKB(!flag[0] || !flag[1] || !flag[2]);
+    
+    // Note: The displacement is an absolute address in dynamic windows
+    addr = (*flavor == MPI_WIN_FLAVOR_DYNAMIC) ? (char *)target_disp :
+                                                 (char *)base + target_disp * (*disp_unit);
+    
+    CHK(getWinAllocFromAddr(win, addr, target_bytes, &win_alloc));
+    
+    mfile = (MFILE *)win_alloc->data;
+    CHKB(mfile->direct == NULL || target_bytes < mfile->io_threshold);
+    
+    DBGPRINTF("Local transfer issued through io_uring (write=%d length=%zu)", write, target_bytes);
+    
+    return mfuring_submit(*mfile, addr - (char *)mfile->addr, origin_addr, target_bytes, write);
 }
 
-int MPI_Win_create(void *base, MPI_Aint size, int disp_unit, MPI_Info info, 
-                   MPI_Comm comm, MPI_Win *win)
+/**
+ * Helper method that waits for the local transfers issued directly to the
+ * files of the storage allocations of a window (i.e., through io_uring).
+ */
+int waitLocalTransfers(MPI_Win win)
 {
-    DBGPRINT("Window creation wrapper called");
+    MPI_Win_Alloc **win_allocs = NULL;
+    int           count        = 0;
+    int           error        = MPI_SUCCESS;
     
-    CHK(PMPI_Win_create(base, size, disp_unit, info, comm, win));
+    // Note: No allocation requested io_uring (i.e., avoids the window lookup)
+    if (__atomic_load_n(&g_uring_threshold, __ATOMIC_RELAXED) == SIZE_MAX ||
+        getAllWinAllocFromWin(win, &win_allocs, &count) != MPI_SUCCESS)
+    {
+        return MPI_SUCCESS;
+    }
     
-    return cacheWinAlloc(*win, base);
+    for (int walloc = 0; walloc < count; walloc++)
+    {
+        if (win_allocs[walloc]->alloc_type == MPI_WIN_ALLOC_STORAGE)
+        {
+            const int hr_wait = mfuring_wait(*((MFILE *)win_allocs[walloc]->data));
+            
+            error = (error == MPI_SUCCESS) ? hr_wait : error;
+        }
+    }
+    
+    free(win_allocs);
+    
+    return error;
 }
 
-int MPI_Win_allocate(MPI_Aint size, int disp_unit, MPI_Info info, 
-                     MPI_Comm comm, void *baseptr, MPI_Win *win)
+/**
+ * Helper method that reads the first value of a file that matches the given
+ * format (e.g., a line of /proc/meminfo), or SIZE_MAX if not found.
+ */
+size_t readValue(const char *path, const char *format)
 {
-    MPI_Win_Alloc *win_alloc = NULL;
-    
-    DBGPRINT("Window allocation wrapper called");
-    
-    CHK(MPI_Alloc_mem(size, info, baseptr));
-    CHK(MPI_Win_create(*((void**)baseptr), size, disp_unit, info, comm, win));
+    char   line[PATH_MAX];
+    size_t value = SIZE_MAX;
+    FILE   *file = fopen(path, "r");
     
-    // Enable the release flag to guarantee that the memory is released afterwards during
-    // window deallocation (i.e., by default, the user has to manually release it)
-    CHK(getWinAllocFromWin(*win, FALSE, &win_alloc));
-    win_alloc->alloc_release = TRUE;
+    while (file != NULL && fgets(line, sizeof(line), file) != NULL)
+    {
+        if (sscanf(line, format, &value) == 1)
+        {
+            break;
+        }
+    }
     
-    DBGPRINTF("Window allocated succesfully with type=%s", ((win_alloc->alloc_type == MPI_WIN_ALLOC_MEM) ? "MEM" : "STORAGE"));
+    if (file != NULL)
+    {
+        fclose(file);
+    }
     
-    return MPI_SUCCESS;
+    return value;
 }
 
-int MPI_Win_sync(MPI_Win win)
+/**
+ * Helper method that retrieves the memory limit of the cgroup of the process
+ * and the memory still available, which are the smallest among the cgroup and
+ * its ancestors (SIZE_MAX if there is no limit). Both cgroup v1 (i.e., memory
+ * controller) and v2 are supported, and the inactive page cache is considered
+ * available, as the kernel reclaims it before reaching the limit.
+ */
+void getCgroupMemory(size_t *limit, size_t *available)
 {
-    MPI_Win_Alloc **win_allocs = NULL;
-    int           count        = 0;
-    
-    DBGPRINT("Window flushing wrapper called");
+    char       line[PATH_MAX];
+    char       path[PATH_MAX] = { 0 };
+    char       filename[PATH_MAX + NAME_MAX + 1];
+    const char *base          = NULL;
+    int        v1             = FALSE;
+    FILE       *file          = fopen(CGROUP_PROC_PATH, "r");
     
-    CHK(PMPI_Win_sync(win));
+    *limit     = SIZE_MAX;
+    *available = SIZE_MAX;
     
-    if ((getAllWinAllocFromWin(win, &win_allocs, &count) == MPI_SUCCESS))
+    // Find the cgroup of the memory controller, or the unified hierarchy if
+    // the controller is not mounted separately (e.g., "0::/user.slice")
+    while (file != NULL && fgets(line, sizeof(line), file) != NULL)
     {
-        int count_storage = 0;
-        int count_mem     = 0;
+        char *controllers = strchr(line, ':');
+        char *cgroup      = (controllers != NULL) ? strchr(controllers + 1, ':') : NULL;
         
-        DBGPRINTF("Window allocations cached in the window (count=%d)", count);
+        if (cgroup == NULL)
+        {
+            continue;
+        }
         
-        for (int walloc = 0; !(count_storage && count_mem) && walloc < count; walloc++)
+        *(cgroup++) = '\0';
+        cgroup[strcspn(cgroup, "\n")] = '\0';
+        
+        if (strstr(controllers + 1, "memory") != NULL)
         {
-            if (win_allocs[walloc]->alloc_type == MPI_WIN_ALLOC_STORAGE)
-            {
-                CHK(mfsync(*((MFILE *)win_allocs[walloc]->data)));
-                
-                count_storage++;
-            }
-            else
-            {
-                count_mem++;
-            }
+            base = CGROUP_V1_PATH;
+            v1   = TRUE;
+            snprintf(path, sizeof(path), "%s%s", base, cgroup);
+            break;
+        }
+        else if (controllers[1] == '\0' && line[0] == '0')
+        {
+            base = CGROUP_V2_PATH;
+            snprintf(path, sizeof(path), "%s%s", base, cgroup);
         }
+    }
+    
+    if (file != NULL)
+    {
+        fclose(file);
+    }
+    
+    // Walk the hierarchy up to the root, as the limits of the ancestors also
+    // apply to the cgroup of the process (e.g., the job allocation in Slurm)
+    while (base != NULL && strlen(path) >= strlen(base))
+    {
+        char   *separator = strrchr(path, '/');
+        size_t max        = 0;
+        size_t current    = 0;
+        size_t inactive   = 0;
         
-        DBGPRINTF("Finished flushing / checking the allocation types (count_storage=%d / count_mem=%d)", count_storage, count_mem);
+        snprintf(filename, sizeof(filename), "%s/%s", path, (v1) ? "memory.limit_in_bytes" : "memory.max");
+        max = readValue(filename, "%zu");
         
-        free(win_allocs);
+        snprintf(filename, sizeof(filename), "%s/%s", path, (v1) ? "memory.usage_in_bytes" : "memory.current");
+        current = readValue(filename, "%zu");
         
-        // If we detect allocations in both memory and storage combined, the result
-        // of the operation is unknown and we should return an error
-        if (count_storage && count_mem)
+        snprintf(filename, sizeof(filename), "%s/memory.stat", path);
+        inactive = readValue(filename, (v1) ? "total_inactive_file %zu" : "inactive_file %zu");
+        
+        // Note: The root cgroup does not define a limit (i.e., "max" in v2)
+        if (max != SIZE_MAX && current != SIZE_MAX)
+        {
+            const size_t used     = current - ((inactive != SIZE_MAX && inactive < current) ? inactive : 0);
+            const size_t free_mem = (max > used) ? (max - used) : 0;
+            
+            *limit     = (max < *limit)          ? max      : *limit;
+            *available = (free_mem < *available) ? free_mem : *available;
+        }
+        
+        if (separator == NULL || (size_t)(separator - path) < strlen(base))
         {
-            return MPI_ERR_INTERN;
+            break;
         }
+        
+        *separator = '\0';
+    }
+}
+
+/**
+ * Helper method that estimates the memory that the process can still use for
+ * the memory part of the allocations, based on the memory available in the
+ * node and in its cgroup. A fraction of the memory is kept as headroom for the
+ * page cache, which buffers the storage part of the allocations.
+ */
+size_t getMemoryBudget()
+{
+    size_t total        = readValue(MEMINFO_PATH, MEMINFO_TOTAL);
+    size_t available    = readValue(MEMINFO_PATH, MEMINFO_AVAILABLE);
+    size_t cg_limit     = 0;
+    size_t cg_available = 0;
+    size_t headroom     = 0;
+    
+    // Older kernels do not report the available memory (i.e., before 3.14)
+    if (total == SIZE_MAX || available == SIZE_MAX)
+    {
+        sysinfo_t sinfo = { 0 };
+        
+        sysinfo(&sinfo);
+        total     = sinfo.totalram * sinfo.mem_unit;
+        available = (sinfo.freeram + sinfo.bufferram) * sinfo.mem_unit;
+    }
+    else
+    {
+        total     <<= 10;
+        available <<= 10;
     }
     
-    return MPI_SUCCESS;
+    getCgroupMemory(&cg_limit, &cg_available);
+    
+    total     = (cg_limit < total)         ? cg_limit     : total;
+    available = (cg_available < available) ? cg_available : available;
+    headroom  = (double)total * (1.0 - MEM_LIMIT_FACTOR);
+    
+    DBGPRINTF("Memory budget estimated with total=%zu available=%zu (cg_limit=%zu)", total, available, cg_limit);
+    
+    return (available > headroom) ? (available - headroom) : 0;
 }
 
-int MPI_Win_attach(MPI_Win win, void *base, MPI_Aint size)
+/**
+ * Helper method that calculates the allocation factor, so that the memory part
+ * of the allocation fits in the memory budget. If a communicator is given, the
+ * processes that share the node agree on a single budget (i.e., the smallest
+ * estimation), which is divided in proportion to the size requested by each.
+ */
+int calculateFactor(MPI_Aint size, MPI_Comm comm, double *factor)
 {
-    DBGPRINT("Window attach wrapper called");
+    uint64_t budget = getMemoryBudget();
+    uint64_t length = size;
     
-    CHK(cacheWinAlloc(win, base));
+    if (comm != MPI_COMM_NULL)
+    {
+        MPI_Comm node_comm = MPI_COMM_NULL;
+        
+        CHK(MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm));
+        CHK(MPI_Allreduce(MPI_IN_PLACE, &budget, 1, MPI_UINT64_T, MPI_MIN, node_comm));
+        CHK(MPI_Allreduce(MPI_IN_PLACE, &length, 1, MPI_UINT64_T, MPI_SUM, node_comm));
+        CHK(MPI_Comm_free(&node_comm));
+    }
     
-    return PMPI_Win_attach(win, base, size);
+    DBGPRINTF("Allocation factor calculated with budget=%lu length=%lu", (unsigned long)budget,
+                                                                        (unsigned long)length);
+    
+    *factor = (length <= budget) ? 0.0 : (1.0 - (double)budget / (double)length);
+    
+    return MPI_SUCCESS;
 }
 
-int MPI_Win_detach(MPI_Win win, const void *base)
+
+/**
+ * Helper method that sets the striping values for the file of a storage
+ * allocation, if requested and the file does not exist yet.
+ */
+int setStriping(MPI_Info_Values *info_values)
 {
-    DBGPRINT("Window detach wrapper called");
+    MFILE_Layout layout = { info_values->striping_factor, info_values->striping_unit };
     
-    CHK(uncacheWinAlloc(win, base));
+    return mflayout(info_values->filename, info_values->file_perm, layout);
+}
+
+/**
+ * Helper method that retrieves a hash of the given file key (i.e., FNV-1a),
+ * which is used to group the processes that share the same file.
+ */
+int getFileKeyHash(const MPI_Win_File_Key *key)
+{
+    const uint8_t *node = (const uint8_t *)&key->node;
+    uint32_t      hash  = 2166136261U;
     
-    return PMPI_Win_detach(win, base);
+    for (size_t i = 0; i < sizeof(key->node); i++)
+    {
+        hash = (hash ^ node[i]) * 16777619U;
+    }
+    
+    for (const char *c = key->filename; *c != '\0'; c++)
+    {
+        hash = (hash ^ (uint8_t)*c) * 16777619U;
+    }
+    
+    return (int)(hash & INT_MAX);
 }
 
-int MPI_Init_thread(int *argc, char ***argv, int required, int *provided)
+/**
+ * Helper method that checks if a storage allocation is placed in a single file,
+ * which could be shared with other processes of the communicator.
+ */
+int isFileShareable(MPI_Aint size, MPI_Info_Values *info_values)
+{
+    return (info_values->alloc_type == MPI_WIN_ALLOC_STORAGE && size > 0 &&
+            strchr(info_values->filename, ',') == NULL);
+}
+
+/**
+ * Helper method that groups the processes of the communicator that request
+ * the same file for a storage allocation. The files are only grouped among
+ * the processes of the same node, unless the file system is shared between
+ * nodes (e.g., Lustre), as the same path might refer to a different file on
+ * each node otherwise. The group is MPI_COMM_NULL if the file is not shared
+ * with other processes (or if the allocation is striped across several
+ * files). Every process of the communicator must call the method, even if
+ * the allocation is in memory.
+ */
+int getFileGroup(MPI_Aint size, MPI_Comm comm, MPI_Info_Values *info_values, MPI_Comm *group_comm)
 {
-    // Currently, the implementation only supports MPI_THREAD_SINGLE
-    *provided = MPI_THREAD_SINGLE;
+    const int        storage    = isFileShareable(size, info_values);
+    int              group_size = 0;
+    int              mismatch   = FALSE;
+    MPI_Comm         node_comm  = MPI_COMM_NULL;
+    MPI_Win_File_Key key        = { 0 };
+    MPI_Win_File_Key key_root   = { 0 };
+    
+    // Identify the node of each process by its first process in the
+    // communicator, which is ignored on shared file systems
+    CHK(MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm));
+    CHK(MPI_Comm_rank(comm, &key.node));
+    CHK(MPI_Bcast(&key.node, 1, MPI_INT, 0, node_comm));
+    CHK(MPI_Comm_free(&node_comm));
+    
+    strcpy(key.filename, info_values->filename);
+    key.node = (storage && mfshared(key.filename)) ? ERROR : key.node;
+    
+    CHK(MPI_Comm_split(comm, ((storage) ? getFileKeyHash(&key) : MPI_UNDEFINED), 0, group_comm));
+    
+    if (*group_comm == MPI_COMM_NULL)
+    {
+        return MPI_SUCCESS;
+    }
     
-    return (required == MPI_THREAD_SINGLE) ? MPI_Init(argc, argv) :
-                                             MPI_ERR_INTERN;
+    CHK(MPI_Comm_size(*group_comm, &group_size));
+    
+    // Make sure that every process of the group requested the same file
+    if (group_size > 1)
+    {
+        key_root = key;
+        
+        CHK(MPI_Bcast(&key_root, sizeof(MPI_Win_File_Key), MPI_BYTE, 0, *group_comm));
+        
+        mismatch = (key_root.node != key.node || strcmp(key_root.filename, key.filename) != 0);
+        
+        CHK(MPI_Allreduce(MPI_IN_PLACE, &mismatch, 1, MPI_INT, MPI_LOR, *group_comm));
+    }
+    
+    // Divide the group by the first process that requested each file, if the
+    // hash of different files collided (i.e., unlikely)
+    if (mismatch)
+    {
+        MPI_Win_File_Key *keys      = (MPI_Win_File_Key *)malloc(sizeof(MPI_Win_File_Key) * group_size);
+        int              color      = 0;
+        MPI_Comm         exact_comm = MPI_COMM_NULL;
+        
+        CHK(MPI_Allgather(&key, sizeof(MPI_Win_File_Key), MPI_BYTE, keys, sizeof(MPI_Win_File_Key), MPI_BYTE,
+                          *group_comm));
+        
+        while (keys[color].node != key.node || strcmp(keys[color].filename, key.filename))
+        {
+            color++;
+        }
+        
+        free(keys);
+        
+        CHK(MPI_Comm_split(*group_comm, color, 0, &exact_comm));
+        CHK(MPI_Comm_free(group_comm));
+        CHK(MPI_Comm_size(exact_comm, &group_size));
+        
+        *group_comm = exact_comm;
+    }
+    
+    return (group_size == 1) ? MPI_Comm_free(group_comm) : MPI_SUCCESS;
+}
+
+/**
+ * Helper method that calculates the offset of the allocation within the file,
+ * if requested (i.e., set to "auto"). The allocations of the processes that
+ * share the file are packed in rank order with an exclusive scan, and each of
+ * them is padded to the page size and to the stripe unit, so that no page or
+ * stripe is shared by two processes.
+ */
+int calculateOffset(MPI_Aint size, MPI_Comm group_comm, MPI_Info_Values *info_values)
+{
+    const size_t pagesize = sysconf(_SC_PAGESIZE);
+    const size_t header   = (info_values->header) ? mfheader_size() : 0;
+    size_t       align    = pagesize;
+    uint64_t     length   = 0;
+    uint64_t     offset   = 0;
+    
+    // Note: The allocations of a block-cyclic layout start at the same offset
+    if (!info_values->offset_auto || info_values->block_cyclic)
+    {
+        return MPI_SUCCESS;
+    }
+    
+    if (info_values->striping_unit > 0)
+    {
+        align = ((info_values->striping_unit + pagesize - 1) / pagesize) * pagesize;
+    }
+    
+    // Note: The whole allocation is reserved if the factor is not known yet
+    length = (info_values->factor < 0.0f) ? (header + size) :
+                                            mfextent(header, size, info_values->factor, info_values->order,
+                                                     info_values->hugepages);
+    length = ((length + align - 1) / align) * align;
+    
+    if (group_comm != MPI_COMM_NULL)
+    {
+        int group_rank = 0;
+        
+        CHK(MPI_Comm_rank(group_comm, &group_rank));
+        CHK(MPI_Exscan(&length, &offset, 1, MPI_UINT64_T, MPI_SUM, group_comm));
+        
+        // Note: The result of the first process is undefined
+        offset = (group_rank == 0) ? 0 : offset;
+    }
+    
+    DBGPRINTF("Allocation offset calculated with offset=%lu length=%lu", (unsigned long)offset,
+                                                                        (unsigned long)length);
+    
+    info_values->offset = offset;
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that interleaves the allocations of the processes that share
+ * the file in a block-cyclic layout, if requested. The blocks are aligned to
+ * the page size and to the stripe unit, and the block k of the process with
+ * rank r is placed at the block (k * group_size + r) of the file, so that the
+ * file keeps the global order of the window.
+ */
+int setBlockCyclic(MPI_Comm group_comm, MPI_Info_Values *info_values)
+{
+    const size_t pagesize   = sysconf(_SC_PAGESIZE);
+    size_t       align      = pagesize;
+    size_t       block      = 0;
+    int          group_rank = 0;
+    int          group_size = 0;
+    
+    if (!info_values->block_cyclic || group_comm == MPI_COMM_NULL)
+    {
+        return MPI_SUCCESS;
+    }
+    
+    CHK(MPI_Comm_rank(group_comm, &group_rank));
+    CHK(MPI_Comm_size(group_comm, &group_size));
+    
+    if (info_values->striping_unit > 0)
+    {
+        align = ((info_values->striping_unit + pagesize - 1) / pagesize) * pagesize;
+    }
+    
+    block = (info_values->stripe_size > align) ? info_values->stripe_size : align;
+    block = ((block + align - 1) / align) * align;
+    
+    DBGPRINTF("Block-cyclic layout set with block=%zu group_rank=%d group_size=%d", block, group_rank, group_size);
+    
+    // Note: The header is not supported, as it would overlap the blocks of the
+    //       rest of processes
+    info_values->stripe_size   = block;
+    info_values->stripe_stride = block * group_size;
+    info_values->offset       += block * group_rank;
+    info_values->header        = FALSE;
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that creates the file shared by the processes of the group
+ * once. The first process of the group creates, stripes and extends the file
+ * up to the end of the furthest allocation, while the rest wait and only
+ * open the file afterwards (i.e., without O_CREAT). Only the first process
+ * removes the file if requested. The group is released afterwards.
+ */
+int createSharedFile(MPI_Aint size, MPI_Comm *group_comm, MPI_Info_Values *info_values)
+{
+    int      group_rank = 0;
+    int      error      = MPI_SUCCESS;
+    uint64_t extent     = 0;
+    
+    if (*group_comm == MPI_COMM_NULL)
+    {
+        return MPI_SUCCESS;
+    }
+    
+    CHK(MPI_Comm_rank(*group_comm, &group_rank));
+    
+    // Note: The header of the file is placed in front of each allocation
+    if (info_values->factor > 0.0f && info_values->stripe_stride == 0)
+    {
+        extent = mfextent(info_values->offset + ((info_values->header) ? mfheader_size() : 0), size,
+                          info_values->factor, info_values->order, info_values->hugepages);
+    }
+    else if (info_values->factor > 0.0f)
+    {
+        // The extent of an interleaved allocation is the end of its last block
+        const size_t length_s   = mfextent(0, size, info_values->factor, info_values->order, info_values->hugepages);
+        const size_t num_blocks = (length_s + info_values->stripe_size - 1) / info_values->stripe_size;
+        
+        extent = (num_blocks > 0) ? (info_values->offset + (num_blocks - 1) * info_values->stripe_stride +
+                                     (length_s - (num_blocks - 1) * info_values->stripe_size)) : 0;
+    }
+    
+    CHK(MPI_Reduce((group_rank == 0) ? MPI_IN_PLACE : &extent, &extent, 1, MPI_UINT64_T, MPI_MAX, 0,
+                   *group_comm));
+    
+    // Note: The file is not needed if the allocations only reside in memory
+    if (group_rank == 0 && extent > 0)
+    {
+        error = setStriping(info_values);
+        error = (error == MPI_SUCCESS) ? mfcreate(info_values->filename, extent, info_values->file_flags,
+                                                  info_values->file_perm, info_values->prealloc) : error;
+        
+        DBGPRINTF("Shared file created with filename=\"%s\" extent=%lu (hr=%d)", info_values->filename,
+                                                                                  (unsigned long)extent, error);
+    }
+    else if (group_rank > 0)
+    {
+        info_values->file_flags &= ~O_CREAT;
+        info_values->unlink      = FALSE;
+    }
+    
+    CHK(MPI_Bcast(&error, 1, MPI_INT, 0, *group_comm));
+    CHK(MPI_Comm_free(group_comm));
+    
+    return error;
+}
+
+/**
+ * Helper method that accumulates the counters of a mapping (or of the process)
+ * into the counters of the extension.
+ */
+void addStats(MFILE_Stats *mfstats, MPIX_Win_stats *stats)
+{
+    stats->num_allocs    += __atomic_load_n(&mfstats->num_allocs,   __ATOMIC_RELAXED);
+    stats->time_alloc    += __atomic_load_n(&mfstats->time_alloc,   __ATOMIC_RELAXED) * CONV_SEC;
+    stats->num_frees     += __atomic_load_n(&mfstats->num_frees,    __ATOMIC_RELAXED);
+    stats->time_free     += __atomic_load_n(&mfstats->time_free,    __ATOMIC_RELAXED) * CONV_SEC;
+    stats->num_syncs     += __atomic_load_n(&mfstats->num_syncs,    __ATOMIC_RELAXED);
+    stats->time_sync     += __atomic_load_n(&mfstats->time_total,   __ATOMIC_RELAXED) * CONV_SEC;
+    stats->bytes_flushed += __atomic_load_n(&mfstats->bytes_total,  __ATOMIC_RELAXED);
+    stats->num_faults    += __atomic_load_n(&mfstats->num_faults,   __ATOMIC_RELAXED);
+    stats->bytes_direct  += __atomic_load_n(&mfstats->bytes_direct, __ATOMIC_RELAXED);
+}
+
+/**
+ * Helper method that checks if the header of a file matches the layout of the
+ * requested allocation. The values that are unknown (e.g., the displacement
+ * unit in MPI_Alloc_mem) are not compared.
+ */
+int checkHeader(MFILE_Header *header, size_t offset, MPI_Aint size, MPI_Info_Values *info_values,
+                int disp_unit, int rank, int num_procs)
+{
+    const int disp_unit_check = (header->disp_unit > 0 && disp_unit > 0);
+    const int rank_check      = (header->rank != ERROR && rank != ERROR);
+    
+    return (header->version == MFILE_HEADER_VERSION && header->offset == offset &&
+            header->length  == (uint64_t)size && header->factor == info_values->factor &&
+            header->order   == info_values->order &&
+            (!disp_unit_check || header->disp_unit == disp_unit) &&
+            (!rank_check      || (header->rank == rank && header->num_procs == num_procs)));
+}
+
+/**
+ * Helper method that allocates memory or storage for a window. If a
+ * communicator is given, the allocation factor is calculated collectively
+ * among the processes that share the node (i.e., "auto" must be requested by
+ * every process of the communicator). The displacement unit is only used to
+ * describe the layout in the header of the file (zero if unknown).
+ */
+int allocMem(MPI_Aint size, int disp_unit, MPI_Info info, MPI_Comm comm, void *baseptr)
+{
+    MPI_Win_Alloc   *win_alloc  = NULL;
+    MPI_Info_Values info_values = { 0 };
+    MFILE_Header    header      = { 0 };
+    int             state       = ERROR;
+    int             mismatch    = FALSE;
+    int             collective  = 0;
+    int             rank        = ERROR;
+    int             num_procs   = 0;
+    MPI_Comm        group_comm  = MPI_COMM_NULL;
+    const size_t    start       = mftime();
+    
+    // Parse the MPI_Info object to determine if the allocation has to be based
+    // in traditional RAM memory or storage
+    parseInfo(info, &info_values);
+    
+    // Agree on the collective steps that the allocation requires, so that they
+    // are skipped by every process if no process requested them (e.g., windows
+    // in memory only pay for a single reduction)
+    if (comm != MPI_COMM_NULL)
+    {
+        collective = ((isFileShareable(size, &info_values)) ? ALLOC_SHARED_FILE : 0) |
+                     ((info_values.alloc_type == MPI_WIN_ALLOC_STORAGE && info_values.header) ? ALLOC_HEADER : 0);
+        
+        CHK(MPI_Comm_rank(comm, &rank));
+        CHK(MPI_Comm_size(comm, &num_procs));
+        CHK(MPI_Allreduce(MPI_IN_PLACE, &collective, 1, MPI_INT, MPI_BOR, comm));
+    }
+    
+    // Find the processes of the communicator that share the same file, which
+    // is needed to calculate the offsets and create the file collectively
+    if (collective & ALLOC_SHARED_FILE)
+    {
+        CHK(getFileGroup(size, comm, &info_values, &group_comm));
+    }
+    
+    CHK(calculateOffset(size, group_comm, &info_values));
+    CHK(setBlockCyclic(group_comm, &info_values));
+    
+    // Read the header of the file, if requested, which describes the layout of
+    // the window if the file is being reattached (e.g., after a restart)
+    if (info_values.alloc_type == MPI_WIN_ALLOC_STORAGE && info_values.header)
+    {
+        state = (mfheader_read(info_values.filename, info_values.offset, &header) != MPI_SUCCESS) ?
+                    MPIX_WIN_STATE_NEW :
+                (header.flags & MFILE_HEADER_CLEAN) ? MPIX_WIN_STATE_CLEAN : MPIX_WIN_STATE_DIRTY;
+    }
+    
+    // Check if we have to calculate the factor (i.e., it was set to "auto"),
+    // but keep the split of the file if it is being reattached (note that the
+    // factor is still calculated, as the calculation might be collective)
+    if (info_values.factor < 0.0f)
+    {
+        CHK(calculateFactor(size, comm, &info_values.factor));
+        
+        if (state == MPIX_WIN_STATE_CLEAN || state == MPIX_WIN_STATE_DIRTY)
+        {
+            info_values.factor = header.factor;
+        }
+    }
+    
+    // Make sure that the layout of the file matches the request if it is being
+    // reattached, agreeing on the result with the rest of processes of the
+    // communicator (i.e., they would block creating the window otherwise)
+    if ((state == MPIX_WIN_STATE_CLEAN || state == MPIX_WIN_STATE_DIRTY) && info_values.factor > 0.0f)
+    {
+        mismatch = !checkHeader(&header, info_values.offset + mfheader_size(), size, &info_values, disp_unit,
+                                rank, num_procs);
+    }
+    
+    if (collective & ALLOC_HEADER)
+    {
+        CHK(MPI_Allreduce(MPI_IN_PLACE, &mismatch, 1, MPI_INT, MPI_LOR, comm));
+    }
+    
+    if (mismatch)
+    {
+        DBGPRINTF("Header mismatch with filename=\"%s\" (length=%lu factor=%lf order=%d)",
+                  info_values.filename, (unsigned long)header.length, header.factor, header.order);
+        
+        if (group_comm != MPI_COMM_NULL)
+        {
+            MPI_Comm_free(&group_comm);
+        }
+        
+        return MPI_ERR_FILE;
+    }
+    
+    // Create the files shared by several processes of the communicator once,
+    // instead of creating and extending them from each process
+    CHK(createSharedFile(size, &group_comm, &info_values));
+    
+    win_alloc = (MPI_Win_Alloc *)calloc(1, sizeof(MPI_Win_Alloc));
+    
+    // Make sure that the allocation type and factor are correctly set
+    if (info_values.alloc_type == MPI_WIN_ALLOC_STORAGE && info_values.factor > 0.0f)
+    {
+        MFILE  *mfile      = NULL;
+        size_t start_setup = 0;
+        int    error       = MPI_SUCCESS;
+        
+        DBGPRINTF("Storage allocation requested with filename=\"%s\" (offset=%zu unlink=%d)", info_values.filename,
+                                                                                              info_values.offset,
+                                                                                              info_values.unlink);
+        
+        // Set the striping values for the file if it does not exist
+        if (setStriping(&info_values) != MPI_SUCCESS)
+        {
+            free(win_alloc);
+            return ERROR;
+        }
+        
+        // Reserve the header in front of the mapping (note that the layout of
+        // a reattached file was already validated)
+        if (state != ERROR)
+        {
+            const size_t offset = info_values.offset + mfheader_size();
+            
+            if (state == MPIX_WIN_STATE_NEW)
+            {
+                header.offset    = offset;
+                header.length    = size;
+                header.factor    = info_values.factor;
+                header.order     = info_values.order;
+                header.disp_unit = disp_unit;
+                header.rank      = rank;
+                header.num_procs = num_procs;
+            }
+            
+            info_values.offset = offset;
+        }
+        
+        // Create the mapping of the given file into memory
+        mfile = (MFILE *)malloc(sizeof(MFILE));
+        error = mfalloc(info_values.filename, info_values.offset, size,
+                        info_values.factor, info_values.order, info_values.unlink,
+                        info_values.access_style, info_values.file_flags,
+                        info_values.file_perm,
+                        info_values.hugepages | info_values.prealloc | info_values.flush,
+                        info_values.stripe_size, info_values.stripe_stride, mfile);
+        
+        if (error != MPI_SUCCESS)
+        {
+            free(mfile);
+            free(win_alloc);
+            return error;
+        }
+        
+        start_setup = mftime();
+        
+        // Note: The chunks are aligned to the page size, as required by msync
+        mfile->sync_threads = info_values.sync_threads;
+        mfile->sync_chunk   = (info_values.sync_chunk / sysconf(_SC_PAGESIZE)) * sysconf(_SC_PAGESIZE);
+        mfile->io_threshold = info_values.uring_threshold;
+        
+        // Write the header before the window is modified, so that the file is
+        // not considered clean until it is released (i.e., read-only files
+        // are only validated)
+        if (state != ERROR && (info_values.file_flags & O_ACCMODE) != O_RDONLY)
+        {
+            error = mfheader_write(mfile, info_values.offset - mfheader_size(), &header);
+        }
+        
+        // Restore the content of the snapshot before the storage part is
+        // serviced by the engines, if requested
+        if (error == MPI_SUCCESS && info_values.snapshot[0] != '\0')
+        {
+            error = mfrestore(*mfile, info_values.snapshot);
+        }
+        
+        // Keep the smallest threshold, which discards most transfers without
+        // retrieving the attributes of the window
+        if (info_values.uring_threshold > 0)
+        {
+            size_t threshold = __atomic_load_n(&g_uring_threshold, __ATOMIC_RELAXED);
+            
+            while (info_values.uring_threshold < threshold &&
+                   !__atomic_compare_exchange_n(&g_uring_threshold, &threshold, info_values.uring_threshold,
+                                                FALSE, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+        }
+        
+        // Service the page faults of the storage part in the library, if
+        // requested, but keep the kernel mapping if the engine is not available
+        if (error == MPI_SUCCESS && info_values.engine &&
+            mfuffd_register(mfile, info_values.engine_cluster, info_values.engine_budget) != MPI_SUCCESS)
+        {
+            DBGPRINT("Userfaultfd engine not available, using the mmap engine instead");
+        }
+        
+        // Migrate the hot regions of the storage part to memory, if requested
+        // (i.e., the userfaultfd engine already decides which pages are kept)
+        if (error == MPI_SUCCESS && info_values.tier_budget > 0 && mfile->uffd == NULL &&
+            mftier_register(mfile, info_values.tier_region, info_values.tier_budget) != MPI_SUCCESS)
+        {
+            DBGPRINT("Tiering not available, keeping the static split of the allocation");
+        }
+        
+        // Keep track of the local transfers issued directly to the file, if
+        // requested (i.e., not available if the pages are kept in memory)
+        if (error == MPI_SUCCESS && info_values.uring_threshold > 0 && mfuring_register(mfile) != MPI_SUCCESS)
+        {
+            DBGPRINT("Direct transfers not available, using the mapping instead");
+        }
+        
+        // Prefault the mapping before the first epoch, if requested (note that
+        // read-only mappings can only be prefaulted for reading)
+        if (error == MPI_SUCCESS && info_values.populate)
+        {
+            error = mfpopulate(*mfile, ((info_values.file_flags & O_RDONLY) ? MFILE_POPULATE_READ :
+                                                                              info_values.populate),
+                               info_values.populate_threads);
+        }
+        
+        // Start the background write-back of the storage part, if requested
+        // (i.e., only needed if the mapping can be modified and paged by the kernel)
+        if (error == MPI_SUCCESS && info_values.writeback && !(info_values.file_flags & O_RDONLY) &&
+            mfile->uffd == NULL && mfile->stripes == NULL)
+        {
+            error = mfwriteback_register(*mfile, info_values.writeback_threshold,
+                                         info_values.writeback_interval);
+        }
+        
+        // Release the mapping and its file if the setup failed
+        if (error != MPI_SUCCESS)
+        {
+            mffree(*mfile);
+            free(mfile);
+            free(win_alloc);
+            return error;
+        }
+        
+        // Fill the window allocation object with the mapping details (note that
+        // the address returned matches the original request and is not aligned)
+        win_alloc->alloc_type = MPI_WIN_ALLOC_STORAGE;
+        win_alloc->data       = mfile;
+        win_alloc->state      = state;
+        *((void**)baseptr)    = mfile->addr_src;
+        
+        // Include the setup of the engines in the allocation time
+        mfstats_alloc(*mfile, mftime() - start_setup);
+        
+        DBGPRINTF("Allocation in storage successful with length=%lu", mfile->length);
+    }
+    else
+    {
+        int error = MPI_SUCCESS;
+        
+        DBGPRINT("Memory allocation requested (replicating the default behaviour)");
+        
+        // Allocate the requested size using MPI functionality
+        if ((error = PMPI_Alloc_mem(size, info, (void*)&win_alloc->data)) != MPI_SUCCESS)
+        {
+            free(win_alloc);
+            return error;
+        }
+        
+        // Fill the window allocation object with the allocation details
+        win_alloc->alloc_type = MPI_WIN_ALLOC_MEM;
+        win_alloc->state      = ERROR;
+        *((void**)baseptr)    = win_alloc->data;
+        
+        DBGPRINTF("Allocation in memory successful with length=%ld", size);
+    }
+    
+    // Disable the release flag to avoid issues if the user is allocating this memory
+    // from outside (i.e., it will not be released during window deallocation)
+    win_alloc->alloc_release = FALSE;
+    
+    mftrace(MFTRACE_ALLOC, start, size);
+    
+    return addWinAlloc(win_alloc);
+}
+
+
+//////////////////////////////////
+// PUBLIC DEFINITIONS & METHODS //
+//////////////////////////////////
+
+int MPI_Alloc_mem(MPI_Aint size, MPI_Info info, void *baseptr)
+{
+    DBGPRINT("MPI allocation wrapper called");
+    
+    return allocMem(size, 0, info, MPI_COMM_NULL, baseptr);
+}
+
+int MPI_Free_mem(void *base)
+{
+    MPI_Win_Alloc *win_alloc = NULL;
+    
+    DBGPRINT("MPI allocation release wrapper called");
+    
+    if (getWinAllocFromPtr(base, TRUE, &win_alloc) == MPI_SUCCESS)
+    {
+        return releaseWinAlloc(win_alloc);
+    }
+    
+    DBGPRINT("MPI allocation unknown");
+    
+    return MPI_ERR_BASE;
+}
+
+int MPI_Win_create(void *base, MPI_Aint size, int disp_unit, MPI_Info info, 
+                   MPI_Comm comm, MPI_Win *win)
+{
+    DBGPRINT("Window creation wrapper called");
+    
+    CHK(PMPI_Win_create(base, size, disp_unit, info, comm, win));
+    
+    return cacheWinAlloc(*win, base);
+}
+
+int MPI_Win_allocate(MPI_Aint size, int disp_unit, MPI_Info info, 
+                     MPI_Comm comm, void *baseptr, MPI_Win *win)
+{
+    MPI_Win_Alloc *win_alloc = NULL;
+    
+    DBGPRINT("Window allocation wrapper called");
+    
+    CHK(allocMem(size, disp_unit, info, comm, baseptr));
+    CHK(MPI_Win_create(*((void**)baseptr), size, disp_unit, info, comm, win));
+    
+    // Enable the release flag to guarantee that the memory is released afterwards during
+    // window deallocation (i.e., by default, the user has to manually release it)
+    CHK(getWinAllocFromWin(*win, &win_alloc));
+    win_alloc->alloc_release = TRUE;
+    
+    DBGPRINTF("Window allocated succesfully with type=%s", ((win_alloc->alloc_type == MPI_WIN_ALLOC_MEM) ? "MEM" : "STORAGE"));
+    
+    return MPI_SUCCESS;
+}
+
+int MPI_Win_allocate_shared(MPI_Aint size, int disp_unit, MPI_Info info, MPI_Comm comm,
+                            void *baseptr, MPI_Win *win)
+{
+    MPI_Info_Values info_values = { 0 };
+    MPI_Win_Alloc   *win_alloc  = NULL;
+    MPI_Win_Segment *segments   = NULL;
+    MPI_Aint        *sizes      = NULL;
+    MPI_Aint        segment[2]  = { size, disp_unit };
+    MPI_Aint        length      = 0;
+    MFILE           *mfile      = NULL;
+    size_t          start       = 0;
+    size_t          end         = 0;
+    int             rank        = 0;
+    int             num_procs   = 0;
+    int             error       = MPI_SUCCESS;
+    
+    DBGPRINT("Shared window allocation wrapper called");
+    
+    parseInfo(info, &info_values);
+    
+    // Note: Every process maps the same file, and thus the hints of the first
+    //       process are applied to the whole node
+    CHK(MPI_Bcast(&info_values, sizeof(MPI_Info_Values), MPI_BYTE, 0, comm));
+    
+    if (info_values.alloc_type != MPI_WIN_ALLOC_STORAGE)
+    {
+        return PMPI_Win_allocate_shared(size, disp_unit, info, comm, baseptr, win);
+    }
+    
+    CHK(MPI_Comm_rank(comm, &rank));
+    CHK(MPI_Comm_size(comm, &num_procs));
+    
+    // Retrieve the segment of every process, which are placed consecutively
+    // in the file (i.e., as in the contiguous layout of the original call)
+    sizes    = (MPI_Aint *)malloc(sizeof(MPI_Aint) * 2 * num_procs);
+    segments = (MPI_Win_Segment *)malloc(sizeof(MPI_Win_Segment) * num_procs);
+    
+    CHK(MPI_Allgather(segment, 2, MPI_AINT, sizes, 2, MPI_AINT, comm));
+    
+    for (int i = 0; i < num_procs; i++)
+    {
+        segments[i].base      = (void *)length;
+        segments[i].size      = sizes[i * 2];
+        segments[i].disp_unit = sizes[i * 2 + 1];
+        length               += sizes[i * 2];
+    }
+    
+    free(sizes);
+    
+    if (length == 0)
+    {
+        free(segments);
+        
+        return PMPI_Win_allocate_shared(size, disp_unit, info, comm, baseptr, win);
+    }
+    
+    DBGPRINTF("Shared storage allocation requested with filename=\"%s\" (length=%ld)", info_values.filename, length);
+    
+    // The first process creates and extends the file before the rest of the
+    // processes map it, and it is also the only one that removes it afterwards
+    mfile = (MFILE *)malloc(sizeof(MFILE));
+    
+    if (rank == 0)
+    {
+        error = mfalloc(info_values.filename, info_values.offset, length, 1.0, info_values.order,
+                        info_values.unlink, info_values.access_style, info_values.file_flags,
+                        info_values.file_perm, info_values.prealloc | info_values.flush, info_values.stripe_size, 0,
+                        mfile);
+    }
+    
+    CHK(MPI_Bcast(&error, 1, MPI_INT, 0, comm));
+    
+    if (rank != 0 && error == MPI_SUCCESS)
+    {
+        error = mfalloc(info_values.filename, info_values.offset, length, 1.0, info_values.order, FALSE,
+                        info_values.access_style, info_values.file_flags, info_values.file_perm,
+                        info_values.flush, info_values.stripe_size, 0, mfile);
+    }
+    
+    if (error != MPI_SUCCESS)
+    {
+        free(mfile);
+        free(segments);
+        
+        return error;
+    }
+    
+    // Note: The page cache is shared by every process, and thus the engines
+    //       that keep a private copy of the storage part are not supported
+    mfile->sync_threads = info_values.sync_threads;
+    mfile->sync_chunk   = (info_values.sync_chunk / sysconf(_SC_PAGESIZE)) * sysconf(_SC_PAGESIZE);
+    
+    for (int i = 0; i < num_procs; i++)
+    {
+        segments[i].base = (char *)mfile->addr_src + (MPI_Aint)segments[i].base;
+    }
+    
+    mfile->addr_src = segments[rank].base;
+    
+    // Limit the storage part to the pages of the segment of the process, so
+    // that each process only flushes its own segment (note that the pages at
+    // the boundaries might be shared with the neighbouring segments)
+    start = ((char *)segments[rank].base - (char *)mfile->addr_s) & ~(sysconf(_SC_PAGESIZE) - 1);
+    end   = ((char *)segments[rank].base - (char *)mfile->addr_s) + size;
+    end   = (end + sysconf(_SC_PAGESIZE) - 1) & ~(sysconf(_SC_PAGESIZE) - 1);
+    end   = (end < mfile->length_s) ? end : mfile->length_s;
+    
+    mfile->addr_s    = (char *)mfile->addr_s + start;
+    mfile->length_s  = (size > 0) ? (end - start) : 0;
+    mfile->offset   += start;
+    
+    // Cache the allocation and create the window on the segment of the process
+    win_alloc             = (MPI_Win_Alloc *)calloc(1, sizeof(MPI_Win_Alloc));
+    win_alloc->alloc_type = MPI_WIN_ALLOC_STORAGE;
+    win_alloc->data       = mfile;
+    win_alloc->state      = ERROR;
+    win_alloc->segments   = segments;
+    *((void**)baseptr)    = mfile->addr_src;
+    
+    error = addWinAlloc(win_alloc);
+    
+    if (error == MPI_SUCCESS && (error = MPI_Win_create(mfile->addr_src, size, disp_unit, info, comm,
+                                                        win)) != MPI_SUCCESS)
+    {
+        removeWinAlloc(win_alloc);
+    }
+    
+    // Release the mapping and the allocation object if the window could not
+    // be created (i.e., they are otherwise released with the window)
+    if (error != MPI_SUCCESS)
+    {
+        mffree(*mfile);
+        free(mfile);
+        free(segments);
+        free(win_alloc);
+        
+        return error;
+    }
+    
+    CHK(getWinAllocFromWin(*win, &win_alloc));
+    
+    win_alloc->alloc_release = TRUE;
+    win_alloc->num_segments  = num_procs;
+    
+    DBGPRINTF("Shared window allocated succesfully with length=%lu", mfile->length);
+    
+    return MPI_SUCCESS;
+}
+
+int MPI_Win_shared_query(MPI_Win win, int rank, MPI_Aint *size, int *disp_unit, void *baseptr)
+{
+    MPI_Win_Alloc *win_alloc = NULL;
+    
+    // Note: Windows allocated in memory are queried with the original call
+    if (getWinAllocFromWin(win, &win_alloc) != MPI_SUCCESS || win_alloc->segments == NULL)
+    {
+        return PMPI_Win_shared_query(win, rank, size, disp_unit, baseptr);
+    }
+    
+    // Return the first segment with a non-zero size if requested
+    if (rank == MPI_PROC_NULL)
+    {
+        for (rank = 0; rank < (win_alloc->num_segments - 1) && win_alloc->segments[rank].size == 0; rank++);
+    }
+    else if (rank < 0 || rank >= win_alloc->num_segments)
+    {
+        return MPI_ERR_RANK;
+    }
+    
+    *size              = win_alloc->segments[rank].size;
+    *disp_unit         = win_alloc->segments[rank].disp_unit;
+    *((void**)baseptr) = win_alloc->segments[rank].base;
+    
+    return MPI_SUCCESS;
+}
+
+int MPI_Win_get_attr(MPI_Win win, int win_keyval, void *attribute_val, int *flag)
+{
+    MPI_Win_Alloc *win_alloc = NULL;
+    
+    CHK(PMPI_Win_get_attr(win, win_keyval, attribute_val, flag));
+    
+    // Note: The shared windows in storage are created with MPI_Win_create on
+    //       the segment of each process, and thus the flavor is replaced
+    if (win_keyval == MPI_WIN_CREATE_FLAVOR && *flag && getWinAllocFromWin(win, &win_alloc) == MPI_SUCCESS &&
+        win_alloc->segments != NULL)
+    {
+        *((int **)attribute_val) = &g_shared_flavor;
+    }
+    
+    return MPI_SUCCESS;
+}
+
+int MPI_Win_sync(MPI_Win win)
+{
+    MPI_Win_Alloc **win_allocs = NULL;
+    int           count        = 0;
+    int           count_sync   = 0;
+    int           hr           = MPI_SUCCESS;
+    const size_t  start        = mftime();
+    
+    DBGPRINT("Window flushing wrapper called");
+    
+    CHK(PMPI_Win_sync(win));
+    CHK(waitLocalTransfers(win));
+    
+    if ((getAllWinAllocFromWin(win, &win_allocs, &count) == MPI_SUCCESS))
+    {
+        MFILE **mfiles      = (MFILE **)malloc(sizeof(MFILE *) * count);
+        int   count_storage = 0;
+        
+        DBGPRINTF("Window allocations cached in the window (count=%d)", count);
+        
+        // Flush every storage allocation at once, while memory allocations are
+        // skipped (i.e., already synchronized by PMPI_Win_sync)
+        for (int walloc = 0; walloc < count; walloc++)
+        {
+            if (win_allocs[walloc]->alloc_type == MPI_WIN_ALLOC_STORAGE)
+            {
+                mfiles[count_storage++] = (MFILE *)win_allocs[walloc]->data;
+            }
+        }
+        
+        if (count_storage > 0)
+        {
+            hr = mfflush(mfiles, count_storage);
+        }
+        
+        DBGPRINTF("Finished flushing the allocations (count_storage=%d / count_mem=%d)", count_storage, count - count_storage);
+        
+        count_sync = count_storage;
+        
+        free(mfiles);
+        free(win_allocs);
+    }
+    
+    mftrace(MFTRACE_SYNC, start, count_sync);
+    
+    return hr;
+}
+
+int MPI_Win_attach(MPI_Win win, void *base, MPI_Aint size)
+{
+    DBGPRINT("Window attach wrapper called");
+    
+    mftrace(MFTRACE_ATTACH, mftime(), size);
+    
+    CHK(cacheWinAlloc(win, base));
+    
+    return PMPI_Win_attach(win, base, size);
+}
+
+int MPI_Win_detach(MPI_Win win, const void *base)
+{
+    DBGPRINT("Window detach wrapper called");
+    
+    mftrace(MFTRACE_DETACH, mftime(), 0);
+    
+    CHK(uncacheWinAlloc(win, base));
+    
+    return PMPI_Win_detach(win, base);
+}
+
+int MPI_Init_thread(int *argc, char ***argv, int required, int *provided)
+{
+    // Note: The internal caches are thread-safe, and thus the level provided by
+    // the MPI implementation is returned directly
+    return PMPI_Init_thread(argc, argv, required, provided);
+}
+
+int MPI_Finalize()
+{
+    const char *env = getenv(STATS_ENV);
+    int        rank = 0;
+    
+    PMPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    
+    // Print a summary of the counters of the process, if requested
+    if (env != NULL && strcmp(env, "0"))
+    {
+        MPIX_Win_stats stats = { 0 };
+        struct rusage  usage = { 0 };
+        
+        MPIX_Get_stats(&stats);
+        getrusage(RUSAGE_SELF, &usage);
+        
+        fprintf(stderr, "[mpi_swin] rank=%d allocs=%lld alloc_time=%.6lf frees=%lld free_time=%.6lf "
+                        "syncs=%lld sync_time=%.6lf flushed=%lld faults=%lld direct=%lld "
+                        "minflt=%ld majflt=%ld\n",
+                rank, (long long)stats.num_allocs, stats.time_alloc, (long long)stats.num_frees,
+                stats.time_free, (long long)stats.num_syncs, stats.time_sync,
+                (long long)stats.bytes_flushed, (long long)stats.num_faults, (long long)stats.bytes_direct,
+                usage.ru_minflt, usage.ru_majflt);
+    }
+    
+    // Write the events recorded by the tracer, if enabled
+    if (mftrace_write(rank) != MPI_SUCCESS)
+    {
+        DBGPRINT("Trace could not be written");
+    }
+    
+    return PMPI_Finalize();
+}
+
+int MPI_Put(const void *origin_addr, int origin_count, MPI_Datatype origin_datatype,
+            int target_rank, MPI_Aint target_disp, int target_count,
+            MPI_Datatype target_datatype, MPI_Win win)
+{
+    // Note: The transfer is only issued through io_uring if the target is the
+    //       calling process and the range is located in the storage part
+    if (issueLocalTransfer((void *)origin_addr, origin_count, origin_datatype, target_rank, target_disp,
+                           target_count, target_datatype, win, TRUE) == MPI_SUCCESS)
+    {
+        return MPI_SUCCESS;
+    }
+    
+    return PMPI_Put(origin_addr, origin_count, origin_datatype, target_rank, target_disp,
+                    target_count, target_datatype, win);
+}
+
+int MPI_Get(void *origin_addr, int origin_count, MPI_Datatype origin_datatype,
+            int target_rank, MPI_Aint target_disp, int target_count,
+            MPI_Datatype target_datatype, MPI_Win win)
+{
+    if (issueLocalTransfer(origin_addr, origin_count, origin_datatype, target_rank, target_disp,
+                           target_count, target_datatype, win, FALSE) == MPI_SUCCESS)
+    {
+        return MPI_SUCCESS;
+    }
+    
+    return PMPI_Get(origin_addr, origin_count, origin_datatype, target_rank, target_disp,
+                    target_count, target_datatype, win);
+}
+
+int MPI_Win_flush_local(int rank, MPI_Win win)
+{
+    CHK(waitLocalTransfers(win));
+    
+    return PMPI_Win_flush_local(rank, win);
+}
+
+int MPI_Win_flush_local_all(MPI_Win win)
+{
+    CHK(waitLocalTransfers(win));
+    
+    return PMPI_Win_flush_local_all(win);
+}
+
+int MPI_Win_flush(int rank, MPI_Win win)
+{
+    CHK(waitLocalTransfers(win));
+    
+    return PMPI_Win_flush(rank, win);
+}
+
+int MPI_Win_flush_all(MPI_Win win)
+{
+    CHK(waitLocalTransfers(win));
+    
+    return PMPI_Win_flush_all(win);
+}
+
+int MPI_Win_unlock(int rank, MPI_Win win)
+{
+    CHK(waitLocalTransfers(win));
+    
+    return PMPI_Win_unlock(rank, win);
+}
+
+int MPI_Win_unlock_all(MPI_Win win)
+{
+    CHK(waitLocalTransfers(win));
+    
+    return PMPI_Win_unlock_all(win);
+}
+
+int MPI_Win_fence(int assert, MPI_Win win)
+{
+    CHK(waitLocalTransfers(win));
+    
+    return PMPI_Win_fence(assert, win);
+}
+
+int MPI_Win_complete(MPI_Win win)
+{
+    CHK(waitLocalTransfers(win));
+    
+    return PMPI_Win_complete(win);
+}
+
+int MPIX_Win_isync(MPI_Win win, MPI_Request *request)
+{
+    MPI_Win_Alloc **win_allocs = NULL;
+    MPI_Win_Isync *isync       = NULL;
+    int           count        = 0;
+    int           provided     = MPI_THREAD_SINGLE;
+    int           error        = MPI_SUCCESS;
+    
+    DBGPRINT("Window non-blocking flushing extension called");
+    
+    CHK(MPI_Query_thread(&provided));
+    
+    if ((isync = (MPI_Win_Isync *)malloc(sizeof(MPI_Win_Isync))) == NULL)
+    {
+        return MPI_ERR_NO_MEM;
+    }
+    
+    isync->error = MPI_SUCCESS;
+    
+    if ((error = MPI_Grequest_start(isyncQuery, isyncFree, isyncCancel, isync, &isync->request)) != MPI_SUCCESS)
+    {
+        free(isync);
+        
+        return error;
+    }
+    
+    *request = isync->request;
+    
+    // The request can only be completed from the flushing threads with
+    // MPI_THREAD_MULTIPLE, and thus the window is flushed synchronously and
+    // the request is returned completed otherwise
+    if (provided < MPI_THREAD_MULTIPLE)
+    {
+        DBGPRINT("MPI_THREAD_MULTIPLE not available, flushing the window synchronously");
+        
+        isyncDone(isync, MPI_Win_sync(win));
+        
+        return MPI_SUCCESS;
+    }
+    
+    // Note: The request was already returned, and thus it is completed with
+    //       the error instead (i.e., MPI_Wait would block indefinitely)
+    error = PMPI_Win_sync(win);
+    error = (error == MPI_SUCCESS) ? waitLocalTransfers(win) : error;
+    
+    if (error != MPI_SUCCESS)
+    {
+        isyncDone(isync, error);
+    }
+    else if (getAllWinAllocFromWin(win, &win_allocs, &count) == MPI_SUCCESS)
+    {
+        MFILE **mfiles      = (MFILE **)malloc(sizeof(MFILE *) * count);
+        int   count_storage = 0;
+        
+        DBGPRINTF("Window allocations cached in the window (count=%d)", count);
+        
+        for (int walloc = 0; walloc < count; walloc++)
+        {
+            if (win_allocs[walloc]->alloc_type == MPI_WIN_ALLOC_STORAGE)
+            {
+                mfiles[count_storage++] = (MFILE *)win_allocs[walloc]->data;
+            }
+        }
+        
+        // Note: The allocations are flushed by the pool of flushing threads of
+        //       each device, and the last one completes the request
+        mfflush_async(mfiles, count_storage, isyncDone, isync);
+        
+        free(mfiles);
+        free(win_allocs);
+    }
+    else
+    {
+        isyncDone(isync, MPI_SUCCESS);
+    }
+    
+    return MPI_SUCCESS;
+}
+
+int MPIX_Win_get_flushed(MPI_Win win, MPI_Count *bytes_last, MPI_Count *bytes_total)
+{
+    MPI_Win_Alloc **win_allocs = NULL;
+    int           count        = 0;
+    
+    *bytes_last  = 0;
+    *bytes_total = 0;
+    
+    if (getAllWinAllocFromWin(win, &win_allocs, &count) == MPI_SUCCESS)
+    {
+        for (int walloc = 0; walloc < count; walloc++)
+        {
+            if (win_allocs[walloc]->alloc_type == MPI_WIN_ALLOC_STORAGE)
+            {
+                MFILE *mfile = (MFILE *)win_allocs[walloc]->data;
+                
+                *bytes_last  += mfile->stats->bytes_last;
+                *bytes_total += mfile->stats->bytes_total;
+            }
+        }
+        
+        free(win_allocs);
+    }
+    
+    return MPI_SUCCESS;
+}
+
+int MPIX_Win_get_flush_bandwidth(MPI_Win win, double *bandwidth)
+{
+    MPI_Win_Alloc **win_allocs = NULL;
+    int           count        = 0;
+    size_t        bytes        = 0;
+    size_t        elapsed      = 0;
+    
+    *bandwidth = 0.0;
+    
+    if (getAllWinAllocFromWin(win, &win_allocs, &count) == MPI_SUCCESS)
+    {
+        for (int walloc = 0; walloc < count; walloc++)
+        {
+            if (win_allocs[walloc]->alloc_type == MPI_WIN_ALLOC_STORAGE)
+            {
+                MFILE *mfile = (MFILE *)win_allocs[walloc]->data;
+                
+                // Note: The allocations are flushed concurrently, and thus the
+                //       slowest allocation defines the elapsed time
+                bytes  += mfile->stats->bytes_last;
+                elapsed = (mfile->stats->time_last > elapsed) ? mfile->stats->time_last : elapsed;
+            }
+        }
+        
+        free(win_allocs);
+    }
+    
+    if (elapsed > 0)
+    {
+        *bandwidth = (double)bytes / ((double)elapsed / 1000000000.0);
+    }
+    
+    return MPI_SUCCESS;
+}
+
+int MPIX_Win_snapshot(MPI_Win win, const char *path)
+{
+    MPI_Win_Alloc **win_allocs = NULL;
+    int           count        = 0;
+    int           count_snap   = 0;
+    int           hr           = MPI_SUCCESS;
+    
+    DBGPRINT("Window snapshot extension called");
+    
+    // The storage part is cloned from the file, and thus it is flushed first
+    CHK(MPI_Win_sync(win));
+    
+    if (getAllWinAllocFromWin(win, &win_allocs, &count) == MPI_SUCCESS)
+    {
+        for (int walloc = 0; hr == MPI_SUCCESS && walloc < count; walloc++)
+        {
+            if (win_allocs[walloc]->alloc_type == MPI_WIN_ALLOC_STORAGE)
+            {
+                char path_snap[PATH_MAX];
+                
+                // Note: Each additional allocation of a dynamic window is stored
+                //       in a separate file, with the index as suffix
+                if (count_snap == 0)
+                {
+                    snprintf(path_snap, sizeof(path_snap), "%s", path);
+                }
+                else
+                {
+                    snprintf(path_snap, sizeof(path_snap), "%s.%d", path, count_snap);
+                }
+                
+                hr = mfsnapshot(*((MFILE *)win_allocs[walloc]->data), path_snap);
+                count_snap++;
+            }
+        }
+        
+        free(win_allocs);
+    }
+    
+    return hr;
+}
+
+int MPIX_Win_rebalance(MPI_Win win)
+{
+    MPI_Win_Alloc **win_allocs = NULL;
+    int           count        = 0;
+    int           hr           = MPI_SUCCESS;
+    int           hr_fence     = MPI_SUCCESS;
+    
+    DBGPRINT("Window rebalance extension called");
+    
+    // Complete every RMA operation on the window before the regions are
+    // remapped, and prevent any new operation until every process finishes
+    CHK(MPI_Win_fence(0, win));
+    
+    if (getAllWinAllocFromWin(win, &win_allocs, &count) == MPI_SUCCESS)
+    {
+        for (int walloc = 0; hr == MPI_SUCCESS && walloc < count; walloc++)
+        {
+            MFILE *mfile = (MFILE *)win_allocs[walloc]->data;
+            
+            if (win_allocs[walloc]->alloc_type == MPI_WIN_ALLOC_STORAGE && mfile->tier != NULL)
+            {
+                hr = mftier_rebalance(*mfile);
+            }
+        }
+        
+        free(win_allocs);
+    }
+    
+    // Note: The closing fence is always issued, even on error, so that the
+    //       rest of processes do not block waiting for it
+    hr_fence = MPI_Win_fence(MPI_MODE_NOSUCCEED, win);
+    
+    return (hr != MPI_SUCCESS) ? hr : hr_fence;
+}
+
+int MPIX_Win_get_state(MPI_Win win, int *state)
+{
+    MPI_Win_Alloc **win_allocs = NULL;
+    int           count        = 0;
+    int           found        = FALSE;
+    
+    *state = MPIX_WIN_STATE_NEW;
+    
+    if (getAllWinAllocFromWin(win, &win_allocs, &count) == MPI_SUCCESS)
+    {
+        for (int walloc = 0; walloc < count; walloc++)
+        {
+            const int state_alloc = win_allocs[walloc]->state;
+            
+            // Note: A file that was not released cleanly prevails over the
+            //       rest, while a new file prevails over the clean ones
+            if (state_alloc != ERROR && (!found || state_alloc == MPIX_WIN_STATE_DIRTY ||
+                                         (state_alloc == MPIX_WIN_STATE_NEW && *state == MPIX_WIN_STATE_CLEAN)))
+            {
+                *state = state_alloc;
+            }
+            
+            found |= (state_alloc != ERROR);
+        }
+        
+        free(win_allocs);
+    }
+    
+    return MPI_SUCCESS;
+}
+
+int MPIX_Win_get_stats(MPI_Win win, MPIX_Win_stats *stats)
+{
+    MPI_Win_Alloc **win_allocs = NULL;
+    int           count        = 0;
+    
+    memset(stats, 0, sizeof(MPIX_Win_stats));
+    
+    if (getAllWinAllocFromWin(win, &win_allocs, &count) == MPI_SUCCESS)
+    {
+        for (int walloc = 0; walloc < count; walloc++)
+        {
+            if (win_allocs[walloc]->alloc_type == MPI_WIN_ALLOC_STORAGE)
+            {
+                addStats(((MFILE *)win_allocs[walloc]->data)->stats, stats);
+            }
+        }
+        
+        free(win_allocs);
+    }
+    
+    return MPI_SUCCESS;
+}
+
+int MPIX_Get_stats(MPIX_Win_stats *stats)
+{
+    MFILE_Stats mfstats = { 0 };
+    
+    memset(stats, 0, sizeof(MPIX_Win_stats));
+    
+    mfstats_process(&mfstats);
+    addStats(&mfstats, stats);
+    
+    return MPI_SUCCESS;
 }
 
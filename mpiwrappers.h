@@ -29,11 +29,29 @@ int MPI_Win_create(void *base, MPI_Aint size, int disp_unit, MPI_Info info,
 /**
  * Wrapper of the original MPI_Win_allocate that allows to create MPI windows
  * based on storage devices, alongside the traditional memory-based. The Info
- * hints can be provided for allocations based in storage.
+ * hints can be provided for allocations based in storage. With an "auto"
+ * allocation factor, the processes that share a node divide the memory
+ * available collectively.
  */
 int MPI_Win_allocate(MPI_Aint size, int disp_unit, MPI_Info info, 
                      MPI_Comm comm, void *baseptr, MPI_Win *win);
 
+/**
+ * Wrapper of the original MPI_Win_allocate_shared that allows to allocate a
+ * shared window in storage. A single file is mapped by every process of the
+ * communicator (i.e., one copy in the page cache of the node), with the
+ * segments of the processes placed consecutively. The Info hints of the first
+ * process are applied to every process.
+ */
+int MPI_Win_allocate_shared(MPI_Aint size, int disp_unit, MPI_Info info, MPI_Comm comm,
+                            void *baseptr, MPI_Win *win);
+
+/**
+ * Wrapper of the original MPI_Win_shared_query that returns the segments of
+ * the windows allocated in storage with MPI_Win_allocate_shared.
+ */
+int MPI_Win_shared_query(MPI_Win win, int rank, MPI_Aint *size, int *disp_unit, void *baseptr);
+
 /**
  * Wrapper of the original MPI_Win_sync that allows to force the changes on an
  * MPI window to be flushed to storage. If the window was allocated in RAM, the
@@ -56,11 +74,38 @@ int MPI_Win_attach(MPI_Win win, void *base, MPI_Aint size);
 int MPI_Win_detach(MPI_Win win, const void *base);
 
 /**
- * Wrapper of the original MPI_Init_thread that prevents the use of the library
- * on multithreaded applications (i.e., the implementation is not thread-safe).
+ * Wrapper of the original MPI_Init_thread that forwards the requested thread
+ * support level to the MPI implementation (i.e., the library is thread-safe).
  */
 int MPI_Init_thread(int *argc, char ***argv, int required, int *provided);
 
+/**
+ * Wrappers of the original MPI_Put and MPI_Get that issue large contiguous
+ * transfers directly to the mapped file through io_uring, if the target is
+ * the calling process and the range is located in the storage part of an
+ * allocation (i.e., avoiding the page faults of the mapping). The rest of
+ * transfers use the original implementation.
+ */
+int MPI_Put(const void *origin_addr, int origin_count, MPI_Datatype origin_datatype,
+            int target_rank, MPI_Aint target_disp, int target_count,
+            MPI_Datatype target_datatype, MPI_Win win);
+int MPI_Get(void *origin_addr, int origin_count, MPI_Datatype origin_datatype,
+            int target_rank, MPI_Aint target_disp, int target_count,
+            MPI_Datatype target_datatype, MPI_Win win);
+
+/**
+ * Wrappers of the original synchronization calls that complete the transfers
+ * issued through io_uring before the calls take place.
+ */
+int MPI_Win_flush_local(int rank, MPI_Win win);
+int MPI_Win_flush_local_all(MPI_Win win);
+int MPI_Win_flush(int rank, MPI_Win win);
+int MPI_Win_flush_all(MPI_Win win);
+int MPI_Win_unlock(int rank, MPI_Win win);
+int MPI_Win_unlock_all(MPI_Win win);
+int MPI_Win_fence(int assert, MPI_Win win);
+int MPI_Win_complete(MPI_Win win);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,5 +1,7 @@
 
 #include "common.h"
+#include <stdint.h>
+#include <pthread.h>
 #include "mfile.h"
 #include "mpi_swin_keys.h"
 #include "mpiwrappers_util.h"
@@ -8,59 +10,295 @@
 // PRIVATE DEFINITIONS & METHODS //
 ///////////////////////////////////
 
-#define NUM_WINDOWS_INIT 64
+#define NUM_WINDOWS_INIT    64
+#define NUM_RANGES_INIT     8
+#define WRITEBACK_THRESHOLD (16 << 20)
+#define WRITEBACK_INTERVAL  500
+#define POPULATE_THREADS    4
+#define SYNC_THREADS        4
+#define SYNC_CHUNK          (64 << 20)
+#define ENGINE_CLUSTER      (64 << 10)
+#define ENGINE_BUDGET       0
+#define TIER_REGION         (2 << 20)
+#define STRIPE_SIZE         (1 << 20)
 
 /**
- * Macro that defines the structure and functions for the internal cache of a
- * certain type (e.g., MPI_Win_Alloc cache).
+ * Structure that defines the hash table of the allocations, indexed by the
+ * base pointer that is returned to the user (open addressing).
  */
-#define MAKE_STORE(S,T,SN) \
-    struct Win##S##Store \
-    { \
-        T   *data; \
-        int count; \
-        int size; \
-    } w##SN##_cache; \
-    \
-    int addWin##S(T win_##SN) \
-    { \
-        if (w##SN##_cache.data == NULL) \
-        { \
-            w##SN##_cache.data  = (T *)malloc(sizeof(T) * NUM_WINDOWS_INIT); \
-            w##SN##_cache.count = 0; \
-            w##SN##_cache.size  = NUM_WINDOWS_INIT; \
-        } \
-        else if (w##SN##_cache.count == w##SN##_cache.size) \
-        { \
-            w##SN##_cache.size <<= 1; \
-            w##SN##_cache.data   = (T *)realloc(w##SN##_cache.data, sizeof(T) * w##SN##_cache.size); \
-        } \
-        \
-        w##SN##_cache.data[w##SN##_cache.count++] = win_##SN; \
-        \
-        return MPI_SUCCESS; \
-    } \
-    \
-    void deleteWin##S##Entry(int index) \
-    { \
-        memmove(&w##SN##_cache.data[index], &w##SN##_cache.data[index+1], sizeof(T) * (w##SN##_cache.count - index - 1)); \
-        w##SN##_cache.count--; \
-    }\
-    \
-    int removeWin##S(T win_##SN) \
-    { \
-        for (int i = 0; i < w##SN##_cache.count; i++) \
-        { \
-            if (w##SN##_cache.data[i] == win_##SN) \
-            { \
-                deleteWin##S##Entry(i); \
-                \
-                return MPI_SUCCESS; \
-            } \
-        } \
-        \
-        return MPI_ERR_OTHER; \
+typedef struct
+{
+    MPI_Win_Alloc **data;
+    size_t        count;
+    size_t        size;
+} MPI_Win_Alloc_Table;
+
+MPI_Win_Alloc_Table walloc_table = { NULL, 0, 0 };
+int                 wkeyval      = MPI_KEYVAL_INVALID;
+pthread_mutex_t     walloc_mutex = PTHREAD_MUTEX_INITIALIZER;  // Protects the table and the lists
+
+/**
+ * Helper method that returns the slot of a given pointer in the hash table.
+ */
+size_t hashPtr(const void *ptr)
+{
+    uint64_t key = (uint64_t)(uintptr_t)ptr;
+    
+    // Note: Mix the bits of the pointer, as the lower bits are usually aligned
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDULL;
+    key ^= key >> 33;
+    
+    return (size_t)key & (walloc_table.size - 1);
+}
+
+/**
+ * Helper method that returns the slot that contains the given pointer, or
+ * the empty slot where it should be inserted.
+ */
+size_t findSlot(const void *ptr)
+{
+    size_t slot = hashPtr(ptr);
+    
+    while (walloc_table.data[slot] != NULL && walloc_table.data[slot]->base != ptr)
+    {
+        slot = (slot + 1) & (walloc_table.size - 1);
+    }
+    
+    return slot;
+}
+
+/**
+ * Helper method that inserts an allocation into the hash table, without
+ * checking the load factor. Allocations with the same base pointer (e.g., NULL
+ * for zero-size allocations) are chained into a single slot.
+ */
+void insertSlot(MPI_Win_Alloc *win_alloc)
+{
+    size_t slot = findSlot(win_alloc->base);
+    
+    win_alloc->same         = walloc_table.data[slot];
+    walloc_table.data[slot] = win_alloc;
+    
+    if (win_alloc->same == NULL)
+    {
+        walloc_table.count++;
+    }
+}
+
+/**
+ * Helper method that returns the first allocation of a given slot that is
+ * attached to the given list (NULL if none).
+ */
+MPI_Win_Alloc *findInSlot(size_t slot, const MPI_Win_Alloc_List *list)
+{
+    MPI_Win_Alloc *win_alloc = walloc_table.data[slot];
+    
+    while (win_alloc != NULL && win_alloc->list != list)
+    {
+        win_alloc = win_alloc->same;
+    }
+    
+    return win_alloc;
+}
+
+/**
+ * Helper method that removes the allocation of a given slot, shifting back
+ * the entries of the same cluster to avoid the need of tombstones.
+ */
+void deleteSlot(size_t slot)
+{
+    size_t next = slot;
+    
+    walloc_table.data[slot] = NULL;
+    walloc_table.count--;
+    
+    while (walloc_table.data[(next = (next + 1) & (walloc_table.size - 1))] != NULL)
+    {
+        MPI_Win_Alloc *win_alloc = walloc_table.data[next];
+        size_t        home       = hashPtr(win_alloc->base);
+        
+        // Move the entry if its home slot is not between the empty slot and
+        // its current position (considering the wrap-around)
+        if (((next - home) & (walloc_table.size - 1)) >= ((next - slot) & (walloc_table.size - 1)))
+        {
+            walloc_table.data[slot] = win_alloc;
+            walloc_table.data[next] = NULL;
+            slot                    = next;
+        }
     }
+}
+
+/**
+ * Helper method that removes a specific allocation from a given slot, which
+ * is only released when no other allocation shares the base pointer.
+ */
+int unlinkSlot(size_t slot, MPI_Win_Alloc *win_alloc)
+{
+    MPI_Win_Alloc **link = &walloc_table.data[slot];
+    
+    while (*link != NULL && *link != win_alloc)
+    {
+        link = &(*link)->same;
+    }
+    
+    if (*link == NULL)
+    {
+        return MPI_ERR_OTHER;
+    }
+    
+    *link = win_alloc->same;
+    
+    if (walloc_table.data[slot] == NULL)
+    {
+        // Restore the slot temporarily, as the entry must be shifted back
+        walloc_table.data[slot] = win_alloc;
+        deleteSlot(slot);
+    }
+    
+    win_alloc->same = NULL;
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that returns the position of the first storage allocation of
+ * the list whose mapping begins after the given address (binary search).
+ */
+int findRange(const MPI_Win_Alloc_List *list, const void *addr)
+{
+    int low  = 0;
+    int high = list->num_ranges;
+    
+    while (low < high)
+    {
+        int   mid   = low + (high - low) / 2;
+        MFILE *mfile = (MFILE *)list->ranges[mid]->data;
+        
+        if ((char *)mfile->addr <= (char *)addr)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    
+    return low;
+}
+
+/**
+ * Helper method that inserts a storage allocation into the sorted array of the
+ * list, used to find the allocation that contains a given address.
+ */
+int insertRange(MPI_Win_Alloc_List *list, MPI_Win_Alloc *win_alloc)
+{
+    MFILE *mfile = (MFILE *)win_alloc->data;
+    int   index  = 0;
+    
+    // Note: Empty mappings are not indexed, as they might share the address
+    //       with the mapping that follows them
+    if (mfile->length == 0)
+    {
+        return MPI_SUCCESS;
+    }
+    
+    if (list->num_ranges == list->size_ranges)
+    {
+        int           size   = (list->size_ranges > 0) ? (list->size_ranges << 1) : NUM_RANGES_INIT;
+        MPI_Win_Alloc **data = (MPI_Win_Alloc **)realloc(list->ranges, sizeof(MPI_Win_Alloc *) * size);
+        
+        if (data == NULL)
+        {
+            return MPI_ERR_NO_MEM;
+        }
+        
+        list->ranges      = data;
+        list->size_ranges = size;
+    }
+    
+    index = findRange(list, mfile->addr);
+    
+    memmove(&list->ranges[index + 1], &list->ranges[index],
+            sizeof(MPI_Win_Alloc *) * (list->num_ranges - index));
+    
+    list->ranges[index] = win_alloc;
+    list->num_ranges++;
+    
+    return MPI_SUCCESS;
+}
+
+/**
+ * Helper method that removes a storage allocation from the sorted array of
+ * the list.
+ */
+void removeRange(MPI_Win_Alloc_List *list, MPI_Win_Alloc *win_alloc)
+{
+    MFILE *mfile = (MFILE *)win_alloc->data;
+    int   index  = findRange(list, mfile->addr);
+    
+    while (--index >= 0 && list->ranges[index] != win_alloc);
+    
+    if (index >= 0)
+    {
+        memmove(&list->ranges[index], &list->ranges[index + 1],
+                sizeof(MPI_Win_Alloc *) * (list->num_ranges - index - 1));
+        
+        list->num_ranges--;
+    }
+}
+
+/**
+ * Helper method that removes an allocation from the list of the window that
+ * it is attached to.
+ */
+void removeFromList(MPI_Win_Alloc *win_alloc)
+{
+    MPI_Win_Alloc_List *list = win_alloc->list;
+    
+    if (win_alloc->alloc_type == MPI_WIN_ALLOC_STORAGE)
+    {
+        removeRange(list, win_alloc);
+    }
+    
+    if (win_alloc->prev != NULL)
+    {
+        win_alloc->prev->next = win_alloc->next;
+    }
+    else
+    {
+        list->head = win_alloc->next;
+    }
+    
+    if (win_alloc->next != NULL)
+    {
+        win_alloc->next->prev = win_alloc->prev;
+    }
+    
+    list->count--;
+    
+    win_alloc->list = NULL;
+    win_alloc->prev = NULL;
+    win_alloc->next = NULL;
+}
+
+/**
+ * Helper method that retrieves the list of allocations of a given window.
+ */
+MPI_Win_Alloc_List *getWinAllocList(MPI_Win win)
+{
+    MPI_Win_Alloc_List *list = NULL;
+    int                flag  = 0;
+    
+    if (wkeyval == MPI_KEYVAL_INVALID ||
+        MPI_Win_get_attr(win, wkeyval, (void **)&list, &flag) != MPI_SUCCESS || !flag)
+    {
+        return NULL;
+    }
+    
+    return list;
+}
 
 /**
  * Helper method that allows to obtain the value of a given MPI_Info key.
@@ -91,17 +329,39 @@ int parseInfo(MPI_Info info, MPI_Info_Values *values)
     char info_value[MPI_MAX_INFO_VAL];
     
     // Set the default values for the hints
-    values->alloc_type      = MPI_WIN_ALLOC_MEM;
-    values->unlink          = FALSE;
-    values->access_style    = MADV_NORMAL;
-    values->file_flags      = O_CREAT | O_RDWR;
-    values->file_perm       = S_IRUSR | S_IWUSR;
-    values->striping_factor = 0;
-    values->striping_unit   = 0;
-    values->offset          = 0;
-    values->factor          = 1.0;
-    values->order           = 0;
-    values->filename[0]     = '\0';
+    values->alloc_type          = MPI_WIN_ALLOC_MEM;
+    values->unlink              = FALSE;
+    values->access_style        = MADV_NORMAL;
+    values->file_flags          = O_CREAT | O_RDWR;
+    values->file_perm           = S_IRUSR | S_IWUSR;
+    values->striping_factor     = 0;
+    values->striping_unit       = 0;
+    values->offset              = 0;
+    values->offset_auto         = FALSE;
+    values->factor              = 1.0;
+    values->order               = 0;
+    values->writeback           = FALSE;
+    values->writeback_threshold = WRITEBACK_THRESHOLD;
+    values->writeback_interval  = WRITEBACK_INTERVAL;
+    values->hugepages           = 0;
+    values->populate            = 0;
+    values->populate_threads    = POPULATE_THREADS;
+    values->prealloc            = 0;
+    values->flush               = 0;
+    values->sync_threads        = SYNC_THREADS;
+    values->sync_chunk          = SYNC_CHUNK;
+    values->engine              = FALSE;
+    values->engine_cluster      = ENGINE_CLUSTER;
+    values->engine_budget       = ENGINE_BUDGET;
+    values->uring_threshold     = 0;
+    values->tier_budget         = 0;
+    values->tier_region         = TIER_REGION;
+    values->filename[0]         = '\0';
+    values->snapshot[0]         = '\0';
+    values->header              = FALSE;
+    values->stripe_size         = STRIPE_SIZE;
+    values->stripe_stride       = 0;
+    values->block_cyclic        = FALSE;
     
     // If we find the "alloc_type" flag and it's set to "storage", retrieve the settings
     if (info != MPI_INFO_NULL && getInfoValue(info, MPI_SWIN_ALLOC_TYPE, info_value) &&
@@ -116,7 +376,12 @@ int parseInfo(MPI_Info info, MPI_Info_Values *values)
         
         if (getInfoValue(info, MPI_SWIN_OFFSET, info_value))
         {
-            sscanf(info_value, "%zu", &values->offset);
+            values->offset_auto = !strcmp(info_value, "auto");
+            
+            if (!values->offset_auto)
+            {
+                sscanf(info_value, "%zu", &values->offset);
+            }
         }
         
         if (getInfoValue(info, MPI_SWIN_FACTOR, info_value))
@@ -141,6 +406,114 @@ int parseInfo(MPI_Info info, MPI_Info_Values *values)
             values->unlink = !strcmp(info_value, "true");
         }
         
+        if (getInfoValue(info, MPI_SWIN_WRITEBACK, info_value))
+        {
+            values->writeback = !strcmp(info_value, "background");
+        }
+        
+        if (getInfoValue(info, MPI_SWIN_WRITEBACK_THRESHOLD, info_value))
+        {
+            sscanf(info_value, "%zu", &values->writeback_threshold);
+        }
+        
+        if (getInfoValue(info, MPI_SWIN_WRITEBACK_INTERVAL, info_value))
+        {
+            sscanf(info_value, "%d", &values->writeback_interval);
+        }
+        
+        if (getInfoValue(info, MPI_SWIN_HUGEPAGES, info_value))
+        {
+            values->hugepages = (!strcmp(info_value, "explicit"))    ? MFILE_HUGEPAGES_EXPLICIT    :
+                                (!strcmp(info_value, "transparent")) ? MFILE_HUGEPAGES_TRANSPARENT :
+                                                                       0;
+        }
+        
+        if (getInfoValue(info, MPI_SWIN_POPULATE, info_value))
+        {
+            values->populate = (!strcmp(info_value, "read"))  ? MFILE_POPULATE_READ  :
+                               (!strcmp(info_value, "write")) ? MFILE_POPULATE_WRITE :
+                                                                0;
+        }
+        
+        if (getInfoValue(info, MPI_SWIN_POPULATE_THREADS, info_value))
+        {
+            sscanf(info_value, "%d", &values->populate_threads);
+        }
+        
+        if (getInfoValue(info, MPI_SWIN_PREALLOC, info_value))
+        {
+            values->prealloc = (!strcmp(info_value, "fallocate"))           ? MFILE_PREALLOC_FALLOCATE  :
+                               (!strcmp(info_value, "fallocate_keep_size")) ? MFILE_PREALLOC_KEEP_SIZE  :
+                               (!strcmp(info_value, "zero_range"))          ? MFILE_PREALLOC_ZERO_RANGE :
+                               (!strcmp(info_value, "auto"))                ? MFILE_PREALLOC_AUTO       :
+                                                                              0;
+        }
+        
+        if (getInfoValue(info, MPI_SWIN_FLUSH, info_value))
+        {
+            values->flush = (!strcmp(info_value, "fdatasync")) ? MFILE_FLUSH_FDATASYNC : 0;
+        }
+        
+        if (getInfoValue(info, MPI_SWIN_SYNC_THREADS, info_value))
+        {
+            sscanf(info_value, "%d", &values->sync_threads);
+        }
+        
+        if (getInfoValue(info, MPI_SWIN_SYNC_CHUNK, info_value))
+        {
+            sscanf(info_value, "%zu", &values->sync_chunk);
+        }
+        
+        if (getInfoValue(info, MPI_SWIN_ENGINE, info_value))
+        {
+            values->engine = !strcmp(info_value, "uffd");
+        }
+        
+        if (getInfoValue(info, MPI_SWIN_ENGINE_CLUSTER, info_value))
+        {
+            sscanf(info_value, "%zu", &values->engine_cluster);
+        }
+        
+        if (getInfoValue(info, MPI_SWIN_ENGINE_BUDGET, info_value))
+        {
+            sscanf(info_value, "%zu", &values->engine_budget);
+        }
+        
+        if (getInfoValue(info, MPI_SWIN_URING_THRESHOLD, info_value))
+        {
+            sscanf(info_value, "%zu", &values->uring_threshold);
+        }
+        
+        if (getInfoValue(info, MPI_SWIN_TIER_BUDGET, info_value))
+        {
+            sscanf(info_value, "%zu", &values->tier_budget);
+        }
+        
+        if (getInfoValue(info, MPI_SWIN_TIER_REGION, info_value))
+        {
+            sscanf(info_value, "%zu", &values->tier_region);
+        }
+        
+        if (getInfoValue(info, MPI_SWIN_SNAPSHOT, info_value))
+        {
+            strcpy(values->snapshot, info_value);
+        }
+        
+        if (getInfoValue(info, MPI_SWIN_HEADER, info_value))
+        {
+            values->header = !strcmp(info_value, "true");
+        }
+        
+        if (getInfoValue(info, MPI_SWIN_STRIPE_SIZE, info_value))
+        {
+            sscanf(info_value, "%zu", &values->stripe_size);
+        }
+        
+        if (getInfoValue(info, MPI_SWIN_LAYOUT, info_value))
+        {
+            values->block_cyclic = !strcmp(info_value, "block_cyclic");
+        }
+        
         if (getInfoValue(info, MPI_IO_ACCESS_STYLE, info_value))
         {
             const int read_once  = (strstr(info_value, "read_once") != NULL);
@@ -180,102 +553,265 @@ int parseInfo(MPI_Info info, MPI_Info_Values *values)
     return MPI_SUCCESS;
 }
 
-MAKE_STORE(Keyval, int, keyval);
-MAKE_STORE(Alloc, MPI_Win_Alloc*, alloc);
+int initWinKeyval(MPI_Win_copy_attr_function *copy_fn, MPI_Win_delete_attr_function *delete_fn)
+{
+    int hr = MPI_SUCCESS;
+    
+    pthread_mutex_lock(&walloc_mutex);
+    
+    if (wkeyval == MPI_KEYVAL_INVALID)
+    {
+        hr = MPI_Win_create_keyval(copy_fn, delete_fn, &wkeyval, NULL);
+    }
+    
+    pthread_mutex_unlock(&walloc_mutex);
+    
+    return hr;
+}
 
-int getWinAllocFromWin(MPI_Win win, int delete_entry, MPI_Win_Alloc **win_alloc)
+int addWinAlloc(MPI_Win_Alloc *win_alloc)
 {
-    MPI_Win_Alloc *win_alloc_tmp = 0;
-    int           flag           = 0;
+    win_alloc->base = getPtrFromWinAlloc(win_alloc);
+    win_alloc->list = NULL;
+    win_alloc->prev = NULL;
+    win_alloc->next = NULL;
     
-    for (int keyval = 0; keyval < wkeyval_cache.count; keyval++)
+    pthread_mutex_lock(&walloc_mutex);
+    
+    if (walloc_table.data == NULL)
+    {
+        walloc_table.data = (MPI_Win_Alloc **)calloc(NUM_WINDOWS_INIT, sizeof(MPI_Win_Alloc *));
+        walloc_table.size = NUM_WINDOWS_INIT;
+    }
+    else if ((walloc_table.count + 1) * 2 > walloc_table.size)
     {
-        CHK(MPI_Win_get_attr(win, wkeyval_cache.data[keyval], (void **)&win_alloc_tmp, &flag));
+        MPI_Win_Alloc **data = walloc_table.data;
+        size_t        size   = walloc_table.size;
+        
+        // Double the size of the table and re-insert the entries to keep the
+        // load factor below 50%
+        walloc_table.size  <<= 1;
+        walloc_table.data    = (MPI_Win_Alloc **)calloc(walloc_table.size, sizeof(MPI_Win_Alloc *));
+        walloc_table.count   = 0;
         
-        if (flag)
+        for (size_t slot = 0; slot < size; slot++)
         {
-            *win_alloc = win_alloc_tmp;
-            
-            if (delete_entry)
+            // Note: The chain of allocations with the same base is moved as a whole
+            if (data[slot] != NULL)
             {
-                deleteWinKeyvalEntry(keyval);
+                walloc_table.data[findSlot(data[slot]->base)] = data[slot];
+                walloc_table.count++;
             }
-            
-            return MPI_SUCCESS;
         }
+        
+        free(data);
     }
     
-    return MPI_ERR_KEYVAL;
+    insertSlot(win_alloc);
+    
+    pthread_mutex_unlock(&walloc_mutex);
+    
+    return MPI_SUCCESS;
 }
 
-int getWinAllocFromPtr(void* ptr, int delete_entry, MPI_Win_Alloc **win_alloc)
+int removeWinAlloc(MPI_Win_Alloc *win_alloc)
+{
+    int hr = MPI_ERR_OTHER;
+    
+    pthread_mutex_lock(&walloc_mutex);
+    
+    if (walloc_table.data != NULL)
+    {
+        hr = unlinkSlot(findSlot(win_alloc->base), win_alloc);
+    }
+    
+    pthread_mutex_unlock(&walloc_mutex);
+    
+    return hr;
+}
+
+int attachWinAlloc(MPI_Win win, void *ptr, MPI_Win_Alloc **win_alloc)
 {
-    for (int walloc = 0; walloc < walloc_cache.count; walloc++)
+    MPI_Win_Alloc_List *list   = NULL;
+    MPI_Win_Alloc      *walloc = NULL;
+    int                hr      = MPI_SUCCESS;
+    
+    pthread_mutex_lock(&walloc_mutex);
+    
+    // Note: Allocations attached to a window are not available until detached
+    if (walloc_table.data == NULL || (walloc = findInSlot(findSlot(ptr), NULL)) == NULL)
+    {
+        pthread_mutex_unlock(&walloc_mutex);
+        
+        return MPI_ERR_OTHER;
+    }
+    
+    // Create the list of allocations of the window on the first attach, which
+    // is associated to the window object as an attribute
+    if ((list = getWinAllocList(win)) == NULL)
+    {
+        list = (MPI_Win_Alloc_List *)calloc(1, sizeof(MPI_Win_Alloc_List));
+        hr   = MPI_Win_set_attr(win, wkeyval, (void *)list);
+    }
+    
+    if (hr == MPI_SUCCESS && walloc->alloc_type == MPI_WIN_ALLOC_STORAGE)
+    {
+        hr = insertRange(list, walloc);
+    }
+    
+    if (hr == MPI_SUCCESS)
     {
-        if (getPtrFromWinAlloc(walloc_cache.data[walloc]) == ptr)
+        walloc->list = list;
+        walloc->prev = NULL;
+        walloc->next = list->head;
+        
+        if (list->head != NULL)
         {
-            *win_alloc = walloc_cache.data[walloc];
-            
-            if (delete_entry)
-            {
-                deleteWinAllocEntry(walloc);
-            }
-            
-            return MPI_SUCCESS;
+            list->head->prev = walloc;
         }
+        
+        list->head = walloc;
+        list->count++;
+        
+        *win_alloc = walloc;
     }
     
-    return MPI_ERR_OTHER;
+    pthread_mutex_unlock(&walloc_mutex);
+    
+    return hr;
+}
+
+void unlinkWinAlloc(MPI_Win_Alloc *win_alloc)
+{
+    pthread_mutex_lock(&walloc_mutex);
+    
+    removeFromList(win_alloc);
+    
+    pthread_mutex_unlock(&walloc_mutex);
 }
 
-int getWinKeyvalFromWinPtr(MPI_Win win, void* ptr, int *win_keyval)
+int detachWinAlloc(MPI_Win win, const void *ptr, MPI_Win_Alloc **win_alloc)
 {
-    MPI_Win_Alloc *win_alloc = NULL;
-    int           flag       = 0;
+    MPI_Win_Alloc_List *list   = NULL;
+    MPI_Win_Alloc      *walloc = NULL;
+    
+    pthread_mutex_lock(&walloc_mutex);
     
-    for (int keyval = 0; keyval < wkeyval_cache.count; keyval++)
+    // Make sure that the allocation is attached to this specific window
+    if ((list = getWinAllocList(win)) == NULL || walloc_table.data == NULL ||
+        (walloc = findInSlot(findSlot(ptr), list)) == NULL)
     {
-        CHK(MPI_Win_get_attr(win, wkeyval_cache.data[keyval], (void **)&win_alloc, &flag));
+        pthread_mutex_unlock(&walloc_mutex);
         
-        if (flag && (getPtrFromWinAlloc(win_alloc) == ptr))
+        return MPI_ERR_KEYVAL;
+    }
+    
+    removeFromList(walloc);
+    
+    pthread_mutex_unlock(&walloc_mutex);
+    
+    *win_alloc = walloc;
+    
+    return MPI_SUCCESS;
+}
+
+int getWinAllocFromWin(MPI_Win win, MPI_Win_Alloc **win_alloc)
+{
+    MPI_Win_Alloc_List *list = NULL;
+    int                hr    = MPI_ERR_KEYVAL;
+    
+    pthread_mutex_lock(&walloc_mutex);
+    
+    if ((list = getWinAllocList(win)) != NULL && list->head != NULL)
+    {
+        *win_alloc = list->head;
+        
+        hr = MPI_SUCCESS;
+    }
+    
+    pthread_mutex_unlock(&walloc_mutex);
+    
+    return hr;
+}
+
+int getWinAllocFromPtr(void* ptr, int delete_entry, MPI_Win_Alloc **win_alloc)
+{
+    MPI_Win_Alloc *walloc = NULL;
+    size_t        slot    = 0;
+    int           hr      = MPI_ERR_OTHER;
+    
+    pthread_mutex_lock(&walloc_mutex);
+    
+    // Note: Allocations attached to a window are not available until detached
+    if (walloc_table.data != NULL && (walloc = findInSlot((slot = findSlot(ptr)), NULL)) != NULL)
+    {
+        *win_alloc = walloc;
+        
+        if (delete_entry)
         {
-            *win_keyval = wkeyval_cache.data[keyval];
-            
-            return MPI_SUCCESS;
+            unlinkSlot(slot, walloc);
         }
+        
+        hr = MPI_SUCCESS;
     }
     
-    return MPI_ERR_KEYVAL;
+    pthread_mutex_unlock(&walloc_mutex);
+    
+    return hr;
 }
 
 int getAllWinAllocFromWin(MPI_Win win, MPI_Win_Alloc ***win_allocs, int *count)
 {
-    MPI_Win_Alloc **wallocs   = (MPI_Win_Alloc **)malloc(sizeof(MPI_Win_Alloc *) * wkeyval_cache.count);
-    int           num_keyvals = 0;
-    int           flag        = 0;
+    MPI_Win_Alloc_List *list      = NULL;
+    MPI_Win_Alloc      *win_alloc = NULL;
+    int                walloc     = 0;
     
-    for (int keyval = 0; keyval < wkeyval_cache.count; keyval++)
+    pthread_mutex_lock(&walloc_mutex);
+    
+    list = getWinAllocList(win);
+    
+    // Set the count to the number of allocations found (it can be 0)
+    *count = (list != NULL) ? list->count : 0;
+    
+    if (*count > 0)
     {
-        CHK(MPI_Win_get_attr(win, wkeyval_cache.data[keyval], (void **)&wallocs[num_keyvals], &flag));
+        *win_allocs = (MPI_Win_Alloc **)malloc(sizeof(MPI_Win_Alloc *) * (*count));
         
-        if (flag)
+        for (win_alloc = list->head; win_alloc != NULL; win_alloc = win_alloc->next)
         {
-            num_keyvals++;
+            (*win_allocs)[walloc++] = win_alloc;
         }
     }
     
-    if (num_keyvals > 0)
+    pthread_mutex_unlock(&walloc_mutex);
+    
+    return (*count > 0) ? MPI_SUCCESS : MPI_ERR_KEYVAL;
+}
+
+int getWinAllocFromAddr(MPI_Win win, const void *addr, size_t length, MPI_Win_Alloc **win_alloc)
+{
+    MPI_Win_Alloc_List *list  = NULL;
+    int                index = 0;
+    
+    pthread_mutex_lock(&walloc_mutex);
+    
+    *win_alloc = NULL;
+    
+    // Only the storage allocations are considered, as the length of memory
+    // allocations is unknown (i.e., the mappings never overlap, and thus only
+    // the last one that begins before the address can contain the range)
+    if ((list = getWinAllocList(win)) != NULL && (index = findRange(list, addr)) > 0)
     {
-        *win_allocs = (MPI_Win_Alloc **)malloc(sizeof(MPI_Win_Alloc *) * num_keyvals);
+        MFILE *mfile = (MFILE *)list->ranges[index - 1]->data;
         
-        memcpy(*win_allocs, wallocs, sizeof(MPI_Win_Alloc *) * num_keyvals);
+        if (((char *)addr + length) <= ((char *)mfile->addr + mfile->length))
+        {
+            *win_alloc = list->ranges[index - 1];
+        }
     }
     
-    // Set the count to the number of key / values found (it can be 0)
-    *count = num_keyvals;
-    
-    free(wallocs);
+    pthread_mutex_unlock(&walloc_mutex);
     
-    return (num_keyvals > 0) ? MPI_SUCCESS : MPI_ERR_KEYVAL;
+    return (*win_alloc != NULL) ? MPI_SUCCESS : MPI_ERR_KEYVAL;
 }
 
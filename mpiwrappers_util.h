@@ -5,14 +5,6 @@
 extern "C" {
 #endif
 
-/**
- * Macro that allows to declare functions for managing the internal cache of a
- * certain type (e.g., MPI_Win_Alloc cache).
- */
-#define DECLARE_STORE_FN(S,T,SN) \
-    int addWin##S(T win_##SN); \
-    int removeWin##S(T win_##SN);
-
 /**
  * Enumerate that defines the type of allocation associated to the window,
  * useful to differentiate between memory and storage-based windows.
@@ -36,21 +28,77 @@ typedef struct
     int     striping_factor;            // Stripe count used for new mapped files
     long    striping_unit;              // Size of the stripes used for new mapped files
     size_t  offset;                     // Offset within the file or block device where the mapping begins
+    int     offset_auto;                // Flag that determines if the offset is calculated collectively
     double  factor;                     // Allocation factor that defines the part on storage
     int     order;                      // Order of the allocations (e.g., memory first)
+    int     writeback;                  // Flag that enables the background write-back of modified pages
+    size_t  writeback_threshold;        // Dirty bytes that start the background write-back
+    int     writeback_interval;         // Interval between background write-back checks (in milliseconds)
+    int     hugepages;                  // Type of huge pages for the memory part (i.e., MFILE flags)
+    int     populate;                   // Mode used to prefault the allocation (i.e., MFILE mode or zero if disabled)
+    int     populate_threads;           // Number of threads that prefault the allocation
+    int     prealloc;                   // Preallocation of the extended file (i.e., MFILE flags)
+    int     flush;                      // Flushing method of the storage part (i.e., MFILE flags)
+    int     sync_threads;               // Number of threads per device that flush the window
+    size_t  sync_chunk;                 // Size of the chunks flushed concurrently
+    int     engine;                     // Flag that determines if the storage part is paged by the library (i.e., userfaultfd)
+    size_t  engine_cluster;             // Size of the clusters read and written by the paging engine
+    size_t  engine_budget;              // Maximum bytes kept in memory by the paging engine (zero if unlimited)
+    size_t  uring_threshold;            // Minimum size of the local transfers issued through io_uring
+    size_t  tier_budget;                // Memory available to the hot regions of the storage part (zero if disabled)
+    size_t  tier_region;                // Size of the regions migrated between memory and storage
     char    filename[MPI_MAX_INFO_VAL]; // Requested filename for the mapped file or block device (full path)
+    char    snapshot[MPI_MAX_INFO_VAL]; // Snapshot restored into the allocation (empty if none)
+    int     header;                     // Flag that determines if the layout is described in a header of the file
+    size_t  stripe_size;                // Size of the stripes if the storage part is striped across several files
+    size_t  stripe_stride;              // Distance between the stripes of the allocation within each file (zero if contiguous)
+    int     block_cyclic;               // Flag that determines if the allocations that share the file are interleaved
 } MPI_Info_Values;
 
+typedef struct MPI_Win_Alloc_List MPI_Win_Alloc_List;
+
 /**
- * Structure that represents the associated allocated data of a certain window.
+ * Structure that describes the segment of a process inside an allocation
+ * shared by the processes of a node (i.e., MPI_Win_allocate_shared).
  */
 typedef struct
 {
-    int     alloc_type;      // Type of the allocation
-    int     alloc_release;   // Flag that determines if the allocation must be released (i.e., ownership check)
-    void    *data;           // Data allocated to the window
+    void     *base;                     // Address of the segment in the calling process
+    MPI_Aint size;                      // Size of the segment
+    int      disp_unit;                 // Displacement unit of the segment
+} MPI_Win_Segment;
+
+/**
+ * Structure that represents the associated allocated data of a certain window.
+ */
+typedef struct MPI_Win_Alloc
+{
+    int                  alloc_type;    // Type of the allocation
+    int                  alloc_release; // Flag that determines if the allocation must be released (i.e., ownership check)
+    void                 *data;         // Data allocated to the window
+    void                 *base;         // Base pointer returned to the user (i.e., key of the allocation)
+    MPI_Win_Segment      *segments;     // Segments of every process of a shared allocation (NULL otherwise)
+    int                  num_segments;  // Number of processes that share the allocation
+    int                  state;         // State of the file when the allocation was created (i.e., MPIX_WIN_STATE_*)
+    MPI_Win_Alloc_List   *list;         // List of the window that the allocation is attached to (NULL if none)
+    struct MPI_Win_Alloc *prev;         // Previous allocation attached to the same window
+    struct MPI_Win_Alloc *next;         // Next allocation attached to the same window
+    struct MPI_Win_Alloc *same;         // Next allocation with the same base pointer (e.g., zero-size allocations)
 } MPI_Win_Alloc;
 
+/**
+ * Structure that contains the allocations attached to a certain window, which
+ * is associated to the window object as an attribute.
+ */
+struct MPI_Win_Alloc_List
+{
+    MPI_Win_Alloc *head;        // First allocation attached to the window
+    int           count;        // Number of allocations attached to the window
+    MPI_Win_Alloc **ranges;     // Storage allocations of the window sorted by address (i.e., range lookups)
+    int           num_ranges;   // Number of storage allocations attached to the window
+    int           size_ranges;  // Capacity of the sorted array of storage allocations
+};
+
 /**
  * Helper method that allows to parse a given MPI_Info object and return the
  * values associated with the MPI storage windows scenario.
@@ -58,22 +106,42 @@ typedef struct
 int parseInfo(MPI_Info info, MPI_Info_Values *values);
 
 /**
- * Adds / Removes a key / value of a window to the internal cache, with the
- * purpose  of allowing the retrieval of the MPI_Win_Alloc afterwards.
+ * Creates the key / value used to associate the list of allocations to the
+ * windows, if it was not created before.
+ */
+int initWinKeyval(MPI_Win_copy_attr_function *copy_fn, MPI_Win_delete_attr_function *delete_fn);
+
+/**
+ * Adds / Removes an MPI_Win_Alloc to the internal cache (indexed by the base
+ * pointer), with the purpose of allowing the retrieval of the allocation if
+ * MPI_Alloc_mem was used.
+ */
+int addWinAlloc(MPI_Win_Alloc *win_alloc);
+int removeWinAlloc(MPI_Win_Alloc *win_alloc);
+
+/**
+ * Attaches the cached MPI_Win_Alloc that matches the provided pointer to the
+ * list of allocations of a given window, creating the list if the window does
+ * not have one yet.
+ */
+int attachWinAlloc(MPI_Win win, void *ptr, MPI_Win_Alloc **win_alloc);
+
+/**
+ * Detaches the MPI_Win_Alloc that matches the provided pointer from the list
+ * of allocations of a given window.
  */
-DECLARE_STORE_FN(Keyval, int, keyval);
+int detachWinAlloc(MPI_Win win, const void *ptr, MPI_Win_Alloc **win_alloc);
 
 /**
- * Adds / Removes an MPI_Win_Alloc to the internal cache, with the purpose of 
- * allowing the retrieval of the allocation if MPI_Alloc_mem was used.
+ * Removes an MPI_Win_Alloc from the list of allocations that it is attached to
+ * (i.e., the allocation remains in the internal cache).
  */
-DECLARE_STORE_FN(Alloc, MPI_Win_Alloc*, alloc);
+void unlinkWinAlloc(MPI_Win_Alloc *win_alloc);
 
 /**
- * Retrieves the MPI_Win_Alloc from a given window, by testing the cached
- * key / values available.
+ * Retrieves the MPI_Win_Alloc from a given window (i.e., the last attached).
  */
-int getWinAllocFromWin(MPI_Win win, int delete_entry, MPI_Win_Alloc **win_alloc);
+int getWinAllocFromWin(MPI_Win win, MPI_Win_Alloc **win_alloc);
 
 /**
  * Retrieves the MPI_Win_Alloc from a given pointer, by testing the cached
@@ -82,16 +150,16 @@ int getWinAllocFromWin(MPI_Win win, int delete_entry, MPI_Win_Alloc **win_alloc)
 int getWinAllocFromPtr(void* ptr, int delete_entry, MPI_Win_Alloc **win_alloc);
 
 /**
- * Retrieves the key / value from a given window that matches the provided
- * pointer, by testing the cached key / values available.
+ * Retrieves all the MPI_Win_Alloc from a given window, by traversing the list
+ * of allocations of the window.
  */
-int getWinKeyvalFromWinPtr(MPI_Win win, void* ptr, int *win_keyval);
+int getAllWinAllocFromWin(MPI_Win win, MPI_Win_Alloc ***win_allocs, int *count);
 
 /**
- * Retrieves all the MPI_Win_Alloc from a given window, by testing the cached
- * key / values available.
+ * Retrieves the storage MPI_Win_Alloc of a given window whose mapping contains
+ * the given range of addresses.
  */
-int getAllWinAllocFromWin(MPI_Win win, MPI_Win_Alloc ***win_allocs, int *count);
+int getWinAllocFromAddr(MPI_Win win, const void *addr, size_t length, MPI_Win_Alloc **win_alloc);
 
 #ifdef __cplusplus
 }